@@ -0,0 +1,35 @@
+#pragma once
+
+#include "search.hpp"
+#include "thread_pool.hpp"
+
+// Runs searches on a worker thread so the caller never blocks. Searches run
+// one at a time, starting a new one cancels the previous one.
+class AsyncSearch {
+ public:
+  AsyncSearch() = default;
+  ~AsyncSearch();
+
+  AsyncSearch(const AsyncSearch&) = delete;
+  AsyncSearch& operator=(const AsyncSearch&) = delete;
+
+  AsyncSearch(AsyncSearch&&) = delete;
+  AsyncSearch& operator=(AsyncSearch&&) = delete;
+
+  // The board is copied, it can change while the search runs
+  std::future<SearchResult> start(const Board& board,
+                                  const SearchLimits& limits);
+
+  // The pending future still becomes ready, with the best result so far
+  void stop();
+
+  // Like Search::set_network(), only between searches
+  void set_network(const Network* network) { search_.set_network(network); }
+
+ private:
+  std::stop_source stop_source_;
+  Search search_;
+
+  // Last so the worker is joined before the search is destroyed
+  ThreadPool pool_{1};
+};
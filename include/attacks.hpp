@@ -0,0 +1,193 @@
+#pragma once
+
+#include "bitboard.hpp"
+#include "piece.hpp"
+
+#if !defined(USE_PEXT) && defined(__BMI2__) && !defined(DISABLE_PEXT)
+#define USE_PEXT
+#endif
+
+#ifdef USE_PEXT
+#include <immintrin.h>
+#endif
+
+// Attack sets are looked up from tables evaluated at compile time. The leaper
+// tables are small enough to live in the header, the slider table is defined
+// once in attacks.cpp.
+
+template <typename F>
+inline constexpr std::array<Bitboard, 64> make_attack_table(F calculate) {
+  std::array<Bitboard, 64> table{};
+  for (int tile = 0; tile < 64; tile++) {
+    table[tile] = calculate(tile);
+  }
+  return table;
+}
+
+inline constexpr std::array<Bitboard, 64> k_king_attacks{
+    make_attack_table(calculate_king_attacks)};
+
+inline constexpr std::array<Bitboard, 64> k_knight_attacks{
+    make_attack_table(calculate_knight_attacks)};
+
+// Black, white
+inline constexpr std::array<std::array<Bitboard, 64>, 2> k_pawn_attacks{
+    make_attack_table([](int tile) {
+      return calculate_pawn_attacks(tile, false);
+    }),
+    make_attack_table([](int tile) {
+      return calculate_pawn_attacks(tile, true);
+    })};
+
+struct SliderMagic {
+  Bitboard mask{};
+  Bitboard magic{};
+  uint32_t offset{};
+  uint32_t shift{};
+};
+
+// Blockers on the last tile of a ray never change the attack set, so they are
+// left out of the mask
+inline constexpr Bitboard calculate_slider_mask(int tile, bool rook) {
+  const Bitboard row{k_rank_1 << (8U * static_cast<unsigned int>(
+                                            get_tile_row(tile)))};
+  const Bitboard column{k_file_a << static_cast<unsigned int>(
+                            get_tile_column(tile))};
+  const Bitboard edges{((k_rank_1 | k_rank_8) & ~row) |
+                       ((k_file_a | k_file_h) & ~column)};
+  return (rook ? calculate_rook_attacks(tile, 0)
+               : calculate_bishop_attacks(tile, 0)) &
+         ~edges;
+}
+
+inline constexpr std::array<SliderMagic, 64> make_slider_magics(
+    const std::array<Bitboard, 64>& numbers, bool rook, uint32_t offset) {
+  std::array<SliderMagic, 64> magics{};
+  for (int tile = 0; tile < 64; tile++) {
+    SliderMagic& magic{magics[tile]};
+    magic.mask = calculate_slider_mask(tile, rook);
+    magic.magic = numbers[tile];
+    magic.offset = offset;
+    magic.shift = static_cast<uint32_t>(64 - count_tiles(magic.mask));
+    offset += uint32_t{1} << static_cast<uint32_t>(count_tiles(magic.mask));
+  }
+  return magics;
+}
+
+// Every magic maps the relevant blockers to exactly 2^bits slots, so the
+// table layout is identical with PEXT and the multiply indexing below
+inline constexpr std::array<Bitboard, 64> k_rook_magic_numbers{
+    0x8080102040008000ULL, 0x5440041000200048ULL, 0x008020008010000AULL,
+    0x0200084200100420ULL, 0x0200081020040200ULL, 0x0600019002002824ULL,
+    0x040050811008020CULL, 0x0100004881000126ULL, 0x0005800440008020ULL,
+    0x2882002042090880ULL, 0x0002802000801004ULL, 0x0240808010000800ULL,
+    0x4480800800040082ULL, 0x0408808004000200ULL, 0x00BA0004A8020001ULL,
+    0x1106000042040091ULL, 0x0020208010400080ULL, 0x0022060045028020ULL,
+    0x0020008020100080ULL, 0x0202020008102041ULL, 0x0C50808008000400ULL,
+    0x0068808002000400ULL, 0x00510400C8100201ULL, 0x400006000100A444ULL,
+    0x483424818008400AULL, 0x8840008080200040ULL, 0x0800100080802000ULL,
+    0x0440100080800800ULL, 0x4000080080040080ULL, 0x9124040080020080ULL,
+    0x0089000300040E00ULL, 0x080001020020488CULL, 0x9040002040800080ULL,
+    0x80D0002001400242ULL, 0x0000401901002002ULL, 0x0030220901001000ULL,
+    0x0080580005003100ULL, 0x0022006C0A001008ULL, 0x0802301144001248ULL,
+    0x0020010042000084ULL, 0x4AC0400084228004ULL, 0x0010004020004000ULL,
+    0x3110004020010100ULL, 0x0598100009050020ULL, 0x4200080011010004ULL,
+    0x0818020004008080ULL, 0x02A0708102040008ULL, 0x5201010080420004ULL,
+    0x100B124063800100ULL, 0x7808200240048980ULL, 0x8800200010008080ULL,
+    0x1099201001000900ULL, 0x0100050010080100ULL, 0x0400800200040080ULL,
+    0x2040280190020400ULL, 0x00100C0100608200ULL, 0x0000201241088202ULL,
+    0x1040002042801B01ULL, 0x0124090010200041ULL, 0x0831002004081001ULL,
+    0x2003000800021005ULL, 0x80010002040008C1ULL, 0x0208008122081004ULL,
+    0x4000008844002102ULL,
+};
+
+inline constexpr std::array<Bitboard, 64> k_bishop_magic_numbers{
+    0x0020011019010028ULL, 0x0122100912208000ULL, 0x1498082308200080ULL,
+    0x0004106600000000ULL, 0x2082021000405600ULL, 0x68508804C0820201ULL,
+    0xA004140422080010ULL, 0x0120402084202004ULL, 0x0000F0101014C080ULL,
+    0x014002300A022041ULL, 0x000084080A004020ULL, 0x2061949202010083ULL,
+    0x0407820210050008ULL, 0x00500101084008A2ULL, 0x2000040404420880ULL,
+    0x00090044041C0710ULL, 0x0804004030841140ULL, 0x002580A001240100ULL,
+    0x2081000214090200ULL, 0x0812022C01220050ULL, 0x0602001012100010ULL,
+    0x0003004080454024ULL, 0x0000400088084800ULL, 0x8000800040480850ULL,
+    0x1010040110602230ULL, 0x8428204002044D32ULL, 0x0340240028880200ULL,
+    0x1804080018220040ULL, 0x0C10101041004001ULL, 0x0422208008080100ULL,
+    0x0010810610941000ULL, 0x0302122002050140ULL, 0x8304104008054400ULL,
+    0x1000AC5003A45026ULL, 0x0202402080100508ULL, 0xC801042008040100ULL,
+    0x00400020210A0080ULL, 0x4010404200004104ULL, 0x0401180120008C00ULL,
+    0x0811450200110052ULL, 0xB10110825000A020ULL, 0x8104008405001050ULL,
+    0x0908094050030803ULL, 0x000414C204800804ULL, 0x2000202414004042ULL,
+    0x044001040020A100ULL, 0x0008100400440082ULL, 0x210101050A040102ULL,
+    0x8004442420080000ULL, 0x0906008421080000ULL, 0x0220208048081004ULL,
+    0x0000004084240800ULL, 0x00080020A0864200ULL, 0x40010484880E0000ULL,
+    0x9040100440808008ULL, 0x0010028089020002ULL, 0x100082004202C000ULL,
+    0x4049051042022000ULL, 0x010100010C110400ULL, 0x8200000B02208810ULL,
+    0x0000001008210100ULL, 0x0000180410241840ULL, 0x0880100401680A01ULL,
+    0x04021A0809040081ULL,
+};
+
+inline constexpr size_t k_rook_attacks_size{102400};
+inline constexpr size_t k_bishop_attacks_size{5248};
+
+inline constexpr std::array<SliderMagic, 64> k_rook_magics{
+    make_slider_magics(k_rook_magic_numbers, true, 0)};
+
+inline constexpr std::array<SliderMagic, 64> k_bishop_magics{
+    make_slider_magics(k_bishop_magic_numbers, false, k_rook_attacks_size)};
+
+using SliderAttacks =
+    std::array<Bitboard, k_rook_attacks_size + k_bishop_attacks_size>;
+
+extern const SliderAttacks k_slider_attacks;
+
+inline constexpr uint32_t get_magic_index(const SliderMagic& magic,
+                                          Bitboard occupancy) {
+  return static_cast<uint32_t>(((occupancy & magic.mask) * magic.magic) >>
+                               magic.shift);
+}
+
+inline uint32_t get_slider_index(const SliderMagic& magic,
+                                 Bitboard occupancy) {
+#ifdef USE_PEXT
+  return static_cast<uint32_t>(_pext_u64(occupancy, magic.mask));
+#else
+  return get_magic_index(magic, occupancy);
+#endif
+}
+
+using TilePairs = std::array<std::array<Bitboard, 64>, 64>;
+
+// Tiles strictly between two tiles sharing a row, column or diagonal
+extern const TilePairs k_between_tiles;
+
+// The whole row, column or diagonal through two aligned tiles
+extern const TilePairs k_lines;
+
+inline Bitboard get_between_tiles(int tile, int target) {
+  return k_between_tiles[tile][target];
+}
+
+inline Bitboard get_line(int tile, int target) { return k_lines[tile][target]; }
+
+inline Bitboard get_king_attacks(int tile) { return k_king_attacks[tile]; }
+
+inline Bitboard get_knight_attacks(int tile) { return k_knight_attacks[tile]; }
+
+inline Bitboard get_pawn_attacks(int tile, PieceColor color) {
+  return k_pawn_attacks[get_color_index(color)][tile];
+}
+
+inline Bitboard get_rook_attacks(int tile, Bitboard occupancy) {
+  const SliderMagic& magic{k_rook_magics[tile]};
+  return k_slider_attacks[magic.offset + get_slider_index(magic, occupancy)];
+}
+
+inline Bitboard get_bishop_attacks(int tile, Bitboard occupancy) {
+  const SliderMagic& magic{k_bishop_magics[tile]};
+  return k_slider_attacks[magic.offset + get_slider_index(magic, occupancy)];
+}
+
+inline Bitboard get_queen_attacks(int tile, Bitboard occupancy) {
+  return get_rook_attacks(tile, occupancy) |
+         get_bishop_attacks(tile, occupancy);
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <bit>
+
+#include "common.hpp"
+
+// Bit i is set when tile i (a1 = 0, h8 = 63) is part of the set
+using Bitboard = uint64_t;
+
+inline constexpr Bitboard k_file_a{0x0101010101010101ULL};
+inline constexpr Bitboard k_file_h{k_file_a << 7U};
+inline constexpr Bitboard k_rank_1{0xFFULL};
+inline constexpr Bitboard k_rank_8{k_rank_1 << 56U};
+
+inline constexpr bool is_valid_tile(int tile) {
+  return 0 <= tile && tile <= 63;
+}
+
+inline constexpr int get_tile_row(int tile) {
+  ASSERT(is_valid_tile(tile));
+  return static_cast<uint8_t>(tile) >> 3U;
+}
+
+inline constexpr int get_tile_column(int tile) {
+  ASSERT(is_valid_tile(tile));
+  return static_cast<uint8_t>(tile) & 7U;
+}
+
+inline constexpr Bitboard tile_bitboard(int tile) {
+  return Bitboard{1} << static_cast<unsigned int>(tile);
+}
+
+inline constexpr bool has_tile(Bitboard bitboard, int tile) {
+  return (bitboard & tile_bitboard(tile)) != 0;
+}
+
+inline constexpr int count_tiles(Bitboard bitboard) {
+  return std::popcount(bitboard);
+}
+
+inline constexpr int get_first_tile(Bitboard bitboard) {
+  ASSERT(bitboard != 0);
+  return std::countr_zero(bitboard);
+}
+
+inline constexpr int pop_first_tile(Bitboard& bitboard) {
+  const int tile{get_first_tile(bitboard)};
+  bitboard &= bitboard - 1;
+  return tile;
+}
+
+inline constexpr Bitboard shift_north(Bitboard b) { return b << 8U; }
+inline constexpr Bitboard shift_south(Bitboard b) { return b >> 8U; }
+
+inline constexpr Bitboard shift_east(Bitboard b) {
+  return (b & ~k_file_h) << 1U;
+}
+inline constexpr Bitboard shift_west(Bitboard b) {
+  return (b & ~k_file_a) >> 1U;
+}
+
+inline constexpr Bitboard shift_north_east(Bitboard b) {
+  return (b & ~k_file_h) << 9U;
+}
+inline constexpr Bitboard shift_north_west(Bitboard b) {
+  return (b & ~k_file_a) << 7U;
+}
+inline constexpr Bitboard shift_south_east(Bitboard b) {
+  return (b & ~k_file_h) >> 7U;
+}
+inline constexpr Bitboard shift_south_west(Bitboard b) {
+  return (b & ~k_file_a) >> 9U;
+}
+
+inline constexpr Bitboard calculate_king_attacks(int tile) {
+  const Bitboard b{tile_bitboard(tile)};
+  const Bitboard row{b | shift_east(b) | shift_west(b)};
+  return (row | shift_north(row) | shift_south(row)) & ~b;
+}
+
+inline constexpr Bitboard calculate_knight_attacks(int tile) {
+  const Bitboard b{tile_bitboard(tile)};
+  const Bitboard one{shift_east(b) | shift_west(b)};
+  const Bitboard two{shift_east(shift_east(b)) | shift_west(shift_west(b))};
+  return (one << 16U) | (one >> 16U) | (two << 8U) | (two >> 8U);
+}
+
+inline constexpr Bitboard calculate_pawn_attacks(int tile, bool white) {
+  const Bitboard b{tile_bitboard(tile)};
+  return white ? shift_north_east(b) | shift_north_west(b)
+               : shift_south_east(b) | shift_south_west(b);
+}
+
+// Walks every ray of a slider until it leaves the board or hits a blocker,
+// blockers themselves are included in the result
+template <typename... Shifts>
+inline constexpr Bitboard calculate_ray_attacks(int tile, Bitboard occupancy,
+                                                Shifts... shifts) {
+  Bitboard attacks{};
+  (
+      [&](auto shift) {
+        for (Bitboard b = shift(tile_bitboard(tile)); b != 0; b = shift(b)) {
+          attacks |= b;
+          if ((b & occupancy) != 0) {
+            break;
+          }
+        }
+      }(shifts),
+      ...);
+  return attacks;
+}
+
+inline constexpr Bitboard calculate_rook_attacks(int tile, Bitboard occupancy) {
+  return calculate_ray_attacks(tile, occupancy, shift_north, shift_south,
+                               shift_east, shift_west);
+}
+
+inline constexpr Bitboard calculate_bishop_attacks(int tile,
+                                                   Bitboard occupancy) {
+  return calculate_ray_attacks(tile, occupancy, shift_north_east,
+                               shift_north_west, shift_south_east,
+                               shift_south_west);
+}
@@ -1,41 +1,63 @@
 #pragma once
 
+#include "bitboard.hpp"
+#include "fixed_stack.hpp"
 #include "piece.hpp"
+#include "psqt.hpp"
+#include "zobrist.hpp"
 
-inline constexpr bool is_valid_tile(int tile) {
-  return 0 <= tile && tile <= 63;
+// Piece counts packed four bits each, in the order of the Zobrist piece
+// index, so positions with the same material share a key whatever the tiles
+inline constexpr unsigned get_material_shift(Piece piece) {
+  return 4U * static_cast<unsigned>(get_zobrist_piece_index(piece));
 }
 
-inline constexpr int get_tile_row(int tile) {
-  ASSERT(is_valid_tile(tile));
-  return static_cast<uint8_t>(tile) >> 3U;
+inline constexpr uint64_t get_material_increment(Piece piece) {
+  return uint64_t{1} << get_material_shift(piece);
 }
 
-inline constexpr int get_tile_column(int tile) {
-  ASSERT(is_valid_tile(tile));
-  return static_cast<uint8_t>(tile) & 7U;
+inline constexpr int get_material_count(uint64_t material_key, Piece piece) {
+  return static_cast<int>((material_key >> get_material_shift(piece)) & 15U);
 }
 
 class Board {
+ public:
+  // Tiles fit in a byte, which keeps move lists and records small
   struct Move {
-    int tile{-1};
-    int target{-1};
+    constexpr Move() = default;
+    constexpr Move(int tile, int target, PieceType promotion = {})
+        : tile{static_cast<int8_t>(tile)},
+          target{static_cast<int8_t>(target)},
+          promotion{promotion} {}
+
+    friend constexpr bool operator==(const Move&, const Move&) = default;
+
+    int8_t tile{-1};
+    int8_t target{-1};
     PieceType promotion{};
   };
 
+  // Longest game, in plies, that the history can hold
+  static constexpr size_t k_max_records{2048};
+
+ private:
   enum class CastlingRight : uint8_t { None, Short = 1, Long = 2, Both = 3 };
 
   using CastlingRights = std::array<CastlingRight, 2>;
 
+  // 16 bytes, the hash goes first so the rest packs without padding
   struct MoveRecord {
+    uint64_t hash{};
     Move move;
-    PieceType promotion{};
     Piece captured_piece{};
     CastlingRights castling_rights{};
-    int enpassant_tile{};
+    int8_t enpassant_tile{};
+    uint8_t halfmove_clock{};
   };
 
-  using Records = std::vector<MoveRecord>;
+  static_assert(sizeof(MoveRecord) == 16);
+
+  using Records = FixedStack<MoveRecord, k_max_records>;
 
   static constexpr std::string_view DEFAULT_FEN{
       "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"};
@@ -46,17 +68,57 @@ class Board {
     std::array<Move, 256> data{};
   };
 
+  struct PieceChange {
+    Piece piece{};
+    int tile{};
+  };
+
+  // Pieces a move took off and put on the board, the moved piece first
+  struct MoveChanges {
+    FixedStack<PieceChange, 2> removed;
+    FixedStack<PieceChange, 2> added;
+  };
+
   Board();
 
   void move(Move move);
   void undo();
 
+  // What the last move changed, for state kept incrementally outside the
+  // board. There must be a last move.
+  [[nodiscard]] MoveChanges get_last_move_changes() const;
+
   void get_moves(Moves& moves, int tile);
   bool is_game_over();
 
+  // All legal moves of the side to move
+  void generate_all(Moves& moves) const;
+  // Legal captures, en passant included, and promotions
+  void generate_noisy(Moves& moves) const;
+  // Every other legal move, the two sets add up to generate_all()
+  void generate_quiet(Moves& moves) const;
+  [[nodiscard]] bool has_any_legal_move() const;
+
+  // For moves from elsewhere, like a hash table or another position
+  [[nodiscard]] bool is_legal_move(Move move) const;
+  [[nodiscard]] bool is_quiet(Move move) const;
+
+  [[nodiscard]] bool is_in_check() const;
+
+  // Fifty-move rule or a repetition since the last irreversible move. A single
+  // repetition counts, which is what a search wants.
+  [[nodiscard]] bool is_draw() const;
+  [[nodiscard]] bool is_repetition() const;
+  // Earlier occurrences of the position, two make a threefold repetition
+  [[nodiscard]] int count_repetitions() const;
+
   uint64_t perft(int depth);
 
-  void load_fen(std::string_view fen = DEFAULT_FEN);
+  // Validates the whole position, a malformed or illegal one loads the
+  // default position and returns false. Never allocates. The move counters
+  // may be left out, as in the first four fields of an EPD line.
+  bool load_fen(std::string_view fen = DEFAULT_FEN);
+  [[nodiscard]] std::string to_fen() const;
 
   [[nodiscard]] Piece get_tile(int tile) const { return tiles_[tile]; }
 
@@ -68,26 +130,112 @@ class Board {
     return get_piece_type(get_tile(tile));
   }
 
+  [[nodiscard]] PieceColor get_turn() const { return turn_; }
+
+  [[nodiscard]] int get_halfmove_clock() const { return halfmove_clock_; }
+
+  [[nodiscard]] int get_fullmove_number() const { return fullmove_number_; }
+
+  [[nodiscard]] uint64_t get_hash() const { return hash_; }
+
+  // Sums of the piece-square scores from the point of view of white
+  [[nodiscard]] int get_middlegame_score() const { return middlegame_score_; }
+  [[nodiscard]] int get_endgame_score() const { return endgame_score_; }
+
+  // k_max_phase with all pieces on the board, more after promotions
+  [[nodiscard]] int get_phase() const { return phase_; }
+
+  [[nodiscard]] int get_piece_count() const { return count_tiles(occupancy_); }
+
+  // Count of every kind of piece, see get_material_increment()
+  [[nodiscard]] uint64_t get_material_key() const { return material_key_; }
+
+  [[nodiscard]] bool has_castling_rights() const {
+    return castling_rights_ != CastlingRights{};
+  }
+
+  [[nodiscard]] Bitboard get_occupancy() const { return occupancy_; }
+
+  [[nodiscard]] Bitboard get_color_bitboard(PieceColor color) const {
+    return color_bitboards_[get_color_index(color)];
+  }
+
+  [[nodiscard]] Bitboard get_type_bitboard(PieceType type) const {
+    return type_bitboards_[to_underlying(type)];
+  }
+
+  [[nodiscard]] Bitboard get_piece_bitboard(PieceColor color,
+                                            PieceType type) const {
+    return get_color_bitboard(color) & get_type_bitboard(type);
+  }
+
   [[nodiscard]] const Records& get_records() const { return records_; }
 
  private:
-  void set_tile(int tile, Piece piece) { tiles_[tile] = piece; }
+  void set_tile(int tile, Piece piece) {
+    const Bitboard bitboard{tile_bitboard(tile)};
+    if (const Piece previous{tiles_[tile]};
+        get_piece_type(previous) != PieceType::None) {
+      color_bitboards_[get_color_index(get_piece_color(previous))] ^= bitboard;
+      type_bitboards_[to_underlying(get_piece_type(previous))] ^= bitboard;
+      occupancy_ ^= bitboard;
+      hash_ ^= get_zobrist_piece_key(previous, tile);
+
+      const TaperedScore score{get_piece_square_score(previous, tile)};
+      middlegame_score_ -= score.middlegame;
+      endgame_score_ -= score.endgame;
+      phase_ -= get_phase_weight(get_piece_type(previous));
+      material_key_ -= get_material_increment(previous);
+    }
+    if (get_piece_type(piece) != PieceType::None) {
+      color_bitboards_[get_color_index(get_piece_color(piece))] ^= bitboard;
+      type_bitboards_[to_underlying(get_piece_type(piece))] ^= bitboard;
+      occupancy_ ^= bitboard;
+      hash_ ^= get_zobrist_piece_key(piece, tile);
+
+      const TaperedScore score{get_piece_square_score(piece, tile)};
+      middlegame_score_ += score.middlegame;
+      endgame_score_ += score.endgame;
+      phase_ += get_phase_weight(get_piece_type(piece));
+      material_key_ += get_material_increment(piece);
+    }
+    tiles_[tile] = piece;
+  }
 
   [[nodiscard]] bool is_piece(int tile, PieceColor color,
                               PieceType type) const {
-    return get_color(tile) == color && get_type(tile) == type;
+    return has_tile(get_piece_bitboard(color, type), tile);
   }
 
   [[nodiscard]] bool is_empty(int tile) const {
-    return get_piece_type(get_tile(tile)) == PieceType::None;
+    return !has_tile(occupancy_, tile);
   }
 
-  void generate_legal_moves(Moves& moves, int tile);
-  void generate_moves(Moves& moves, int tile) const;
+  [[nodiscard]] int get_king_tile(PieceColor color) const {
+    return get_first_tile(get_piece_bitboard(color, PieceType::King));
+  }
+
+  enum class Generation : uint8_t { All, Noisy, Quiet };
+
+  // Emits only legal moves of the pieces in sources, checkers and pins are
+  // resolved once per call instead of trying each move. With stop_at_first
+  // it returns as soon as any piece has produced a move.
+  void generate_legal_moves(Moves& moves, Bitboard sources,
+                            Generation generation = Generation::All,
+                            bool stop_at_first = false) const;
+  void generate_castling_moves(Moves& moves, int king_tile) const;
+  [[nodiscard]] bool is_legal_enpassant(int tile) const;
+
+  [[nodiscard]] Bitboard get_attackers(int tile, Bitboard occupancy) const;
+  [[nodiscard]] Bitboard calculate_pinned(PieceColor color) const;
   [[nodiscard]] bool is_threatened(int tile, PieceColor attacker_color) const;
-  bool is_in_check();
 
   void reset();
+  [[nodiscard]] bool parse_fen(std::string_view fen);
+
+  [[nodiscard]] uint64_t calculate_hash() const;
+  [[nodiscard]] uint64_t get_castling_key() const;
+  [[nodiscard]] uint64_t get_enpassant_key() const;
 
   PieceColor turn_{};
 
@@ -98,11 +246,33 @@ class Board {
   void clear_castling_right(int index, CastlingRight right);
   void clear_castling_rights(int tile, PieceColor color);
 
-  // Black, white
-  std::array<int, 2> king_tiles_{};
-
   int enpassant_tile_{-1};
+
+  // Plies since the last capture or pawn move, saturates so it fits a record
+  int halfmove_clock_{};
+
+  // Starts at one and goes up after every move of black
+  int fullmove_number_{1};
+
+  // Mailbox kept next to the bitboards for O(1) lookups by tile
   std::array<Piece, 64> tiles_{};
 
+  // Black, white
+  std::array<Bitboard, 2> color_bitboards_{};
+
+  // Indexed by PieceType, PieceType::None is unused
+  std::array<Bitboard, 7> type_bitboards_{};
+
+  Bitboard occupancy_{};
+
+  // Zobrist key of the position, kept up to date by set_tile() and move()
+  uint64_t hash_{};
+
+  // Kept up to date by set_tile(), so undo() restores them for free
+  int middlegame_score_{};
+  int endgame_score_{};
+  int phase_{};
+  uint64_t material_key_{};
+
   Records records_;
 };
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <iosfwd>
+#include <random>
+
+#include "board.hpp"
+#include "mapped_file.hpp"
+
+// One 16 byte record of a book file, stored big-endian. Moves are encoded as
+// in Polyglot: target tile in bits 0-5, origin in 6-11, promotion in 12-14
+// (knight 1 to queen 4), and castling as the king taking its own rook.
+struct BookEntry {
+  uint64_t key{};
+  uint16_t move{};
+  uint16_t weight{};
+  uint32_t learn{};
+};
+
+inline constexpr size_t k_book_entry_size{16};
+
+uint16_t to_book_move(const Board& board, Board::Move move);
+// An empty move if the entry doesn't hold a legal move of the position
+Board::Move parse_book_move(const Board& board, uint16_t move);
+
+void write_book_entry(std::ostream& output, const BookEntry& entry);
+
+// Opening book in the Polyglot file format, entries sorted by key. The file is
+// mapped and binary searched where it lies, opening it parses nothing and
+// every book, in this process or another, reading the same file shares its
+// pages. Keys are Board::get_hash(), which is the Polyglot key, so existing
+// Polyglot books work as well as the ones chess_book builds.
+class OpeningBook {
+  // A position has far fewer book moves, the rest would be ignored
+  static constexpr size_t k_max_moves{64};
+
+ public:
+  struct Move {
+    Board::Move move;
+    uint16_t weight{};
+  };
+
+  using Moves = FixedStack<Move, k_max_moves>;
+
+  // Logs and returns false if the file can't be mapped or is not a book
+  bool open(const fs::path& path);
+  void close();
+
+  [[nodiscard]] bool is_open() const { return entry_count_ != 0; }
+
+  // Legal book moves of the position, in file order
+  void probe(const Board& board, Moves& moves) const;
+  // Drawn with probability proportional to the weights, an empty move once
+  // out of book
+  Board::Move pick(const Board& board, std::mt19937_64& random) const;
+
+ private:
+  [[nodiscard]] BookEntry get_entry(size_t index) const;
+
+  MappedFile file_;
+  size_t entry_count_{};
+};
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstdlib>
 #include <filesystem>
-#include <glm/glm.hpp>
 #include <memory>
 #include <stdexcept>
 #include <string>
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <algorithm>
+
+#include "board.hpp"
+
+// Rough values for move ordering, indexed by PieceType. The king is never
+// traded so it has no value.
+inline constexpr std::array<int, 7> k_piece_values{0, 0, 900, 330, 320, 500,
+                                                   100};
+
+inline constexpr int get_piece_value(PieceType type) {
+  return k_piece_values[to_underlying(type)];
+}
+
+// Static score in centipawns from the point of view of the side to move, the
+// piece-square scores tapered between middlegame and endgame by the phase
+inline int evaluate(const Board& board) {
+  const int phase{std::min(board.get_phase(), k_max_phase)};
+  const int score{(board.get_middlegame_score() * phase +
+                   board.get_endgame_score() * (k_max_phase - phase)) /
+                  k_max_phase};
+  return board.get_turn() == PieceColor::White ? score : -score;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <algorithm>
+
+#include "common.hpp"
+
+// Stack with inline storage and a fixed capacity, pushes never allocate.
+// Copies only transfer the used elements, moves fall back to copies.
+template <typename T, size_t N>
+class FixedStack {
+ public:
+  FixedStack() = default;
+
+  FixedStack(const FixedStack& other) : size_{other.size_} {
+    std::copy_n(other.data_.begin(), size_, data_.begin());
+  }
+
+  FixedStack& operator=(const FixedStack& other) {
+    if (this != &other) {
+      size_ = other.size_;
+      std::copy_n(other.data_.begin(), size_, data_.begin());
+    }
+    return *this;
+  }
+
+  template <typename... Args>
+  T& emplace_back(Args&&... args) {
+    ASSERT(size_ < N);
+    return data_[size_++] = T{std::forward<Args>(args)...};
+  }
+
+  void pop_back() {
+    ASSERT(size_ > 0);
+    size_--;
+  }
+
+  void clear() { size_ = 0; }
+
+  [[nodiscard]] T& back() {
+    ASSERT(size_ > 0);
+    return data_[size_ - 1];
+  }
+
+  [[nodiscard]] const T& back() const {
+    ASSERT(size_ > 0);
+    return data_[size_ - 1];
+  }
+
+  [[nodiscard]] T& operator[](size_t index) { return data_[index]; }
+  [[nodiscard]] const T& operator[](size_t index) const {
+    return data_[index];
+  }
+
+  [[nodiscard]] const T* begin() const { return data_.data(); }
+  [[nodiscard]] const T* end() const { return data_.data() + size_; }
+
+  [[nodiscard]] bool empty() const { return size_ == 0; }
+  [[nodiscard]] bool full() const { return size_ == N; }
+  [[nodiscard]] size_t size() const { return size_; }
+  [[nodiscard]] static constexpr size_t capacity() { return N; }
+
+ private:
+  size_t size_{};
+  std::array<T, N> data_;
+};
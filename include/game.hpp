@@ -1,11 +1,19 @@
 #pragma once
 
+#include <fstream>
+#include <random>
+
+#include "async_search.hpp"
 #include "board.hpp"
+#include "book.hpp"
+#include "nnue.hpp"
+#include "profiler.hpp"
 #include "renderer.hpp"
 
 struct GLFWwindow;
 
 inline constexpr glm::vec2 k_window_size{1280.0F, 720.0F};
+inline constexpr const char* k_window_title{"Chess"};
 
 class Game {
   static constexpr float k_game_scale{10.0F};
@@ -19,6 +27,16 @@ class Game {
 
   static constexpr glm::vec3 k_light_position{0.0F, 20.0F, 0.0F};
 
+  static constexpr SearchLimits k_ai_limits{
+      .movetime = std::chrono::milliseconds{1000}};
+
+  // How often the profile in the window title refreshes
+  static constexpr float k_profile_report_interval{0.5F};
+  static constexpr const char* k_profile_path{"profile.csv"};
+
+  // How long an idle frame sleeps while the AI is thinking, in seconds
+  static constexpr double k_ai_poll_interval{0.01};
+
  public:
   explicit Game(GLFWwindow* window);
 
@@ -33,16 +51,39 @@ class Game {
   void process_input();
 
   void update_picking_texture();
+  // Runs every loop iteration, drawn or not, so the hovered tile follows the
+  // cursor while nothing else changes
+  void read_picking_pixel();
   void draw_board();
   void draw_pieces();
   void draw_selectable_tiles();
 
   Renderer renderer_;
 
+  // Toggled with F3. While on, every frame goes to k_profile_path and the
+  // window title shows the latest one.
+  Profiler profiler_;
+  std::ofstream profile_csv_;
+  float profile_report_time_{};
+
+  void toggle_profiling();
+  void report_profile();
+
   Framebuffer* picking_texture_{};
   bool update_picking_texture_{true};
 
+  // Frames are only drawn when something on screen changed, otherwise the
+  // loop sleeps until the next event
+  bool redraw_{true};
+
+  [[nodiscard]] bool is_redraw_needed() const;
+
   int pixel_{-1};
+  // The cursor or what is under it moved since the last pixel read
+  bool pick_pixel_{true};
+
+  // A read still has to be requested or come back
+  [[nodiscard]] bool is_pixel_read_needed() const;
 
   float delta_time_{};
   float last_frame_{};
@@ -83,6 +124,7 @@ class Game {
   Models models_{};
 
   [[nodiscard]] Model* get_model(Piece piece) const;
+  [[nodiscard]] Model* get_model(PieceType type) const;
   [[nodiscard]] Model* get_model(ModelType type) const;
 
   Material selectable_tile_;
@@ -94,11 +136,19 @@ class Game {
 
   [[nodiscard]] bool is_selectable_tile(int tile) const;
 
+  // Hovered or selected, and not in the middle of a move
+  [[nodiscard]] bool is_outlined_piece(int tile) const;
+
+  // Enough for every piece on the board
+  using Instances = FixedStack<Instance, 64>;
+
   int selected_tile_{-1};
 
   struct ActiveMove {
     int tile{-1};
     int target{-1};
+    // As searched or read from the book, the player always gets a queen
+    PieceType promotion{};
     glm::vec3 position{};
     float angle{180.0F};
     bool is_completed{};
@@ -112,6 +162,20 @@ class Game {
 
   PieceColor ai_color_{};
 
+  // Optional, the AI evaluates with it instead of the piece-square tables.
+  // Declared first so the search never outlives it.
+  Network network_;
+
+  AsyncSearch ai_search_;
+  std::future<SearchResult> ai_result_;
+
+  // Optional, the AI plays from it without searching while in book
+  OpeningBook book_;
+  std::mt19937_64 random_{std::random_device{}()};
+
+  // Drops the pending result, the position it was searched for is gone
+  void cancel_ai();
+
   Transform calculate_piece_transform(int tile);
 
   static glm::vec3 calculate_tile_position(int tile);
@@ -123,6 +187,9 @@ class Game {
   static void mouse_scroll_callback(GLFWwindow* window, double xoffset,
                                     double yoffset);
 
+  // The window was uncovered or resized and lost its contents
+  static void window_refresh_callback(GLFWwindow* window);
+
   static void key_callback(GLFWwindow* window, int key, int /*scancode*/,
                            int action, int /*mods*/);
 };
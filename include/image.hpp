@@ -0,0 +1,38 @@
+#pragma once
+
+#include <span>
+
+#include "common.hpp"
+#include "mapped_file.hpp"
+
+// Pixels of a texture ready for upload, loaded off the GL thread
+struct Image {
+  struct Level {
+    int width{};
+    int height{};
+    std::span<const uint8_t> data;
+  };
+
+  // GL enums. Compressed images have a type of zero and only the internal
+  // format matters.
+  uint32_t format{};
+  uint32_t internal_format{};
+  uint32_t type{};
+
+  // Base level first, empty if loading failed. A single level of an
+  // uncompressed image gets its mipmaps generated on upload.
+  std::vector<Level> levels;
+
+  // Keep the data of the levels alive
+  std::unique_ptr<uint8_t, void (*)(void*)> pixels{nullptr, std::free};
+  std::unique_ptr<MappedFile> file;
+
+  [[nodiscard]] bool is_compressed() const { return type == 0; }
+};
+
+// Decodes a JPEG or PNG with stb_image
+Image load_image(const fs::path& path);
+
+// Maps a KTX 1 file, mip chain included, without copying it. Only 2D
+// textures without array layers or cube faces are accepted.
+Image load_ktx(const fs::path& path);
@@ -1,18 +1,118 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
 #include <format>
 #include <source_location>
 #include <string_view>
+#include <utility>
+
+// Messages are copied into a lock-free ring and written to stderr by a
+// background thread, in the order they were logged. Calls below the level of
+// their tag are discarded at compile time, arguments included.
+
+enum class LogLevel : uint8_t { Debug, Info, Error, Off };
 
 // #define DISABLE_LOGGING
 
-#ifdef DISABLE_LOGGING
-#define LOG(tag, message)
-#define LOGF(tag, fmt, ...)
+// Can be set from the build, as in -DLOG_LEVEL=Error
+#ifndef LOG_LEVEL
+#if defined(DISABLE_LOGGING)
+#define LOG_LEVEL Off
+#elif defined(NDEBUG)
+#define LOG_LEVEL Info
 #else
-#define LOG(tag, message) log(tag, message)
-#define LOGF(tag, fmt, ...) log(tag, std::format(fmt, __VA_ARGS__))
+#define LOG_LEVEL Debug
 #endif
+#endif
+
+inline constexpr LogLevel k_log_level{LogLevel::LOG_LEVEL};
+
+struct LogTagLevel {
+  std::string_view tag;
+  LogLevel level{};
+};
+
+// Tags that log at their own level instead of k_log_level
+inline constexpr std::array<LogTagLevel, 0> k_log_tag_levels{};
+
+constexpr bool is_log_enabled(LogLevel level, std::string_view tag) {
+  if (k_log_level == LogLevel::Off) {
+    return false;
+  }
+  const auto it{std::find_if(
+      k_log_tag_levels.begin(), k_log_tag_levels.end(),
+      [&](const LogTagLevel& tag_level) { return tag_level.tag == tag; })};
+  return level >= (it != k_log_tag_levels.end() ? it->level : k_log_level);
+}
+
+struct LogRecord {
+  // Longer messages are cut off
+  static constexpr size_t k_max_message{1024};
+
+  LogLevel level{};
+  // Tags are string literals, only the view is kept
+  std::string_view tag;
+  std::source_location source;
+  std::chrono::system_clock::time_point time;
+  size_t size{};
+  std::array<char, k_max_message> message;
+};
+
+// Claims a free record, waiting if the ring is full, and publishes it to the
+// writer thread. Every begin has to be followed by a commit.
+LogRecord& begin_log_record(LogLevel level, std::string_view tag,
+                            std::source_location source);
+void commit_log_record(LogRecord& record);
+
+inline void log_message(LogLevel level, std::string_view tag,
+                        std::string_view message, std::source_location source) {
+  LogRecord& record{begin_log_record(level, tag, source)};
+  record.size = std::min(message.size(), record.message.size());
+  std::copy_n(message.begin(), record.size, record.message.begin());
+  commit_log_record(record);
+}
+
+// Formats straight into the record, without a temporary string
+template <typename... Args>
+void log_format(LogLevel level, std::string_view tag,
+                std::source_location source, std::format_string<Args...> fmt,
+                Args&&... args) {
+  LogRecord& record{begin_log_record(level, tag, source)};
+  const auto result{std::format_to_n(record.message.begin(),
+                                     record.message.size(), fmt,
+                                     std::forward<Args>(args)...)};
+  record.size = std::min(static_cast<size_t>(result.size),
+                         record.message.size());
+  commit_log_record(record);
+}
+
+#define LOG_AT(level, tag, message)                                        \
+  do {                                                                     \
+    if constexpr (is_log_enabled(level, tag)) {                            \
+      log_message(level, tag, message, std::source_location::current());   \
+    }                                                                      \
+  } while (false)
+
+#define LOGF_AT(level, tag, fmt, ...)                                       \
+  do {                                                                      \
+    if constexpr (is_log_enabled(level, tag)) {                             \
+      log_format(level, tag, std::source_location::current(), fmt,          \
+                 __VA_ARGS__);                                              \
+    }                                                                       \
+  } while (false)
+
+#define LOG(tag, message) LOG_AT(LogLevel::Info, tag, message)
+#define LOGF(tag, fmt, ...) LOGF_AT(LogLevel::Info, tag, fmt, __VA_ARGS__)
+
+// Resource lifetimes and other chatter
+#define LOG_DEBUG(tag, message) LOG_AT(LogLevel::Debug, tag, message)
+#define LOGF_DEBUG(tag, fmt, ...) \
+  LOGF_AT(LogLevel::Debug, tag, fmt, __VA_ARGS__)
 
-void log(std::string_view tag, std::string_view message,
-         std::source_location source = std::source_location::current());
+// Failures
+#define LOG_ERROR(tag, message) LOG_AT(LogLevel::Error, tag, message)
+#define LOGF_ERROR(tag, fmt, ...) \
+  LOGF_AT(LogLevel::Error, tag, fmt, __VA_ARGS__)
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "common.hpp"
+
+// Read-only view of a whole file mapped into memory. Pages are only loaded
+// when touched, so large files stream through without being read up front.
+class MappedFile {
+ public:
+  // Hint for the read-ahead of the OS
+  enum class Access { Sequential, Random };
+
+  MappedFile() = default;
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+
+  MappedFile(MappedFile&&) = delete;
+  MappedFile& operator=(MappedFile&&) = delete;
+
+  // Logs and returns false on failure, an empty file maps to an empty view
+  bool open(const fs::path& path, Access access = Access::Sequential);
+  void close();
+
+  [[nodiscard]] std::string_view get_view() const { return {data_, size_}; }
+
+ private:
+  const char* data_{};
+  size_t size_{};
+
+#ifdef _WIN32
+  // HANDLEs, kept opaque so users do not pull in windows.h
+  void* file_{};
+  void* mapping_{};
+#endif
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <span>
+
+#include "mapped_file.hpp"
+#include "renderer.hpp"
+
+// What a model is built from, either parsed from glTF or read from the cache
+struct MeshSource {
+  // Texture paths are relative to the model file, no name means no material
+  struct MaterialSource {
+    std::string name;
+    std::string base_color_uri;
+  };
+
+  // Default, white and black
+  std::array<MaterialSource, 3> materials;
+
+  std::span<const Vertex> vertices;
+  std::span<const uint32_t> indices;
+};
+
+// Cooked copy of a model next to its glTF file, with the vertices and indices
+// laid out ready for upload. It is memory-mapped, so loading parses nothing.
+// The cache is stale as soon as the size or write time of the glTF file or
+// its buffer changes.
+class MeshCache {
+ public:
+  explicit MeshCache(const fs::path& gltf_path);
+
+  // False if the cache is missing, stale or damaged. The spans point into the
+  // mapping and stay valid while the cache lives.
+  bool load(MeshSource& source);
+
+  // Failures are only logged, the model loads from glTF again next time
+  void store(const MeshSource& source) const;
+
+ private:
+  fs::path path_;
+  uint64_t stamp_{};
+  MappedFile file_;
+};
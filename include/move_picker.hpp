@@ -0,0 +1,55 @@
+#pragma once
+
+#include "board.hpp"
+
+// Scores of quiet moves that caused beta cutoffs, by color, tile and target
+using HistoryTable = std::array<std::array<std::array<int, 64>, 64>, 2>;
+
+inline constexpr int k_max_history{16384};
+
+// Quiet moves that caused beta cutoffs at the same ply
+using Killers = std::array<Board::Move, 2>;
+
+// Hands out moves in stages, most promising first: the hash table move,
+// captures and promotions by most valuable victim and least valuable attacker,
+// killers, then the other quiet moves by history. Each stage is generated only
+// when reached, so a cutoff on an early move skips generating quiet moves.
+class MovePicker {
+  enum class Stage : uint8_t {
+    TableMove,
+    GenerateNoisy,
+    Noisy,
+    Killers,
+    GenerateQuiet,
+    Quiet,
+    Done
+  };
+
+ public:
+  // With noisy_only, as in the quiescence search, it stops after captures and
+  // promotions
+  MovePicker(const Board& board, Board::Move table_move, const Killers& killers,
+             const HistoryTable& history, bool noisy_only = false);
+
+  // Returns an empty move, with tile -1, when there are no moves left
+  Board::Move next();
+
+ private:
+  // Removes and returns the highest scored move left
+  Board::Move pick_best();
+
+  [[nodiscard]] bool is_skipped(Board::Move move) const;
+
+  const Board& board_;
+  const HistoryTable& history_;
+  Board::Move table_move_;
+  Killers killers_;
+  bool noisy_only_{};
+
+  Stage stage_{Stage::TableMove};
+  int killer_index_{};
+
+  Board::Moves moves_;
+  std::array<int, 256> scores_;
+  int index_{};
+};
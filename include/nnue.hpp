@@ -0,0 +1,74 @@
+#pragma once
+
+#include "board.hpp"
+#include "mapped_file.hpp"
+
+// One input for each piece on each tile, from the point of view of a side
+inline constexpr int k_network_inputs{768};
+inline constexpr int k_network_hidden{256};
+
+// Efficiently updatable network with one hidden layer per side and a squared
+// clipped ReLU, in the quantized layout bullet writes for 768 -> N x 2 -> 1:
+// feature weights, feature biases, output weights for the side to move and
+// then the other side, and the output bias, all int16 little-endian. The file
+// is mapped and used where it lies, so every search thread and process shares
+// one copy. Output weights are expected within +-127, as trainers clip them.
+class Network {
+ public:
+  // Logs and returns false if the file can't be mapped or has another shape
+  bool open(const fs::path& path);
+  void close();
+
+  [[nodiscard]] bool is_open() const { return feature_weights_ != nullptr; }
+
+  [[nodiscard]] const int16_t* get_feature_weights(int feature) const {
+    return feature_weights_ + feature * k_network_hidden;
+  }
+
+  [[nodiscard]] const int16_t* get_feature_biases() const {
+    return feature_biases_;
+  }
+
+  // Side to move first, then the other side
+  [[nodiscard]] const int16_t* get_output_weights() const {
+    return output_weights_;
+  }
+
+  [[nodiscard]] int get_output_bias() const { return output_bias_; }
+
+ private:
+  MappedFile file_;
+  const int16_t* feature_weights_{};
+  const int16_t* feature_biases_{};
+  const int16_t* output_weights_{};
+  int output_bias_{};
+};
+
+// Hidden layer of both sides, aligned for the widest vector loads
+struct alignas(64) Accumulator {
+  // Black, white
+  std::array<std::array<int16_t, k_network_hidden>, 2> values;
+};
+
+// Hidden layers along the line being searched, one per move. Each one is the
+// one below plus the rows of the pieces the last move changed, so a move costs
+// a few row additions and an undo just drops the top.
+class Accumulators {
+ public:
+  Accumulators(const Network& network, size_t capacity);
+
+  // Computes the position from scratch and drops everything above it
+  void reset(const Board& board);
+
+  // After board.move() and board.undo()
+  void push(const Board& board);
+  void pop();
+
+  // Centipawns from the point of view of the side to move
+  [[nodiscard]] int evaluate(PieceColor turn) const;
+
+ private:
+  const Network& network_;
+  std::vector<Accumulator> accumulators_;
+  size_t size_{};
+};
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "board.hpp"
+
+// Tile names like e4, and -1 for anything else
+std::string get_tile_name(int tile);
+int parse_tile_name(std::string_view name);
+
+// Coordinate notation as used by UCI, like e2e4 or e7e8q
+std::string to_uci_move(Board::Move move);
+
+// Returns an empty move, with tile -1, if the text is not a legal move
+Board::Move parse_uci_move(const Board& board, std::string_view text);
+
+// Standard algebraic notation as used by PGN, like Nbd7, exd8=Q+ or O-O. The
+// board is the one before the move, it is moved and undone to find checks and
+// is left as it was. Names fit the small string buffer, nothing allocates.
+std::string to_san_move(Board& board, Board::Move move);
+
+// Accepts check, mate and annotation marks but does not need them, and 0-0
+// for O-O. Returns an empty move if the text is not exactly one legal move.
+Board::Move parse_san_move(const Board& board, std::string_view text);
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+
+#include "board.hpp"
+
+// Fixed-size cache of (key, depth) -> node count. Entries are two words where
+// the first is the key XOR the second, so a torn write from another thread is
+// seen as a miss instead of a wrong count and no locking is needed.
+class PerftTable {
+  struct Entry {
+    std::atomic<uint64_t> key;
+    std::atomic<uint64_t> data;
+  };
+
+  static constexpr size_t k_bucket_size{4};
+
+  struct alignas(64) Bucket {
+    std::array<Entry, k_bucket_size> entries;
+  };
+
+ public:
+  explicit PerftTable(size_t size_mb);
+
+  [[nodiscard]] bool probe(uint64_t hash, int depth, uint64_t& nodes) const;
+  void store(uint64_t hash, int depth, uint64_t nodes);
+  void clear();
+
+  [[nodiscard]] size_t get_size() const { return bucket_count_; }
+
+ private:
+  [[nodiscard]] Bucket& get_bucket(uint64_t hash) const {
+    return buckets_[hash & (bucket_count_ - 1)];
+  }
+
+  size_t bucket_count_{};
+  std::unique_ptr<Bucket[]> buckets_;
+};
+
+struct PerftOptions {
+  // Count the legal moves at depth 1 instead of playing them
+  bool bulk_counting{true};
+  PerftTable* table{};
+};
+
+uint64_t perft(Board& board, int depth, const PerftOptions& options);
+
+struct PerftSplit {
+  Board::Move move;
+  uint64_t nodes{};
+};
+
+using PerftDivide = std::vector<PerftSplit>;
+
+// Node count below every root move, computed on a pool of threads that each
+// work on their own copy of the board. The first two plies are split into
+// separate jobs so that a few heavy root moves do not serialize the run, the
+// table in the options, if any, is shared by all workers.
+PerftDivide perft_divide(const Board& board, int depth, int threads,
+                         const PerftOptions& options);
+
+uint64_t perft_parallel(const Board& board, int depth, int threads,
+                        const PerftOptions& options);
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <functional>
+#include <iosfwd>
+
+#include "board.hpp"
+
+struct PgnTag {
+  std::string name;
+  std::string value;
+};
+
+struct PgnGame {
+  std::vector<PgnTag> tags;
+  // Lines joined by spaces, comments and variations included
+  std::string movetext;
+
+  // Empty if the game has no such tag
+  [[nodiscard]] std::string_view get_tag(std::string_view name) const;
+};
+
+// Reads the games of a PGN stream one at a time. The input is read in fixed
+// chunks as it is needed, so memory stays bounded by the longest line and the
+// largest game however long the stream is. Games end at a blank line or at
+// the tags of the next game, lines starting with % are skipped.
+class PgnReader {
+ public:
+  explicit PgnReader(std::istream& input);
+
+  // Reuses the storage of game, false once the input has no more games
+  bool read_game(PgnGame& game);
+
+ private:
+  // Valid until the next call, without the line break
+  bool read_line(std::string_view& line);
+
+  std::istream& input_;
+  std::vector<char> buffer_;
+  size_t begin_{};
+  size_t end_{};
+
+  // Tags that ended the previous game and start the next one
+  std::string_view pending_line_;
+  bool has_pending_line_{};
+};
+
+// Called with the board before each move, which may be changed as long as it
+// is left as it was, like to_san_move() does
+using PgnMoveCallback = std::function<void(Board& board, Board::Move move)>;
+
+// Sets up the position of the FEN tag, or the start position, and plays the
+// movetext through Board::move() without allocating. Comments, variations,
+// move numbers and annotations are skipped, the result ends the game. Returns
+// false at the first move that is not legal SAN, with the board just before
+// it.
+bool replay_pgn_game(const PgnGame& game, Board& board,
+                     const PgnMoveCallback& on_move = {});
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <glad/gl.h>
+
+#include <chrono>
+#include <span>
+
+#include "common.hpp"
+#include "fixed_stack.hpp"
+
+// Times named zones of a frame on the CPU and, for zones that issue GL
+// commands, on the GPU with GL_TIME_ELAPSED queries. Those can't nest, so GPU
+// zones must not overlap. Each zone has a query for every frame in flight and
+// results are collected when the query comes around again, reading them never
+// waits on the GPU.
+class Profiler {
+  static constexpr size_t k_max_zones{8};
+  static constexpr size_t k_query_frames{2};
+
+ public:
+  struct Zone {
+    const char* name{};
+    bool gpu{};
+    // Latest results, the GPU time lags a frame or two behind
+    double cpu_ms{};
+    double gpu_ms{};
+  };
+
+  // Opens a zone for the rest of the scope
+  class Scope {
+   public:
+    Scope(Profiler& profiler, const char* name, bool gpu = false)
+        : profiler_{profiler} {
+      profiler_.begin_zone(name, gpu);
+    }
+
+    ~Scope() { profiler_.end_zone(); }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+    Scope(Scope&&) = delete;
+    Scope& operator=(Scope&&) = delete;
+
+   private:
+    Profiler& profiler_;
+  };
+
+  Profiler();
+
+  ~Profiler();
+
+  Profiler(const Profiler&) = delete;
+  Profiler& operator=(const Profiler&) = delete;
+
+  Profiler(Profiler&&) = delete;
+  Profiler& operator=(Profiler&&) = delete;
+
+  // Disabled zones cost a branch, enabling starts over with no zones
+  void set_enabled(bool enabled);
+  [[nodiscard]] bool is_enabled() const { return enabled_; }
+
+  // Zones may only be open between these
+  void begin_frame();
+  void end_frame();
+
+  // Zones are told apart by the address of their name, pass string literals
+  void begin_zone(const char* name, bool gpu);
+  void end_zone();
+
+  [[nodiscard]] std::span<const Zone> get_zones() const {
+    return {zones_.data(), zone_count_};
+  }
+
+ private:
+  bool enabled_{};
+  size_t frame_{};
+
+  std::array<Zone, k_max_zones> zones_{};
+  size_t zone_count_{};
+
+  std::array<std::array<GLuint, k_max_zones>, k_query_frames> queries_{};
+  std::array<std::array<bool, k_max_zones>, k_query_frames> queries_issued_{};
+  bool query_active_{};
+
+  struct OpenZone {
+    size_t index{};
+    std::chrono::steady_clock::time_point start;
+  };
+
+  FixedStack<OpenZone, k_max_zones> open_zones_;
+};
@@ -4,8 +4,11 @@
 
 #include <deque>
 #include <glm/gtc/type_ptr.hpp>
+#include <span>
 
 #include "camera.hpp"
+#include "image.hpp"
+#include "thread_pool.hpp"
 
 struct GLFWwindow;
 
@@ -15,16 +18,36 @@ struct Transform {
   float scale{1.0F};
 };
 
+// Per-instance vertex data, one entry for every copy of a model in a draw
+struct Instance {
+  glm::mat4 model{1.0F};
+  // Written out by the picking shader
+  int id{-1};
+};
+
 struct Vertex {
   glm::vec3 position{};
   glm::vec3 normal{};
   glm::vec2 tex_coord{};
 };
 
+// Lets uniforms be looked up by string_view without building a std::string
+struct StringHash {
+  using is_transparent = void;
+  size_t operator()(std::string_view text) const {
+    return std::hash<std::string_view>{}(text);
+  }
+};
+
+using UniformLocations =
+    std::unordered_map<std::string, GLint, StringHash, std::equal_to<>>;
+
 struct Shader {
   fs::path vert_path;
   fs::path frag_path;
   GLuint id{};
+  // Every active uniform, read once after linking
+  UniformLocations uniform_locations;
 };
 
 struct Texture {
@@ -44,6 +67,9 @@ struct Mesh {
   GLuint vbo{};
   GLuint ebo{};
   GLsizei index_count{};
+  // Holds the Instance array of the latest draw, grows on demand
+  GLuint instance_vbo{};
+  size_t instance_capacity{};
   Material* default_;
   Material* white;
   Material* black;
@@ -56,7 +82,26 @@ struct Model {
 
 enum class Framebuffer : GLuint;
 
+// GL work submitted between begin_drawing and end_drawing
+struct FrameStats {
+  int draw_calls{};
+  int instances{};
+  // glUniform calls and uniform buffer writes
+  int uniform_uploads{};
+};
+
 class Renderer {
+  // Uniform buffer binding of the Camera block in the shaders
+  static constexpr GLuint k_camera_binding{0};
+
+  // Pixel reads in flight at once, one for the frame being drawn and one for
+  // the frame the GPU is still working on
+  static constexpr size_t k_pixel_buffers{2};
+
+  // Instances a model buffer starts out with, enough for every piece of one
+  // type and color
+  static constexpr size_t k_initial_instances{16};
+
  public:
   explicit Renderer(GLFWwindow* window);
 
@@ -72,11 +117,19 @@ class Renderer {
   static void destroy_shader(Shader* shader);
   void bind_shader(Shader* shader);
 
-#define SET_SHADER_UNIFORM_IMPL(type, uniform, ...)                       \
-  static void set_shader_uniform(Shader* shader, std::string_view name,   \
-                                 type value) {                            \
-    const GLint location = glGetUniformLocation(shader->id, name.data()); \
-    uniform(location, __VA_ARGS__);                                       \
+  // -1 for unknown names, which GL ignores like it does for inactive uniforms
+  static GLint get_uniform_location(const Shader* shader,
+                                    std::string_view name) {
+    const auto it{shader->uniform_locations.find(name)};
+    return it != shader->uniform_locations.end() ? it->second : -1;
+  }
+
+#define SET_SHADER_UNIFORM_IMPL(type, uniform, ...)              \
+  void set_shader_uniform(Shader* shader, std::string_view name, \
+                          type value) {                          \
+    const GLint location = get_uniform_location(shader, name);   \
+    uniform(location, __VA_ARGS__);                              \
+    stats_.uniform_uploads++;                                    \
   }
 
   SET_SHADER_UNIFORM_IMPL(int, glUniform1i, value);
@@ -89,12 +142,20 @@ class Renderer {
                           glm::value_ptr(value));
 #undef SET_SHADER_UNIFORM_IMPL
 
+  // Decodes on worker threads, the texture can be used right away but has no
+  // image until upload_textures()
   Texture* create_texture(const fs::path& path);
+  // Waits for the pending decodes and uploads them, false if any failed
+  bool upload_textures();
   static void destroy_texture(Texture* texture);
 
   Model* create_model(const fs::path& path);
   static void destroy_model(Model* model);
-  void draw_model(const Transform& transform, Model* model, Material* material);
+  void draw_model(const Transform& transform, Model* model, Material* material,
+                  int id = -1);
+  // One draw call for all instances, they share the model and material
+  void draw_model_instances(Model* model, Material* material,
+                            std::span<const Instance> instances);
   void draw_model_outline(const Transform& transform, Model* model,
                           float thickness, const glm::vec4& color);
 
@@ -104,7 +165,16 @@ class Renderer {
   void unbind_framebuffer(GLenum target);
   static void clear_framebuffer();
 
-  static int read_pixel(const glm::ivec2& coord);
+  // Queues a read of one pixel of the bound read framebuffer into a pixel
+  // buffer object, nothing waits for the GPU. Requests are dropped, returning
+  // false, while all buffers are still in flight.
+  bool request_pixel(const glm::ivec2& coord);
+  // Takes the oldest request once the GPU has written it, usually a frame
+  // after it was made. False if there is none or it is not done yet.
+  bool poll_pixel(int& value);
+  [[nodiscard]] bool is_pixel_pending() const { return pixel_pending_ != 0; }
+
+  static glm::mat4 calculate_model_matrix(const Transform& transform);
 
   void begin_drawing(Camera& camera);
   void end_drawing();
@@ -118,10 +188,23 @@ class Renderer {
 
   [[nodiscard]] GLFWwindow* get_window() const { return window_; }
 
+  // Of the frame being drawn, or the last one after end_drawing
+  [[nodiscard]] const FrameStats& get_frame_stats() const { return stats_; }
+
  private:
   GLFWwindow* window_{};
 
+  FrameStats stats_;
+
   Camera* camera_{};
+  // Projection, view and camera position, written once per frame
+  GLuint camera_buffer_{};
+
+  // Ring of pending pixel reads, each completes when its fence signals
+  std::array<GLuint, k_pixel_buffers> pixel_buffers_{};
+  std::array<GLsync, k_pixel_buffers> pixel_fences_{};
+  size_t pixel_head_{};
+  size_t pixel_pending_{};
 
   Shader* bound_shader_{};
   Material* bound_material_{};
@@ -132,4 +215,16 @@ class Renderer {
   std::deque<Material> materials_;
   std::deque<Model> models_;
   std::deque<Framebuffer> framebuffers_;
+
+  struct PendingTexture {
+    Texture* texture{};
+    std::future<Image> image;
+  };
+
+  std::vector<PendingTexture> pending_textures_;
+  // What the driver accepts for glCompressedTexImage2D
+  std::vector<GLint> compressed_formats_;
+
+  // Only alive while textures are decoding
+  std::unique_ptr<ThreadPool> texture_pool_;
 };
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <stop_token>
+
+#include "board.hpp"
+#include "thread_pool.hpp"
+#include "transposition.hpp"
+
+class Network;
+class Tablebases;
+
+inline constexpr int k_max_ply{128};
+
+inline constexpr int k_infinity{32000};
+inline constexpr int k_mate_score{31000};
+
+// Scores at or beyond this are mates, k_mate_score - |score| plies away
+inline constexpr int k_mate_bound{k_mate_score - k_max_ply};
+
+inline constexpr size_t k_default_hash_mb{16};
+
+struct SearchLimits {
+  int depth{k_max_ply - 1};
+  // Zero means no limit
+  std::chrono::milliseconds movetime{};
+  // Counted on the main thread only
+  uint64_t nodes{};
+};
+
+struct SearchResult {
+  Board::Move best_move;
+  int score{};
+  // Last completed iteration
+  int depth{};
+  // Summed over all threads
+  uint64_t nodes{};
+  std::chrono::milliseconds time{};
+  uint64_t nps{};
+  std::vector<Board::Move> pv;
+};
+
+// Negamax alpha-beta with iterative deepening and quiescence search. With more
+// than one thread it runs Lazy SMP: every thread searches the same position on
+// its own and they only share the transposition table, helpers start at
+// staggered depths so they fill the table ahead of the main thread. With one
+// thread and a cleared table, searches without a movetime limit are
+// deterministic.
+class Search {
+ public:
+  // Called after every completed iteration of the main thread
+  using IterationCallback = std::function<void(const SearchResult&)>;
+
+  explicit Search(size_t hash_mb = k_default_hash_mb, int threads = 1);
+
+  // A stop request, which may come from another thread, ends the search with
+  // the result of the last completed iteration
+  SearchResult run(const Board& board, const SearchLimits& limits,
+                   const IterationCallback& on_iteration = {},
+                   std::stop_token stop_token = {});
+
+  // None of these may be called while a search is running
+  void set_hash_size(size_t size_mb) { table_.resize(size_mb); }
+  void set_threads(int threads);
+  // They pick the root moves and are probed below the root, null to search
+  // without them
+  void set_tablebases(const Tablebases* tablebases) {
+    tablebases_ = tablebases;
+  }
+  // Evaluates with it instead of the piece-square tables, null for those
+  void set_network(const Network* network) { network_ = network; }
+  // Forgets everything learned in earlier searches, for a new game
+  void clear() { table_.clear(); }
+
+  [[nodiscard]] int get_threads() const { return threads_; }
+  [[nodiscard]] int get_hashfull() const { return table_.get_hashfull(); }
+
+ private:
+  TranspositionTable table_;
+  int threads_{1};
+  std::unique_ptr<ThreadPool> helpers_;
+  const Tablebases* tablebases_{};
+  const Network* network_{};
+};
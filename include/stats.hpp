@@ -0,0 +1,88 @@
+#pragma once
+
+#include <atomic>
+
+#include "piece.hpp"
+
+// Call counts on the hot paths of Board, only compiled in with CHESS_STATS.
+// Every thread counts into its own block, totals are summed over the running
+// threads and the ones that have finished. Without CHESS_STATS count_stat()
+// is empty and the totals stay zero.
+
+// #define CHESS_STATS
+
+#ifdef CHESS_STATS
+inline constexpr bool k_stats_enabled{true};
+#else
+inline constexpr bool k_stats_enabled{false};
+#endif
+
+enum class StatCounter : uint8_t {
+  Move,
+  Undo,
+  GenerateLegalMoves,
+  GeneratedMoves,
+  Evasions,
+  DoubleChecks,
+  // Pieces generate_legal_moves() went through, in PieceType order
+  KingSources,
+  QueenSources,
+  BishopSources,
+  KnightSources,
+  RookSources,
+  PawnSources,
+  PinnedSources,
+  // Candidates tested against attacks, the rejected ones would leave the king
+  // in check
+  KingTargetsTested,
+  KingTargetsRejected,
+  EnpassantTested,
+  EnpassantRejected,
+  IsThreatened,
+  IsLegalMove,
+  IllegalMoves,
+  Count
+};
+
+inline constexpr size_t k_stat_counter_count{to_underlying(StatCounter::Count)};
+
+using StatCounters = std::array<uint64_t, k_stat_counter_count>;
+
+// Only written by its thread, atomic so totals can be read while counting
+struct ThreadStats {
+  ThreadStats();
+  ~ThreadStats();
+
+  ThreadStats(const ThreadStats&) = delete;
+  ThreadStats& operator=(const ThreadStats&) = delete;
+
+  ThreadStats(ThreadStats&&) = delete;
+  ThreadStats& operator=(ThreadStats&&) = delete;
+
+  std::array<std::atomic<uint64_t>, k_stat_counter_count> counters{};
+};
+
+#ifdef CHESS_STATS
+inline thread_local ThreadStats thread_stats;
+#endif
+
+inline void count_stat([[maybe_unused]] StatCounter counter,
+                       [[maybe_unused]] uint64_t amount = 1) {
+#ifdef CHESS_STATS
+  std::atomic<uint64_t>& value{thread_stats.counters[to_underlying(counter)]};
+  value.store(value.load(std::memory_order_relaxed) + amount,
+              std::memory_order_relaxed);
+#endif
+}
+
+inline StatCounter get_source_counter(PieceType type) {
+  return static_cast<StatCounter>(to_underlying(StatCounter::KingSources) +
+                                  to_underlying(type) -
+                                  to_underlying(PieceType::King));
+}
+
+std::string_view get_stat_counter_name(StatCounter counter);
+
+StatCounters get_stat_counters();
+// Other threads should not be counting at the same time
+void reset_stat_counters();
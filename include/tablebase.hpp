@@ -0,0 +1,105 @@
+#pragma once
+
+#include <optional>
+
+#include "board.hpp"
+
+// Win, draw or loss with best play, from the side to move. The cursed and
+// blessed results are wins and losses that the fifty-move rule turns into
+// draws.
+enum class Wdl : int8_t {
+  Loss = -2,
+  BlessedLoss = -1,
+  Draw = 0,
+  CursedWin = 1,
+  Win = 2
+};
+
+// Syzygy tablebases found in a set of directories. Tables are looked up by
+// the material of the position and only mapped the first time they are
+// probed, the page cache holds them once for every thread and process. All
+// probes are thread-safe.
+//
+// WDL tables (.rtbw) hold the result of every position, DTZ tables (.rtbz)
+// the distance to the next capture or pawn move on the way to it, which is
+// what winning within the fifty-move rule takes. Decoding follows the probing
+// code published with the tables.
+class Tablebases {
+ public:
+  Tablebases();
+
+  Tablebases(const Tablebases&) = delete;
+  Tablebases& operator=(const Tablebases&) = delete;
+
+  Tablebases(Tablebases&&) = delete;
+  Tablebases& operator=(Tablebases&&) = delete;
+
+  ~Tablebases();
+
+  // Directories are separated as in PATH, returns how many WDL tables were
+  // found. Not thread-safe, probes may not run at the same time.
+  int init(std::string_view paths);
+  void clear();
+
+  // Positions with more pieces have no table
+  [[nodiscard]] int get_max_pieces() const { return max_pieces_; }
+
+  // The tables leave out positions decided by a capture, so probes try the
+  // captures on the board and take them back. Empty when a table is missing
+  // or the position can't be probed, which is always the case with castling
+  // rights.
+  [[nodiscard]] std::optional<Wdl> probe_wdl(Board& board) const;
+
+  // Plies to the next capture or pawn move with best play, positive when
+  // winning and zero for a draw. Cursed wins and blessed losses count 100
+  // plies more.
+  [[nodiscard]] std::optional<int> probe_dtz(Board& board) const;
+
+  // Keeps the root moves that do best by the tables: the fastest win that
+  // the fifty-move rule allows, or the longest defence. Ranked by DTZ when
+  // those tables are there, by WDL otherwise. False if the root can't be
+  // probed, the moves are left as they were.
+  bool filter_root_moves(Board& board, Board::Moves& moves) const;
+
+ private:
+  // Defined with the decoder
+  struct Table;
+
+  enum class TableType : uint8_t { Wdl, Dtz };
+
+  // What a probe found besides its value
+  enum class ProbeState : uint8_t {
+    Failed,
+    Ok,
+    // DTZ tables only hold one side to move, this is the other one
+    ChangeTurn,
+    // The best move is a capture or pawn move, its DTZ value is not stored
+    ZeroingBestMove
+  };
+
+  // Value stored for the position, a WDL or a DTZ in the encoding of the
+  // table, without trying any moves
+  int probe_table(const Board& board, TableType type, Wdl wdl,
+                  ProbeState& state) const;
+
+  // Best of the stored value and the captures, with check_zeroing the pawn
+  // moves too, which DTZ tables don't store when they win
+  Wdl search_wdl(Board& board, bool check_zeroing, ProbeState& state) const;
+  int search_dtz(Board& board, ProbeState& state) const;
+
+  // Ranks for filter_root_moves(), higher is better
+  bool rank_by_dtz(Board& board, const Board::Moves& moves,
+                   std::array<int, 256>& ranks) const;
+  bool rank_by_wdl(Board& board, const Board::Moves& moves,
+                   std::array<int, 256>& ranks) const;
+
+  // Maps the file on the first probe, false if it is not a valid table
+  static bool map_table(Table& table, TableType type);
+  static bool read_table(Table& table, TableType type);
+
+  std::vector<std::unique_ptr<Table>> tables_;
+  // Positions with the material of a table, as named and with the colors
+  // swapped, which Syzygy stores once
+  std::unordered_map<uint64_t, Table*> entries_;
+  int max_pieces_{};
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+
+#include "common.hpp"
+
+// Fixed set of worker threads consuming a FIFO of tasks
+class ThreadPool {
+ public:
+  // Zero or fewer threads means one per hardware thread
+  explicit ThreadPool(int threads = 0);
+
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  ThreadPool(ThreadPool&&) = delete;
+  ThreadPool& operator=(ThreadPool&&) = delete;
+
+  template <typename F>
+  auto submit(F&& task) -> std::future<std::invoke_result_t<F>> {
+    using Result = std::invoke_result_t<F>;
+    auto packaged{
+        std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task))};
+    std::future<Result> future{packaged->get_future()};
+    {
+      const std::lock_guard lock{mutex_};
+      tasks_.emplace_back([packaged] { (*packaged)(); });
+    }
+    condition_.notify_one();
+    return future;
+  }
+
+  [[nodiscard]] int get_size() const {
+    return static_cast<int>(threads_.size());
+  }
+
+ private:
+  void work();
+
+  std::vector<std::thread> threads_;
+
+  std::mutex mutex_;
+  std::condition_variable condition_;
+  std::deque<std::function<void()>> tasks_;
+  bool stopping_{};
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+
+#include "board.hpp"
+
+enum class Bound : uint8_t { None, Upper, Lower, Exact };
+
+struct TranspositionEntry {
+  Board::Move move;
+  int score{};
+  int depth{};
+  Bound bound{};
+};
+
+// Search results shared by all search threads. Like the perft table, entries
+// are two words where the first is the key XOR the second, so torn writes are
+// seen as misses and no locking is needed. Four entries fill a cache line.
+class TranspositionTable {
+  struct Entry {
+    std::atomic<uint64_t> key;
+    std::atomic<uint64_t> data;
+  };
+
+  static constexpr size_t k_bucket_size{4};
+
+  struct alignas(64) Bucket {
+    std::array<Entry, k_bucket_size> entries;
+  };
+
+ public:
+  explicit TranspositionTable(size_t size_mb);
+
+  // Drops all entries
+  void resize(size_t size_mb);
+  void clear();
+
+  // Ages the entries of previous searches so they get replaced first
+  void new_search() { generation_++; }
+
+  [[nodiscard]] bool probe(uint64_t hash, TranspositionEntry& entry) const;
+  void store(uint64_t hash, const TranspositionEntry& entry);
+
+  // Permille of sampled entries written by the current search
+  [[nodiscard]] int get_hashfull() const;
+
+  [[nodiscard]] size_t get_size() const { return bucket_count_; }
+
+ private:
+  [[nodiscard]] Bucket& get_bucket(uint64_t hash) const {
+    return buckets_[hash & (bucket_count_ - 1)];
+  }
+
+  size_t bucket_count_{};
+  std::unique_ptr<Bucket[]> buckets_;
+  uint8_t generation_{};
+};
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <iosfwd>
+#include <mutex>
+#include <random>
+#include <thread>
+
+#include "book.hpp"
+#include "nnue.hpp"
+#include "search.hpp"
+#include "tablebase.hpp"
+
+// Universal Chess Interface front end, reads commands from the input until
+// quit and writes the replies to the output. Searches run on their own thread
+// so stop and isready are answered while searching.
+class Uci {
+ public:
+  Uci(std::istream& input, std::ostream& output);
+
+  Uci(const Uci&) = delete;
+  Uci& operator=(const Uci&) = delete;
+
+  Uci(Uci&&) = delete;
+  Uci& operator=(Uci&&) = delete;
+
+  ~Uci() = default;
+
+  void run();
+
+ private:
+  void handle_uci();
+  void handle_position(std::istream& args);
+  void handle_go(std::istream& args);
+  void handle_setoption(std::istream& args);
+  void handle_perft(int depth);
+  // Writes the Board call counters since the last stats and resets them
+  void handle_stats();
+
+  // Both block until the running search, if any, has printed its best move.
+  // Commands other than stop let the search finish, like a GUI expects.
+  void stop_search();
+  void wait_for_search();
+
+  // Lines are written whole and flushed, the search thread writes too
+  void write(const std::string& line);
+
+  std::istream& input_;
+  std::ostream& output_;
+  std::mutex output_mutex_;
+
+  Board board_;
+  Search search_;
+
+  OpeningBook book_;
+  bool own_book_{};
+  std::mt19937_64 random_{std::random_device{}()};
+
+  Tablebases tablebases_;
+  Network network_;
+
+  // Last so a running search is stopped before anything it uses is destroyed
+  std::jthread search_thread_;
+};
@@ -9,7 +9,12 @@ in vec2 tex_coord;
 uniform sampler2D base_tex;
 
 uniform vec3 light_pos;
-uniform vec3 view_pos;
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec4 camera_position;
+};
 
 const float ambient_strength = 0.25;
 const float specular_strength = 0.75;
@@ -24,7 +29,7 @@ void main() {
     float diff = max(dot(norm, light_dir), 0.0);
     vec3 diffuse = diff * diffuse_tex;
 
-    vec3 view_dir = normalize(view_pos - frag_pos);
+    vec3 view_dir = normalize(camera_position.xyz - frag_pos);
     vec3 reflect_dir = reflect(-light_dir, norm);
     float spec = pow(max(dot(view_dir, reflect_dir), 0.0), 32.0);
     vec3 specular = specular_strength * spec * diffuse_tex;
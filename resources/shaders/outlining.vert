@@ -2,13 +2,16 @@
 
 layout (location = 0) in vec3 a_position;
 layout (location = 1) in vec3 a_normal;
+layout (location = 3) in mat4 a_model;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec4 camera_position;
+};
 
 uniform float outline_thickness;
 
 void main() {
-    gl_Position = projection * view * model * vec4(a_position + a_normal * outline_thickness, 1.0f);
+    gl_Position = projection * view * a_model * vec4(a_position + a_normal * outline_thickness, 1.0f);
 }
@@ -2,8 +2,8 @@
 
 out int frag_color;
 
-uniform int color;
+flat in int id;
 
 void main() {
-    frag_color = color;
+    frag_color = id;
 }
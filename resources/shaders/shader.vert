@@ -3,14 +3,21 @@
 layout (location = 0) in vec3 a_position;
 layout (location = 1) in vec3 a_normal;
 layout (location = 2) in vec2 a_tex_coord;
+layout (location = 3) in mat4 a_model;
+layout (location = 7) in int a_id;
 
 out vec2 tex_coord;
+// Only read by the picking shader
+flat out int id;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec4 camera_position;
+};
 
 void main() {
-    gl_Position = projection * view * model * vec4(a_position, 1.0f);
+    gl_Position = projection * view * a_model * vec4(a_position, 1.0f);
     tex_coord = a_tex_coord;
+    id = a_id;
 }
@@ -0,0 +1,15 @@
+#include "async_search.hpp"
+
+AsyncSearch::~AsyncSearch() { stop(); }
+
+std::future<SearchResult> AsyncSearch::start(const Board& board,
+                                             const SearchLimits& limits) {
+  stop();
+  stop_source_ = {};
+  return pool_.submit(
+      [this, board, limits, stop_token = stop_source_.get_token()] {
+        return search_.run(board, limits, {}, stop_token);
+      });
+}
+
+void AsyncSearch::stop() { stop_source_.request_stop(); }
@@ -0,0 +1,73 @@
+#include "attacks.hpp"
+
+namespace {
+
+// Carry-Rippler enumerates the blocker subsets of a mask in the same order as
+// their PEXT index, so the slot of the n-th subset is simply n on that path
+constexpr void fill_slider_attacks(SliderAttacks& attacks,
+                                   const std::array<SliderMagic, 64>& magics,
+                                   bool rook) {
+  for (int tile = 0; tile < 64; tile++) {
+    const SliderMagic& magic{magics[tile]};
+#ifdef USE_PEXT
+    uint32_t index{};
+#endif
+    Bitboard blockers{};
+    do {
+#ifdef USE_PEXT
+      const uint32_t slot{index++};
+#else
+      const uint32_t slot{get_magic_index(magic, blockers)};
+#endif
+      attacks[magic.offset + slot] =
+          rook ? calculate_rook_attacks(tile, blockers)
+               : calculate_bishop_attacks(tile, blockers);
+      blockers = (blockers - magic.mask) & magic.mask;
+    } while (blockers != 0);
+  }
+}
+
+}  // namespace
+
+constexpr SliderAttacks k_slider_attacks{[] {
+  SliderAttacks attacks{};
+  fill_slider_attacks(attacks, k_rook_magics, true);
+  fill_slider_attacks(attacks, k_bishop_magics, false);
+  return attacks;
+}()};
+
+constexpr TilePairs k_between_tiles{[] {
+  TilePairs between{};
+  for (int tile = 0; tile < 64; tile++) {
+    for (int target = 0; target < 64; target++) {
+      const Bitboard tiles{tile_bitboard(tile) | tile_bitboard(target)};
+      if (has_tile(calculate_rook_attacks(tile, 0), target)) {
+        between[tile][target] = calculate_rook_attacks(tile, tiles) &
+                                calculate_rook_attacks(target, tiles);
+      } else if (has_tile(calculate_bishop_attacks(tile, 0), target)) {
+        between[tile][target] = calculate_bishop_attacks(tile, tiles) &
+                                calculate_bishop_attacks(target, tiles);
+      }
+    }
+  }
+  return between;
+}()};
+
+constexpr TilePairs k_lines{[] {
+  TilePairs lines{};
+  for (int tile = 0; tile < 64; tile++) {
+    for (int target = 0; target < 64; target++) {
+      const Bitboard tiles{tile_bitboard(tile) | tile_bitboard(target)};
+      if (has_tile(calculate_rook_attacks(tile, 0), target)) {
+        lines[tile][target] = (calculate_rook_attacks(tile, 0) &
+                               calculate_rook_attacks(target, 0)) |
+                              tiles;
+      } else if (has_tile(calculate_bishop_attacks(tile, 0), target)) {
+        lines[tile][target] = (calculate_bishop_attacks(tile, 0) &
+                               calculate_bishop_attacks(target, 0)) |
+                              tiles;
+      }
+    }
+  }
+  return lines;
+}()};
@@ -1,35 +1,101 @@
 #include "board.hpp"
 
+#include <algorithm>
+#include <charconv>
+
+#include "attacks.hpp"
+#include "stats.hpp"
+
+namespace {
+
+constexpr std::string_view k_piece_chars{" kqbnrp"};
+
+// Splits off the next field, empty once the text runs out
+std::string_view next_fen_field(std::string_view& text) {
+  constexpr std::string_view k_whitespace{" \t\r\n"};
+
+  const size_t begin{
+      std::min(text.find_first_not_of(k_whitespace), text.size())};
+  const size_t end{
+      std::min(text.find_first_of(k_whitespace, begin), text.size())};
+  const std::string_view field{text.substr(begin, end - begin)};
+  text.remove_prefix(end);
+  return field;
+}
+
+bool parse_fen_number(std::string_view text, int& value) {
+  const auto* end{text.data() + text.size()};
+  const auto [ptr, error]{std::from_chars(text.data(), end, value)};
+  return error == std::errc{} && ptr == end;
+}
+
+Piece parse_piece_char(char ch) {
+  const bool white{ch >= 'A' && ch <= 'Z'};
+  const size_t index{
+      k_piece_chars.find(white ? static_cast<char>(ch - 'A' + 'a') : ch)};
+  if (index == std::string_view::npos || index == 0) {
+    return {};
+  }
+  return make_piece(white ? PieceColor::White : PieceColor::Black,
+                    static_cast<PieceType>(index));
+}
+
+char get_piece_char(Piece piece) {
+  const char ch{k_piece_chars[to_underlying(get_piece_type(piece))]};
+  return get_piece_color(piece) == PieceColor::White
+             ? static_cast<char>(ch - 'a' + 'A')
+             : ch;
+}
+
+}  // namespace
+
 Board::Board() { load_fen(); }
 
 void Board::move(Move move) {
   ASSERT(get_color(move.tile) != PieceColor::None &&
          get_type(move.tile) != PieceType::None);
+  count_stat(StatCounter::Move);
+
+  MoveRecord& record{records_.emplace_back(
+      hash_, move, get_tile(move.target), castling_rights_,
+      static_cast<int8_t>(enpassant_tile_),
+      static_cast<uint8_t>(halfmove_clock_))};
+  hash_ ^= get_castling_key() ^ get_enpassant_key();
+
+  if (get_type(move.tile) == PieceType::Pawn ||
+      get_piece_type(record.captured_piece) != PieceType::None) {
+    halfmove_clock_ = 0;
+  } else if (halfmove_clock_ < 255) {
+    halfmove_clock_++;
+  }
 
-  const MoveRecord& record{
-      records_.emplace_back(move, move.promotion, get_tile(move.target),
-                            castling_rights_, enpassant_tile_)};
   set_tile(move.target, get_tile(move.tile));
   set_tile(move.tile, {});
 
+  if (turn_ == PieceColor::Black) {
+    fullmove_number_++;
+  }
   turn_ = get_opposite_color(turn_);
   enpassant_tile_ = -1;
 
-  const uint8_t color_index{get_color_index(get_color(move.target))};
-  if (castling_rights_[color_index] != CastlingRight::None &&
-      get_piece_type(record.captured_piece) == PieceType::Rook) {
-    clear_castling_rights(move.target, get_piece_color(record.captured_piece));
+  // Taking a rook on its home tile costs the captured side that right
+  if (const PieceColor captured_color{get_piece_color(record.captured_piece)};
+      get_piece_type(record.captured_piece) == PieceType::Rook &&
+      castling_rights_[get_color_index(captured_color)] !=
+          CastlingRight::None) {
+    clear_castling_rights(move.target, captured_color);
   }
 
+  const uint8_t color_index{get_color_index(get_color(move.target))};
+
   switch (get_type(move.target)) {
     case PieceType::King:
-      if (glm::abs(move.target - move.tile) == 2) {
+      if (std::abs(move.target - move.tile) == 2) {
         const int rook_tile{move.tile + (move.tile < move.target ? 3 : -4)};
         set_tile((move.tile + move.target) / 2, get_tile(rook_tile));
         set_tile(rook_tile, {});
       }
       castling_rights_[color_index] = CastlingRight::None;
-      king_tiles_[color_index] = move.target;
       break;
     case PieceType::Rook:
       if (castling_rights_[color_index] != CastlingRight::None) {
@@ -37,13 +103,13 @@ void Board::move(Move move) {
       }
       break;
     case PieceType::Pawn:
-      if (glm::abs(move.target - move.tile) == 16) {
+      if (std::abs(move.target - move.tile) == 16) {
         enpassant_tile_ = (move.tile + move.target) / 2;
       } else if (move.target == record.enpassant_tile) {
         const int captured_tile{
             move.target +
             (get_color(move.target) == PieceColor::White ? -8 : 8)};
-        records_.back().captured_piece = get_tile(captured_tile);
+        record.captured_piece = get_tile(captured_tile);
         set_tile(captured_tile, {});
       } else if (move.promotion != PieceType::None) {
         set_tile(move.target,
@@ -53,58 +119,74 @@ void Board::move(Move move) {
     default:
       break;
   }
+
+  hash_ ^= get_castling_key() ^ get_enpassant_key() ^ k_zobrist_keys.turn;
 }
 
 void Board::undo() {
   if (records_.empty()) {
     return;
   }
+  count_stat(StatCounter::Undo);
 
-  const MoveRecord& record{records_.back()};
-  const PieceType moved_type{get_type(record.move.target)};
-  set_tile(record.move.tile, get_tile(record.move.target));
-
-  int captured_tile{record.move.target};
-  if (moved_type == PieceType::Pawn &&
-      record.enpassant_tile == record.move.target) {
-    captured_tile =
-        record.move.target +
-        (get_color(record.move.target) == PieceColor::White ? -8 : 8);
-    set_tile(record.move.target, {});
-  }
-
-  set_tile(captured_tile, record.captured_piece);
-
-  if (moved_type == PieceType::King) {
-    if (glm::abs(record.move.target - record.move.tile) == 2) {
-      set_tile(
-          record.move.tile + (record.move.tile < record.move.target ? 3 : -4),
-          make_piece(
-              record.move.target < 8 ? PieceColor::White : PieceColor::Black,
-              PieceType::Rook));
-      set_tile((record.move.tile + record.move.target) / 2, {});
-    }
-    king_tiles_[get_color_index(get_color(record.move.tile))] =
-        record.move.tile;
+  // Added tiles are cleared first, a capture puts a piece back on one of them
+  const MoveChanges changes{get_last_move_changes()};
+  for (const PieceChange& change : changes.added) {
+    set_tile(change.tile, {});
   }
-
-  if (record.promotion != PieceType::None) {
-    set_tile(record.move.tile,
-             make_piece(
-                 record.move.target < 8 ? PieceColor::Black : PieceColor::White,
-                 PieceType::Pawn));
+  for (const PieceChange& change : changes.removed) {
+    set_tile(change.tile, change.piece);
   }
 
+  const MoveRecord& record{records_.back()};
   turn_ = get_opposite_color(turn_);
+  if (turn_ == PieceColor::Black) {
+    fullmove_number_--;
+  }
   castling_rights_ = record.castling_rights;
   enpassant_tile_ = record.enpassant_tile;
+  halfmove_clock_ = record.halfmove_clock;
+  hash_ = record.hash;
 
   records_.pop_back();
 }
 
+Board::MoveChanges Board::get_last_move_changes() const {
+  ASSERT(!records_.empty());
+
+  const MoveRecord& record{records_.back()};
+  const Move move{record.move};
+  const Piece piece{get_tile(move.target)};
+  const PieceColor color{get_piece_color(piece)};
+
+  MoveChanges changes;
+  changes.removed.emplace_back(move.promotion != PieceType::None
+                                   ? make_piece(color, PieceType::Pawn)
+                                   : piece,
+                               move.tile);
+  changes.added.emplace_back(piece, move.target);
+
+  if (get_piece_type(record.captured_piece) != PieceType::None) {
+    int captured_tile{move.target};
+    if (get_piece_type(piece) == PieceType::Pawn &&
+        move.target == record.enpassant_tile) {
+      captured_tile += color == PieceColor::White ? -8 : 8;
+    }
+    changes.removed.emplace_back(record.captured_piece, captured_tile);
+  } else if (get_piece_type(piece) == PieceType::King &&
+             std::abs(move.target - move.tile) == 2) {
+    const Piece rook{make_piece(color, PieceType::Rook)};
+    changes.removed.emplace_back(
+        rook, move.tile + (move.tile < move.target ? 3 : -4));
+    changes.added.emplace_back(rook, (move.tile + move.target) / 2);
+  }
+
+  return changes;
+}
+
 void Board::get_moves(Moves& moves, int tile) {
   if (turn_ == get_color(tile)) {
-    generate_legal_moves(moves, tile);
+    generate_legal_moves(moves, tile_bitboard(tile));
   }
 }
 
@@ -113,20 +195,78 @@ bool Board::is_game_over() {
     return false;
   }
 
+  // Treated as a draw once the history is full
+  return records_.full() || !has_any_legal_move();
+}
+
+void Board::generate_all(Moves& moves) const {
+  generate_legal_moves(moves, get_color_bitboard(turn_));
+}
+
+void Board::generate_noisy(Moves& moves) const {
+  generate_legal_moves(moves, get_color_bitboard(turn_), Generation::Noisy);
+}
+
+void Board::generate_quiet(Moves& moves) const {
+  generate_legal_moves(moves, get_color_bitboard(turn_), Generation::Quiet);
+}
+
+bool Board::is_legal_move(Move move) const {
+  count_stat(StatCounter::IsLegalMove);
+  if (!is_valid_tile(move.tile) || !is_valid_tile(move.target)) {
+    count_stat(StatCounter::IllegalMoves);
+    return false;
+  }
+
   Moves moves;
-  for (int i = 0; i < 64; i++) {
-    if (turn_ == get_color(i)) {
-      get_moves(moves, i);
+  generate_legal_moves(moves, tile_bitboard(move.tile));
+  const bool is_legal{std::find(moves.data.begin(),
+                                moves.data.begin() + moves.size,
+                                move) != moves.data.begin() + moves.size};
+  if (!is_legal) {
+    count_stat(StatCounter::IllegalMoves);
+  }
+  return is_legal;
+}
 
-      if (moves.size != 0) {
-        return false;
-      }
+bool Board::is_quiet(Move move) const {
+  return is_empty(move.target) && move.promotion == PieceType::None &&
+         !(move.target == enpassant_tile_ &&
+           get_type(move.tile) == PieceType::Pawn);
+}
+
+bool Board::has_any_legal_move() const {
+  Moves moves;
+  generate_legal_moves(moves, get_color_bitboard(turn_), Generation::All,
+                       true);
+  return moves.size != 0;
+}
 
-      moves = {};
-    };
+bool Board::is_draw() const {
+  return halfmove_clock_ >= 100 || is_repetition();
+}
+
+bool Board::is_repetition() const {
+  // Record i holds the key from before move i, positions with the other side
+  // to move or before an irreversible move cannot match
+  const auto size{static_cast<int>(records_.size())};
+  const int first{std::max(size - halfmove_clock_, 0)};
+  for (int i = size - 4; i >= first; i -= 2) {
+    if (records_[static_cast<size_t>(i)].hash == hash_) {
+      return true;
+    }
   }
+  return false;
+}
 
-  return true;
+int Board::count_repetitions() const {
+  const auto size{static_cast<int>(records_.size())};
+  const int first{std::max(size - halfmove_clock_, 0)};
+  int count{};
+  for (int i = size - 4; i >= first; i -= 2) {
+    count += records_[static_cast<size_t>(i)].hash == hash_ ? 1 : 0;
+  }
+  return count;
 }
 
 uint64_t Board::perft(int depth) {
@@ -137,386 +277,532 @@ uint64_t Board::perft(int depth) {
     return 1;
   }
 
-  for (int i = 0; i < 64; i++) {
-    if (get_color(i) != turn_) {
-      continue;
-    }
-    generate_moves(moves, i);
-  }
+  generate_all(moves);
 
   for (int i = 0; i < moves.size; i++) {
     move(moves.data[i]);
-    if (!is_in_check()) {
-      nodes += perft(depth - 1);
-    }
+    nodes += perft(depth - 1);
     undo();
   }
 
   return nodes;
 }
 
-void Board::load_fen(std::string_view fen) {
-  reset();
-
-  std::array<std::string_view, 6> parts{};
-  for (int i = 0, begin = 0, end = 0; i < 6; i++) {
-    begin = end;
-    end = fen.find_first_of(' ', begin + 1);
-    parts[i] = fen.substr(begin, end - begin);
-    end++;  // Skip whitespace
+bool Board::load_fen(std::string_view fen) {
+  if (parse_fen(fen)) {
+    return true;
   }
 
-  for (int i = 0, tile = 0; i < parts[0].length(); i++) {
-    const char ch{parts[0][i]};
+  const bool loaded{parse_fen(DEFAULT_FEN)};
+  ASSERT(loaded);
+  (void)loaded;
+  return false;
+}
+
+std::string Board::to_fen() const {
+  std::string fen;
+  fen.reserve(90);
+
+  for (int row = 7; row >= 0; row--) {
+    int empty{};
+    for (int column = 0; column < 8; column++) {
+      const Piece piece{get_tile(8 * row + column)};
+      if (get_piece_type(piece) == PieceType::None) {
+        empty++;
+        continue;
+      }
 
-    if (ch == '/') {
-      continue;
+      if (empty != 0) {
+        fen += static_cast<char>('0' + empty);
+        empty = 0;
+      }
+      fen += get_piece_char(piece);
     }
 
-    if (ch >= '0' && ch <= '8') {
-      tile += ch - '0';
-      continue;
+    if (empty != 0) {
+      fen += static_cast<char>('0' + empty);
     }
-
-    auto color{PieceColor::Black};
-    if (ch >= 'A' && ch < 'Z') {
-      color = PieceColor::White;
+    if (row != 0) {
+      fen += '/';
     }
+  }
 
-    const int tile_rot{8 * (7 - get_tile_row(tile)) + get_tile_column(tile)};
+  fen += turn_ == PieceColor::White ? " w " : " b ";
 
-    PieceType type{};
-    switch (ch) {
-      case 'K':
-        king_tiles_[1] = tile_rot;
-      case 'k':
-        type = PieceType::King;
-        if (ch == 'K') {
-          break;
-        }
-        king_tiles_[0] = tile_rot;
-        break;
-      case 'Q':
-      case 'q':
-        type = PieceType::Queen;
-        break;
-      case 'B':
-      case 'b':
-        type = PieceType::Bishop;
-        break;
-      case 'N':
-      case 'n':
-        type = PieceType::Knight;
-        break;
-      case 'R':
-      case 'r':
-        type = PieceType::Rook;
-        break;
-      case 'P':
-      case 'p':
-        type = PieceType::Pawn;
-        break;
-      default:
-        break;
+  const size_t castling_begin{fen.size()};
+  const auto has_right = [this](size_t index, CastlingRight right) {
+    return (to_underlying(castling_rights_[index]) & to_underlying(right)) !=
+           0;
+  };
+  if (has_right(1, CastlingRight::Short)) {
+    fen += 'K';
+  }
+  if (has_right(1, CastlingRight::Long)) {
+    fen += 'Q';
+  }
+  if (has_right(0, CastlingRight::Short)) {
+    fen += 'k';
+  }
+  if (has_right(0, CastlingRight::Long)) {
+    fen += 'q';
+  }
+  if (fen.size() == castling_begin) {
+    fen += '-';
+  }
+
+  fen += ' ';
+  if (enpassant_tile_ == -1) {
+    fen += '-';
+  } else {
+    fen += static_cast<char>('a' + get_tile_column(enpassant_tile_));
+    fen += static_cast<char>('1' + get_tile_row(enpassant_tile_));
+  }
+
+  fen += ' ' + std::to_string(halfmove_clock_) + ' ' +
+         std::to_string(fullmove_number_);
+  return fen;
+}
+
+bool Board::parse_fen(std::string_view fen) {
+  reset();
+
+  const std::string_view placement{next_fen_field(fen)};
+  const std::string_view turn{next_fen_field(fen)};
+  const std::string_view castling{next_fen_field(fen)};
+  const std::string_view enpassant{next_fen_field(fen)};
+  const std::string_view halfmove{next_fen_field(fen)};
+  const std::string_view fullmove{next_fen_field(fen)};
+  if (enpassant.empty() || !next_fen_field(fen).empty()) {
+    return false;
+  }
+
+  // Ranks go from 8 down to 1, each has to add up to eight tiles
+  int row{7};
+  int column{};
+  for (const char ch : placement) {
+    if (ch == '/') {
+      if (column != 8 || row == 0) {
+        return false;
+      }
+      row--;
+      column = 0;
+    } else if (ch >= '1' && ch <= '8') {
+      column += ch - '0';
+      if (column > 8) {
+        return false;
+      }
+    } else {
+      const Piece piece{parse_piece_char(ch)};
+      if (get_piece_type(piece) == PieceType::None || column == 8) {
+        return false;
+      }
+      set_tile(8 * row + column, piece);
+      column++;
     }
+  }
+  if (row != 0 || column != 8) {
+    return false;
+  }
 
-    if (type != PieceType::None) {
-      set_tile(tile_rot, make_piece(color, type));
+  for (const PieceColor color : {PieceColor::Black, PieceColor::White}) {
+    if (count_tiles(get_piece_bitboard(color, PieceType::King)) != 1) {
+      return false;
     }
-    tile++;
+  }
+  if ((get_type_bitboard(PieceType::Pawn) & (k_rank_1 | k_rank_8)) != 0) {
+    return false;
   }
 
-  if (parts[1] == "w") {
+  if (turn == "w") {
     turn_ = PieceColor::White;
-  } else if (parts[1] == "b") {
+  } else if (turn == "b") {
     turn_ = PieceColor::Black;
+  } else {
+    return false;
   }
 
-  for (const char ch : parts[2]) {
-    switch (ch) {
-      case 'K':
-        set_castling_right(1, CastlingRight::Short);
-        break;
-      case 'k':
-        set_castling_right(0, CastlingRight::Short);
-        break;
-      case 'Q':
-        set_castling_right(1, CastlingRight::Long);
-        break;
-      case 'q':
-        set_castling_right(0, CastlingRight::Long);
-        break;
-      default:
-        break;
+  // The side that just moved cannot have left its king in check
+  if (is_threatened(get_king_tile(get_opposite_color(turn_)), turn_)) {
+    return false;
+  }
+
+  // Rights need the king and rook on their starting tiles, the move
+  // generator relies on it
+  if (castling != "-") {
+    for (const char ch : castling) {
+      const PieceColor color{ch == 'K' || ch == 'Q' ? PieceColor::White
+                                                    : PieceColor::Black};
+      const int home_tile{color == PieceColor::White ? 0 : 56};
+
+      int rook_tile{};
+      CastlingRight right{};
+      if (ch == 'K' || ch == 'k') {
+        rook_tile = home_tile + 7;
+        right = CastlingRight::Short;
+      } else if (ch == 'Q' || ch == 'q') {
+        rook_tile = home_tile;
+        right = CastlingRight::Long;
+      } else {
+        return false;
+      }
+
+      if (!is_piece(home_tile + 4, color, PieceType::King) ||
+          !is_piece(rook_tile, color, PieceType::Rook)) {
+        return false;
+      }
+      set_castling_right(get_color_index(color), right);
     }
   }
 
-  if (parts[3] != "-") {
-    enpassant_tile_ = 8 * (parts[3][1] - '0' - 1) + (parts[3][0] - 'a');
+  // The tile skipped by a double push, with the pawn that made it in front
+  if (enpassant != "-") {
+    const int enpassant_row{turn_ == PieceColor::White ? 5 : 2};
+    if (enpassant.size() != 2 || enpassant[0] < 'a' || enpassant[0] > 'h' ||
+        enpassant[1] != '1' + enpassant_row) {
+      return false;
+    }
+
+    const int tile{8 * enpassant_row + (enpassant[0] - 'a')};
+    const int pawn_tile{tile + (turn_ == PieceColor::White ? -8 : 8)};
+    const int start_tile{tile + (turn_ == PieceColor::White ? 8 : -8)};
+    if (!is_piece(pawn_tile, get_opposite_color(turn_), PieceType::Pawn) ||
+        !is_empty(tile) || !is_empty(start_tile)) {
+      return false;
+    }
+    enpassant_tile_ = tile;
   }
-};
 
-void Board::generate_legal_moves(Moves& moves, int tile) {
-  Moves possible_moves;
-  generate_moves(possible_moves, tile);
-  for (int i = 0; i < possible_moves.size; i++) {
-    move(possible_moves.data[i]);
-    if (!is_in_check()) {
-      moves.data[moves.size++] = possible_moves.data[i];
+  if (!halfmove.empty()) {
+    if (!parse_fen_number(halfmove, halfmove_clock_) || halfmove_clock_ < 0) {
+      return false;
     }
-    undo();
+    halfmove_clock_ = std::min(halfmove_clock_, 255);
   }
-}
 
-void Board::generate_moves(Moves& moves, int tile) const {
-  const int row{get_tile_row(tile)};
-  const int col{get_tile_column(tile)};
+  // Some writers put 0 here, which is read as the first move
+  if (!fullmove.empty()) {
+    if (!parse_fen_number(fullmove, fullmove_number_) ||
+        fullmove_number_ < 0) {
+      return false;
+    }
+    fullmove_number_ = std::max(fullmove_number_, 1);
+  }
 
-  const PieceType tile_type{get_type(tile)};
+  hash_ = calculate_hash();
+  return true;
+}
 
-#define CHECK_MOVE_OFFSET(offset, condition)           \
-  if (const int target = tile + (offset); condition) { \
-    add_move(moves, tile, target);                     \
+void Board::generate_legal_moves(Moves& moves, Bitboard sources,
+                                 Generation generation,
+                                 bool stop_at_first) const {
+  count_stat(StatCounter::GenerateLegalMoves);
+#ifdef CHESS_STATS
+  // Counted on every way out
+  struct GeneratedCount {
+    const Moves& moves;
+    int first;
+    ~GeneratedCount() {
+      count_stat(StatCounter::GeneratedMoves,
+                 static_cast<uint64_t>(moves.size - first));
+    }
+  } generated_count{moves, moves.size};
+#endif
+
+  const PieceColor color{turn_};
+  const Bitboard own{get_color_bitboard(color)};
+  const Bitboard enemies{get_color_bitboard(get_opposite_color(color))};
+
+  Bitboard target_mask{~own};
+  if (generation == Generation::Noisy) {
+    target_mask = enemies;
+  } else if (generation == Generation::Quiet) {
+    target_mask = ~occupancy_;
   }
 
-#define CHECK_MOVE_DIRECTION(direction, condition)                          \
-  for (int target = tile + (direction); condition; target += (direction)) { \
-    add_move(moves, tile, target);                                          \
-    if (!is_empty(target)) {                                                \
-      break;                                                                \
-    }                                                                       \
+  const int king_tile{get_king_tile(color)};
+  const Bitboard checkers{get_attackers(king_tile, occupancy_) & enemies};
+  if (checkers != 0) {
+    count_stat(StatCounter::Evasions);
   }
 
-  auto add_move = [this](Moves& moves, int tile, int target) {
-    ASSERT(get_color(tile) != PieceColor::None);
-    if (get_color(tile) != get_color(target)) {
-      moves.data[moves.size++] = {tile, target};
+  auto add_moves = [&moves](int tile, Bitboard targets) {
+    while (targets != 0) {
+      moves.data[moves.size++] = {tile, pop_first_tile(targets)};
     }
   };
 
-  switch (tile_type) {
-    case PieceType::King:
-      CHECK_MOVE_OFFSET(1, col < 7);
-      CHECK_MOVE_OFFSET(7, row < 7 && col > 0);
-      CHECK_MOVE_OFFSET(8, row < 7);
-      CHECK_MOVE_OFFSET(9, row < 7 && col < 7);
-      CHECK_MOVE_OFFSET(-1, col > 0);
-      CHECK_MOVE_OFFSET(-7, row > 0 && col < 7);
-      CHECK_MOVE_OFFSET(-8, row > 0);
-      CHECK_MOVE_OFFSET(-9, row > 0 && col > 0);
-      if (tile == 4 && castling_rights_[1] != CastlingRight::None &&
-          !is_threatened(4, PieceColor::Black)) {
-        CHECK_MOVE_OFFSET(2, is_piece(7, PieceColor::White, PieceType::Rook) &&
-                                 (castling_rights_[1] == CastlingRight::Short ||
-                                  castling_rights_[1] == CastlingRight::Both) &&
-                                 is_empty(5) && is_empty(6) &&
-                                 !is_threatened(5, PieceColor::Black) &&
-                                 !is_threatened(6, PieceColor::Black));
-        CHECK_MOVE_OFFSET(-2,
-                          is_piece(0, PieceColor::White, PieceType::Rook) &&
-                              (castling_rights_[1] == CastlingRight::Long ||
-                               castling_rights_[1] == CastlingRight::Both) &&
-                              is_empty(1) && is_empty(2) && is_empty(3) &&
-                              !is_threatened(2, PieceColor::Black) &&
-                              !is_threatened(3, PieceColor::Black));
-      } else if (tile == 60 && castling_rights_[0] != CastlingRight::None &&
-                 !is_threatened(60, PieceColor::White)) {
-        CHECK_MOVE_OFFSET(2, is_piece(63, PieceColor::Black, PieceType::Rook) &&
-                                 (castling_rights_[0] == CastlingRight::Short ||
-                                  castling_rights_[0] == CastlingRight::Both) &&
-                                 is_empty(61) && is_empty(62) &&
-                                 !is_threatened(61, PieceColor::White) &&
-                                 !is_threatened(62, PieceColor::White));
-        CHECK_MOVE_OFFSET(-2,
-                          is_piece(56, PieceColor::Black, PieceType::Rook) &&
-                              (castling_rights_[0] == CastlingRight::Long ||
-                               castling_rights_[0] == CastlingRight::Both) &&
-                              is_empty(57) && is_empty(58) && is_empty(59) &&
-                              !is_threatened(58, PieceColor::White) &&
-                              !is_threatened(59, PieceColor::White));
+  if (has_tile(sources, king_tile)) {
+    count_stat(StatCounter::KingSources);
+
+    // The king must not shield the tiles behind it from sliders
+    const Bitboard occupancy{occupancy_ ^ tile_bitboard(king_tile)};
+    Bitboard targets{get_king_attacks(king_tile) & target_mask};
+    count_stat(StatCounter::KingTargetsTested,
+               static_cast<uint64_t>(count_tiles(targets)));
+    while (targets != 0) {
+      const int target{pop_first_tile(targets)};
+      if ((get_attackers(target, occupancy) & enemies) == 0) {
+        moves.data[moves.size++] = {king_tile, target};
+      } else {
+        count_stat(StatCounter::KingTargetsRejected);
       }
-      break;
-    case PieceType::Queen:
-    case PieceType::Bishop:
-      CHECK_MOVE_DIRECTION(7, target < 64 && get_tile_column(target) != 7);
-      CHECK_MOVE_DIRECTION(9, target < 64 && get_tile_column(target) != 0);
-      CHECK_MOVE_DIRECTION(-7, target >= 0 && get_tile_column(target) != 0);
-      CHECK_MOVE_DIRECTION(-9, target >= 0 && get_tile_column(target) != 7);
-      if (tile_type == PieceType::Bishop) {
+    }
+
+    if (checkers == 0 && generation != Generation::Noisy) {
+      generate_castling_moves(moves, king_tile);
+    }
+  }
+
+  // Only the king can escape a double check
+  if (count_tiles(checkers) > 1) {
+    count_stat(StatCounter::DoubleChecks);
+    return;
+  }
+  if (stop_at_first && moves.size != 0) {
+    return;
+  }
+
+  Bitboard check_mask{~Bitboard{}};
+  if (checkers != 0) {
+    check_mask =
+        get_between_tiles(king_tile, get_first_tile(checkers)) | checkers;
+  }
+
+  const Bitboard pinned{calculate_pinned(color)};
+
+  Bitboard pieces{sources & own & ~get_type_bitboard(PieceType::King)};
+  while (pieces != 0) {
+    const int tile{pop_first_tile(pieces)};
+    count_stat(get_source_counter(get_type(tile)));
+
+    Bitboard pin_mask{~Bitboard{}};
+    if (has_tile(pinned, tile)) {
+      count_stat(StatCounter::PinnedSources);
+      pin_mask = get_line(king_tile, tile);
+    }
+
+    Bitboard targets{};
+    switch (get_type(tile)) {
+      case PieceType::Queen:
+        targets = get_queen_attacks(tile, occupancy_);
         break;
-      }
-    case PieceType::Rook:
-      CHECK_MOVE_DIRECTION(1, target < tile - col + 8);
-      CHECK_MOVE_DIRECTION(8, target < 64);
-      CHECK_MOVE_DIRECTION(-1, target >= tile - col);
-      CHECK_MOVE_DIRECTION(-8, target >= 0);
-      break;
-    case PieceType::Knight:
-      CHECK_MOVE_OFFSET(6, target < 64 && col > 1);
-      CHECK_MOVE_OFFSET(10, target < 64 && col < 6);
-      CHECK_MOVE_OFFSET(15, target < 64 && col > 0);
-      CHECK_MOVE_OFFSET(17, target < 64 && col < 7);
-      CHECK_MOVE_OFFSET(-6, target >= 0 && col < 6);
-      CHECK_MOVE_OFFSET(-10, target >= 0 && col > 1);
-      CHECK_MOVE_OFFSET(-15, target >= 0 && col < 7);
-      CHECK_MOVE_OFFSET(-17, target >= 0 && col > 0);
-      break;
-    case PieceType::Pawn: {
-#define CHECK_PAWN_MOVE_OFFSET(offset, condition)      \
-  if (const int target = tile + (offset); condition) { \
-    add_pawn_move(moves, tile, target);                \
-  }
-
-      auto add_pawn_move = [this](Moves& moves, int tile, int target) {
-        ASSERT(get_color(tile) != PieceColor::None);
-        if (get_color(tile) != get_color(target)) {
-          if (target >= 8 && target < 56) {
-            moves.data[moves.size++] = {tile, target};
-            return;
+      case PieceType::Bishop:
+        targets = get_bishop_attacks(tile, occupancy_);
+        break;
+      case PieceType::Knight:
+        targets = get_knight_attacks(tile);
+        break;
+      case PieceType::Rook:
+        targets = get_rook_attacks(tile, occupancy_);
+        break;
+      case PieceType::Pawn: {
+        const bool white{color == PieceColor::White};
+        const int forward{white ? 8 : -8};
+
+        Bitboard pushes{tile_bitboard(tile + forward) & ~occupancy_};
+        if (pushes != 0 && (white ? tile < 16 : tile >= 48)) {
+          pushes |= tile_bitboard(tile + 2 * forward) & ~occupancy_;
+        }
+
+        if (generation == Generation::Noisy) {
+          pushes &= k_rank_1 | k_rank_8;
+        } else if (generation == Generation::Quiet) {
+          pushes &= ~(k_rank_1 | k_rank_8);
+        }
+
+        const Bitboard attacks{get_pawn_attacks(tile, color)};
+
+        // Added here since promotions expand into several moves
+        Bitboard pawn_targets{(pushes | (attacks & enemies & target_mask)) &
+                              check_mask & pin_mask};
+        if ((pawn_targets & (k_rank_1 | k_rank_8)) == 0) {
+          add_moves(tile, pawn_targets);
+        } else {
+          while (pawn_targets != 0) {
+            const int target{pop_first_tile(pawn_targets)};
+            moves.data[moves.size++] = {tile, target, PieceType::Queen};
+            moves.data[moves.size++] = {tile, target, PieceType::Rook};
+            moves.data[moves.size++] = {tile, target, PieceType::Bishop};
+            moves.data[moves.size++] = {tile, target, PieceType::Knight};
           }
-          moves.data[moves.size++] = {tile, target, PieceType::Queen};
-          moves.data[moves.size++] = {tile, target, PieceType::Rook};
-          moves.data[moves.size++] = {tile, target, PieceType::Bishop};
-          moves.data[moves.size++] = {tile, target, PieceType::Knight};
         }
-      };
 
-      switch (get_color(tile)) {
-        case PieceColor::Black:
-          CHECK_PAWN_MOVE_OFFSET(-8, is_empty(target));
-          CHECK_MOVE_OFFSET(
-              -16, tile >= 48 && is_empty(tile - 8) && is_empty(target));
-          CHECK_PAWN_MOVE_OFFSET(
-              -7, col < 7 && (get_color(target) == PieceColor::White ||
-                              (target == enpassant_tile_ &&
-                               get_color(target) == PieceColor::None)));
-          CHECK_PAWN_MOVE_OFFSET(
-              -9, col > 0 && (get_color(target) == PieceColor::White ||
-                              (target == enpassant_tile_ &&
-                               get_color(target) == PieceColor::None)));
-          break;
-        case PieceColor::White:
-          CHECK_PAWN_MOVE_OFFSET(8, is_empty(target));
-          CHECK_MOVE_OFFSET(
-              16, tile < 16 && is_empty(tile + 8) && is_empty(target));
-          CHECK_PAWN_MOVE_OFFSET(
-              7, col > 0 && (get_color(target) == PieceColor::Black ||
-                             (target == enpassant_tile_ &&
-                              get_color(target) == PieceColor::None)));
-          CHECK_PAWN_MOVE_OFFSET(
-              9, col < 7 && (get_color(target) == PieceColor::Black ||
-                             (target == enpassant_tile_ &&
-                              get_color(target) == PieceColor::None)));
-          break;
-        default:
-          break;
+        if (generation != Generation::Quiet && enpassant_tile_ != -1 &&
+            has_tile(attacks, enpassant_tile_) && is_legal_enpassant(tile)) {
+          moves.data[moves.size++] = {tile, enpassant_tile_};
+        }
+        break;
       }
+      default:
+        break;
     }
 
-#undef CHECK_PAWN_MOVE_OFFSET
-    break;
-    default:
-      break;
+    add_moves(tile, targets & target_mask & check_mask & pin_mask);
+
+    if (stop_at_first && moves.size != 0) {
+      return;
+    }
   }
+}
+
+void Board::generate_castling_moves(Moves& moves, int king_tile) const {
+  const PieceColor color{turn_};
+  const PieceColor enemy_color{get_opposite_color(color)};
+  const uint8_t color_index{get_color_index(color)};
 
-#undef CHECK_MOVE_OFFSET
-#undef CHECK_MOVE_DIRECTION
+  if (king_tile != (color == PieceColor::White ? 4 : 60) ||
+      castling_rights_[color_index] == CastlingRight::None) {
+    return;
+  }
+
+  auto has_right = [this, color_index](CastlingRight right) {
+    return (to_underlying(castling_rights_[color_index]) &
+            to_underlying(right)) != 0;
+  };
+
+  if (has_right(CastlingRight::Short) &&
+      is_piece(king_tile + 3, color, PieceType::Rook) &&
+      is_empty(king_tile + 1) && is_empty(king_tile + 2) &&
+      !is_threatened(king_tile + 1, enemy_color) &&
+      !is_threatened(king_tile + 2, enemy_color)) {
+    moves.data[moves.size++] = {king_tile, king_tile + 2};
+  }
+  if (has_right(CastlingRight::Long) &&
+      is_piece(king_tile - 4, color, PieceType::Rook) &&
+      is_empty(king_tile - 1) && is_empty(king_tile - 2) &&
+      is_empty(king_tile - 3) && !is_threatened(king_tile - 1, enemy_color) &&
+      !is_threatened(king_tile - 2, enemy_color)) {
+    moves.data[moves.size++] = {king_tile, king_tile - 2};
+  }
 }
 
-bool Board::is_threatened(int tile, PieceColor attacker_color) const {
-  const int row{get_tile_row(tile)};
-  const int col{get_tile_column(tile)};
-
-#define CHECK_THREAT_KNIGHT(offset, condition)                \
-  if (const int target = tile + (offset);                     \
-      (condition) && get_type(target) == PieceType::Knight && \
-      get_color(target) == attacker_color) {                  \
-    return true;                                              \
-  }
-
-  CHECK_THREAT_KNIGHT(6, col > 1 && row < 7);
-  CHECK_THREAT_KNIGHT(10, col < 6 && row < 7);
-  CHECK_THREAT_KNIGHT(15, col > 0 && row < 6);
-  CHECK_THREAT_KNIGHT(17, col < 7 && row < 6);
-  CHECK_THREAT_KNIGHT(-6, col < 6 && row > 0);
-  CHECK_THREAT_KNIGHT(-10, col > 1 && row > 0);
-  CHECK_THREAT_KNIGHT(-15, col < 7 && row > 1);
-  CHECK_THREAT_KNIGHT(-17, col > 0 && row > 1);
-
-#undef CHECK_THREAT_KNIGHT
-
-#define CHECK_THREAT_DIRECTION(direction, condition, threat_condition)      \
-  for (int target = tile + (direction); condition; target += (direction)) { \
-    if (is_empty(target)) {                                                 \
-      continue;                                                             \
-    }                                                                       \
-    const PieceColor target_color{get_color(target)};                       \
-    const PieceType target_type{get_type(target)};                          \
-    if (target_color == attacker_color && (threat_condition)) {             \
-      return true;                                                          \
-    }                                                                       \
-    break;                                                                  \
-  }
-
-  CHECK_THREAT_DIRECTION(
-      8, target < 64,
-      target_type == PieceType::Queen || target_type == PieceType::Rook ||
-          (target_type == PieceType::King && target == tile + 8));
-  CHECK_THREAT_DIRECTION(
-      -8, target >= 0,
-      target_type == PieceType::Queen || target_type == PieceType::Rook ||
-          (target_type == PieceType::King && target == tile - 8));
-  CHECK_THREAT_DIRECTION(
-      -1, target >= tile - col,
-      target_type == PieceType::Queen || target_type == PieceType::Rook ||
-          (target_type == PieceType::King && target == tile - 1));
-  CHECK_THREAT_DIRECTION(
-      1, target < tile - col + 8,
-      target_type == PieceType::Queen || target_type == PieceType::Rook ||
-          (target_type == PieceType::King && target == tile + 1));
-  CHECK_THREAT_DIRECTION(
-      7, target < 64 && get_tile_column(target) != 7,
-      target_type == PieceType::Queen || target_type == PieceType::Bishop ||
-          (target == tile + 7 && (target_type == PieceType::King ||
-                                  (target_type == PieceType::Pawn &&
-                                   target_color == PieceColor::Black))));
-  CHECK_THREAT_DIRECTION(
-      9, target < 64 && get_tile_column(target) != 0,
-      target_type == PieceType::Queen || target_type == PieceType::Bishop ||
-          (target == tile + 9 && (target_type == PieceType::King ||
-                                  (target_type == PieceType::Pawn &&
-                                   target_color == PieceColor::Black))));
-  CHECK_THREAT_DIRECTION(
-      -7, target >= 0 && get_tile_column(target) != 0,
-      target_type == PieceType::Queen || target_type == PieceType::Bishop ||
-          (target == tile - 7 && (target_type == PieceType::King ||
-                                  (target_type == PieceType::Pawn &&
-                                   target_color == PieceColor::White))));
-  CHECK_THREAT_DIRECTION(
-      -9, target >= 0 && get_tile_column(target) != 7,
-      target_type == PieceType::Queen || target_type == PieceType::Bishop ||
-          (target == tile - 9 && (target_type == PieceType::King ||
-                                  (target_type == PieceType::Pawn &&
-                                   target_color == PieceColor::White))));
-
-#undef CHECK_THREAT_DIRECTION
+// En passant removes two pieces from the same row at once, which the pin mask
+// cannot express, so the resulting occupancy is checked directly
+bool Board::is_legal_enpassant(int tile) const {
+  count_stat(StatCounter::EnpassantTested);
+
+  const int captured_tile{enpassant_tile_ +
+                          (turn_ == PieceColor::White ? -8 : 8)};
+  const Bitboard occupancy{(occupancy_ ^ tile_bitboard(tile) ^
+                            tile_bitboard(captured_tile)) |
+                           tile_bitboard(enpassant_tile_)};
+  const Bitboard enemies{get_color_bitboard(get_opposite_color(turn_)) &
+                         ~tile_bitboard(captured_tile)};
+  const bool is_legal{
+      (get_attackers(get_king_tile(turn_), occupancy) & enemies) == 0};
+  if (!is_legal) {
+    count_stat(StatCounter::EnpassantRejected);
+  }
+  return is_legal;
+}
 
-  return false;
+Bitboard Board::get_attackers(int tile, Bitboard occupancy) const {
+  const Bitboard queens{get_type_bitboard(PieceType::Queen)};
+  const Bitboard pawns{get_type_bitboard(PieceType::Pawn)};
+
+  return (get_knight_attacks(tile) & get_type_bitboard(PieceType::Knight)) |
+         (get_king_attacks(tile) & get_type_bitboard(PieceType::King)) |
+         (get_pawn_attacks(tile, PieceColor::White) &
+          get_piece_bitboard(PieceColor::Black, PieceType::Pawn)) |
+         (get_pawn_attacks(tile, PieceColor::Black) & pawns &
+          get_color_bitboard(PieceColor::White)) |
+         (get_bishop_attacks(tile, occupancy) &
+          (get_type_bitboard(PieceType::Bishop) | queens)) |
+         (get_rook_attacks(tile, occupancy) &
+          (get_type_bitboard(PieceType::Rook) | queens));
 }
 
-bool Board::is_in_check() {
-  return is_threatened(king_tiles_[get_color_index(get_opposite_color(turn_))],
-                       turn_);
+Bitboard Board::calculate_pinned(PieceColor color) const {
+  const int king_tile{get_king_tile(color)};
+  const Bitboard queens{get_type_bitboard(PieceType::Queen)};
+
+  Bitboard snipers{
+      ((get_rook_attacks(king_tile, 0) &
+        (get_type_bitboard(PieceType::Rook) | queens)) |
+       (get_bishop_attacks(king_tile, 0) &
+        (get_type_bitboard(PieceType::Bishop) | queens))) &
+      get_color_bitboard(get_opposite_color(color))};
+
+  Bitboard pinned{};
+  while (snipers != 0) {
+    const Bitboard blockers{
+        get_between_tiles(king_tile, pop_first_tile(snipers)) & occupancy_};
+    if (count_tiles(blockers) == 1) {
+      pinned |= blockers;
+    }
+  }
+  return pinned & get_color_bitboard(color);
+}
+
+bool Board::is_threatened(int tile, PieceColor attacker_color) const {
+  count_stat(StatCounter::IsThreatened);
+  return (get_attackers(tile, occupancy_) &
+          get_color_bitboard(attacker_color)) != 0;
+}
+
+bool Board::is_in_check() const {
+  return is_threatened(get_king_tile(turn_), get_opposite_color(turn_));
 }
 
 void Board::reset() {
   castling_rights_ = {};
-  king_tiles_ = {};
   enpassant_tile_ = -1;
+  halfmove_clock_ = 0;
+  fullmove_number_ = 1;
   tiles_.fill({});
+  color_bitboards_ = {};
+  type_bitboards_ = {};
+  occupancy_ = {};
+  hash_ = {};
+  middlegame_score_ = 0;
+  endgame_score_ = 0;
+  phase_ = 0;
+  material_key_ = 0;
   records_.clear();
 }
 
+uint64_t Board::calculate_hash() const {
+  uint64_t hash{get_castling_key() ^ get_enpassant_key()};
+  if (turn_ == PieceColor::White) {
+    hash ^= k_zobrist_keys.turn;
+  }
+
+  Bitboard pieces{occupancy_};
+  while (pieces != 0) {
+    const int tile{pop_first_tile(pieces)};
+    hash ^= get_zobrist_piece_key(get_tile(tile), tile);
+  }
+  return hash;
+}
+
+uint64_t Board::get_castling_key() const {
+  uint64_t key{};
+  for (int i = 0; i < 2; i++) {
+    const auto rights{to_underlying(castling_rights_[i])};
+    // White rights come first in the key table
+    const int offset{i == 1 ? 0 : 2};
+    if ((rights & to_underlying(CastlingRight::Short)) != 0) {
+      key ^= k_zobrist_keys.castling[offset];
+    }
+    if ((rights & to_underlying(CastlingRight::Long)) != 0) {
+      key ^= k_zobrist_keys.castling[offset + 1];
+    }
+  }
+  return key;
+}
+
+// Like Polyglot, the en passant tile is only hashed when a pawn of the side to
+// move could capture there, so transpositions that differ only by an unusable
+// en passant tile share a key
+uint64_t Board::get_enpassant_key() const {
+  if (enpassant_tile_ == -1 ||
+      (get_pawn_attacks(enpassant_tile_, get_opposite_color(turn_)) &
+       get_piece_bitboard(turn_, PieceType::Pawn)) == 0) {
+    return 0;
+  }
+  return k_zobrist_keys.enpassant[get_tile_column(enpassant_tile_)];
+}
+
 void Board::set_castling_right(int index, CastlingRight right) {
   castling_rights_[index] = static_cast<CastlingRight>(
       to_underlying(castling_rights_[index]) | to_underlying(right));
@@ -0,0 +1,153 @@
+#include "book.hpp"
+
+#include <ostream>
+
+namespace {
+
+// Indexed by PieceType, Polyglot numbers promotions from knight up to queen
+constexpr std::array<uint16_t, 7> k_promotion_codes{0, 0, 4, 2, 1, 3, 0};
+constexpr std::array<PieceType, 5> k_promotion_types{
+    PieceType::None, PieceType::Knight, PieceType::Bishop, PieceType::Rook,
+    PieceType::Queen};
+
+template <typename T>
+T read_big_endian(const char* data) {
+  T value{};
+  for (size_t i = 0; i < sizeof(T); i++) {
+    value = static_cast<T>(value << 8U | static_cast<uint8_t>(data[i]));
+  }
+  return value;
+}
+
+template <typename T>
+void write_big_endian(std::ostream& output, T value) {
+  for (size_t i = sizeof(T); i-- > 0;) {
+    output.put(static_cast<char>(static_cast<uint8_t>(value >> (8U * i))));
+  }
+}
+
+}  // namespace
+
+uint16_t to_book_move(const Board& board, Board::Move move) {
+  int target{move.target};
+  if (board.get_type(move.tile) == PieceType::King &&
+      std::abs(move.target - move.tile) == 2) {
+    // The rook in the corner on the side the king goes to
+    target = (move.tile & ~7) + (move.target > move.tile ? 7 : 0);
+  }
+  return static_cast<uint16_t>(
+      target | move.tile << 6 |
+      k_promotion_codes[to_underlying(move.promotion)] << 12);
+}
+
+Board::Move parse_book_move(const Board& board, uint16_t move) {
+  const int tile{(move >> 6U) & 63};
+  int target{move & 63};
+  const uint16_t promotion{static_cast<uint16_t>((move >> 12U) & 7)};
+  if (promotion >= k_promotion_types.size()) {
+    return {};
+  }
+
+  // The king takes its own rook, which is not how Board spells castling
+  if (board.get_type(tile) == PieceType::King &&
+      board.get_type(target) == PieceType::Rook &&
+      board.get_color(target) == board.get_color(tile)) {
+    target = tile + (target > tile ? 2 : -2);
+  }
+
+  const Board::Move parsed{tile, target, k_promotion_types[promotion]};
+  return board.is_legal_move(parsed) ? parsed : Board::Move{};
+}
+
+void write_book_entry(std::ostream& output, const BookEntry& entry) {
+  write_big_endian(output, entry.key);
+  write_big_endian(output, entry.move);
+  write_big_endian(output, entry.weight);
+  write_big_endian(output, entry.learn);
+}
+
+bool OpeningBook::open(const fs::path& path) {
+  close();
+
+  // Lookups jump around the file, read-ahead would only waste memory
+  if (!file_.open(path, MappedFile::Access::Random)) {
+    return false;
+  }
+  if (file_.get_view().size() % k_book_entry_size != 0) {
+    LOGF_ERROR("Book", "Invalid book \"{}\"", path.string());
+    file_.close();
+    return false;
+  }
+
+  entry_count_ = file_.get_view().size() / k_book_entry_size;
+  LOGF_DEBUG("Book", "Book opened (file: \"{}\") (entries: {})", path.string(),
+             entry_count_);
+  return true;
+}
+
+void OpeningBook::close() {
+  file_.close();
+  entry_count_ = 0;
+}
+
+void OpeningBook::probe(const Board& board, Moves& moves) const {
+  moves.clear();
+
+  // First entry of the position
+  const uint64_t key{board.get_hash()};
+  size_t first{};
+  size_t count{entry_count_};
+  while (count > 0) {
+    const size_t step{count / 2};
+    if (get_entry(first + step).key < key) {
+      first += step + 1;
+      count -= step + 1;
+    } else {
+      count = step;
+    }
+  }
+
+  for (size_t i = first; i < entry_count_ && !moves.full(); i++) {
+    const BookEntry entry{get_entry(i)};
+    if (entry.key != key) {
+      break;
+    }
+
+    // Keys can collide, moves that don't fit the position are skipped
+    const Board::Move move{parse_book_move(board, entry.move)};
+    if (move.tile != -1 && entry.weight != 0) {
+      moves.emplace_back(move, entry.weight);
+    }
+  }
+}
+
+Board::Move OpeningBook::pick(const Board& board,
+                              std::mt19937_64& random) const {
+  Moves moves;
+  probe(board, moves);
+
+  uint32_t total{};
+  for (const Move& move : moves) {
+    total += move.weight;
+  }
+  if (total == 0) {
+    return {};
+  }
+
+  uint32_t choice{
+      std::uniform_int_distribution<uint32_t>{0, total - 1}(random)};
+  for (const Move& move : moves) {
+    if (choice < move.weight) {
+      return move.move;
+    }
+    choice -= move.weight;
+  }
+  return {};
+}
+
+BookEntry OpeningBook::get_entry(size_t index) const {
+  const char* data{file_.get_view().data() + index * k_book_entry_size};
+  return {read_big_endian<uint64_t>(data), read_big_endian<uint16_t>(data + 8),
+          read_big_endian<uint16_t>(data + 10),
+          read_big_endian<uint32_t>(data + 12)};
+}
@@ -2,11 +2,11 @@
 
 #include <GLFW/glfw3.h>
 
-#include <random>
-
 #define SHADER(filename) "resources/shaders/" filename
 #define TEXTURE(filename) "resources/textures/" filename
 #define MODEL(filename) "resources/models/" filename
+#define BOOK(filename) "resources/books/" filename
+#define NETWORK(filename) "resources/networks/" filename
 
 Game::Game(GLFWwindow* window) : renderer_{window} {
   glfwSetWindowUserPointer(window, this);
@@ -14,6 +14,7 @@ Game::Game(GLFWwindow* window) : renderer_{window} {
   glfwSetMouseButtonCallback(window, mouse_button_callback);
   glfwSetCursorPosCallback(window, mouse_move_callback);
   glfwSetScrollCallback(window, mouse_scroll_callback);
+  glfwSetWindowRefreshCallback(window, window_refresh_callback);
 
   glfwSetKeyCallback(window, key_callback);
 
@@ -55,6 +56,24 @@ void Game::run() {
   CHECK(picking_texture_, renderer_.create_framebuffer(k_window_size + 1.0F))
 #undef CHECK
 
+  // Images were decoded in parallel while the models loaded
+  if (!renderer_.upload_textures()) {
+    return;
+  }
+
+  std::error_code error;
+  if (fs::exists(BOOK("book.bin"), error)) {
+    book_.open(BOOK("book.bin"));
+  }
+  if (fs::exists(NETWORK("default.nnue"), error) &&
+      network_.open(NETWORK("default.nnue"))) {
+    ai_search_.set_network(&network_);
+  }
+
+  // The light never moves
+  renderer_.bind_shader(lighting_);
+  renderer_.set_shader_uniform(lighting_, "light_pos", k_light_position);
+
   glEnable(GL_DEPTH_TEST);
   glDepthFunc(GL_LESS);
 
@@ -67,31 +86,131 @@ void Game::run() {
 
   last_frame_ = static_cast<float>(glfwGetTime());
   while (glfwWindowShouldClose(renderer_.get_window()) != 1) {
+    if (is_redraw_needed() || is_pixel_read_needed()) {
+      glfwPollEvents();
+    } else {
+      // The AI answers without an event, so it is polled every so often
+      if (ai_result_.valid()) {
+        glfwWaitEventsTimeout(k_ai_poll_interval);
+      } else {
+        glfwWaitEvents();
+      }
+      // Time spent asleep doesn't count towards animations
+      last_frame_ = static_cast<float>(glfwGetTime());
+    }
+
     const auto current_frame = static_cast<float>(glfwGetTime());
     delta_time_ = current_frame - last_frame_;
     last_frame_ = current_frame;
 
     time_passed_ += delta_time_;
 
-    glfwPollEvents();
+    profiler_.begin_frame();
 
     process_input();
     update();
+    read_picking_pixel();
+
+    const bool redraw{is_redraw_needed()};
+    if (redraw) {
+      redraw_ = false;
+
+      renderer_.begin_drawing(camera_);
+      draw();
+      renderer_.end_drawing();
+    }
+
+    profiler_.end_frame();
+    if (redraw && profiler_.is_enabled()) {
+      report_profile();
+    }
+  }
+}
+
+bool Game::is_redraw_needed() const {
+  return redraw_ || !active_move_.is_completed;
+}
+
+bool Game::is_pixel_read_needed() const {
+  return pick_pixel_ || renderer_.is_pixel_pending();
+}
 
-    renderer_.begin_drawing(camera_);
-    draw();
-    renderer_.end_drawing();
+void Game::toggle_profiling() {
+  if (profiler_.is_enabled()) {
+    profiler_.set_enabled(false);
+    profile_csv_.close();
+    glfwSetWindowTitle(renderer_.get_window(), k_window_title);
+    LOG("GAME", "Profiling stopped");
+    return;
+  }
+
+  profile_csv_.open(k_profile_path, std::ios::trunc);
+  if (!profile_csv_) {
+    LOGF_ERROR("GAME", "Failed to open \"{}\"", k_profile_path);
+    return;
   }
+  profiler_.set_enabled(true);
+  profile_report_time_ = 0.0F;
+  redraw_ = true;
+  LOGF("GAME", "Profiling to \"{}\"", k_profile_path);
+}
+
+void Game::report_profile() {
+  const FrameStats& stats{renderer_.get_frame_stats()};
+  const std::span<const Profiler::Zone> zones{profiler_.get_zones()};
+
+  // Zones are only known once they ran, the first row names them
+  if (profile_csv_.tellp() == 0) {
+    profile_csv_ << "frame_ms,draw_calls,instances,uniform_uploads";
+    for (const Profiler::Zone& zone : zones) {
+      profile_csv_ << ',' << zone.name << "_cpu_ms";
+      if (zone.gpu) {
+        profile_csv_ << ',' << zone.name << "_gpu_ms";
+      }
+    }
+    profile_csv_ << '\n';
+  }
+
+  profile_csv_ << delta_time_ * 1000.0F << ',' << stats.draw_calls << ','
+               << stats.instances << ',' << stats.uniform_uploads;
+  for (const Profiler::Zone& zone : zones) {
+    profile_csv_ << ',' << zone.cpu_ms;
+    if (zone.gpu) {
+      profile_csv_ << ',' << zone.gpu_ms;
+    }
+  }
+  profile_csv_ << '\n';
+
+  profile_report_time_ -= delta_time_;
+  if (profile_report_time_ > 0.0F) {
+    return;
+  }
+  profile_report_time_ = k_profile_report_interval;
+
+  // CPU/GPU milliseconds of each zone
+  std::string title{std::format("{} - {:.2f} ms, {} draws, {} uniforms",
+                                k_window_title, delta_time_ * 1000.0F,
+                                stats.draw_calls, stats.uniform_uploads)};
+  for (const Profiler::Zone& zone : zones) {
+    title += std::format(" | {} {:.2f}", zone.name, zone.cpu_ms);
+    if (zone.gpu) {
+      title += std::format("/{:.2f}", zone.gpu_ms);
+    }
+  }
+  glfwSetWindowTitle(renderer_.get_window(), title.c_str());
 }
 
 void Game::resize_picking_texture(const glm::vec2& size) {
   Renderer::destroy_framebuffer(picking_texture_);
   picking_texture_ = renderer_.create_framebuffer(size + 1.0F);
   update_picking_texture_ = true;
-  LOGF("GAME", "Resized picking texture to {} {}", size.x, size.y);
+  redraw_ = true;
+  LOGF_DEBUG("GAME", "Resized picking texture to {} {}", size.x, size.y);
 }
 
 void Game::update() {
+  const Profiler::Scope zone{profiler_, "update"};
+
   if (active_move_.is_completed) {
     const auto& records{board_.get_records()};
     if (!records.empty() &&
@@ -105,31 +224,36 @@ void Game::update() {
         return;
       }
 
-      std::random_device rd;
-      std::mt19937 mt{rd()};
-      std::uniform_int_distribution<std::mt19937::result_type> dist{0, 63};
-      while (true) {
-        const auto tile{static_cast<int>(dist(mt))};
-        if (board_.get_color(tile) == ai_color_) {
-          Board::Moves moves;
-          board_.get_moves(moves, tile);
-
-          if (moves.size == 0) {
-            continue;
-          }
-
-          active_move_ = {};
-          active_move_.tile = tile;
-          active_move_.target =
-              moves
-                  .data
-                      [std::uniform_int_distribution<std::mt19937::result_type>{
-                          0, static_cast<unsigned int>(moves.size) - 1}(mt)]
-                  .target;
-          active_move_.position = calculate_tile_position(tile);
-          break;
+      // Book moves are played right away, a search is only started once out
+      // of book
+      Board::Move move;
+      if (!ai_result_.valid()) {
+        move = book_.pick(board_, random_);
+      }
+
+      if (move.tile == -1) {
+        // The search runs on its own thread, frames keep coming until it is
+        // done
+        if (!ai_result_.valid()) {
+          ai_result_ = ai_search_.start(board_, k_ai_limits);
+          return;
+        }
+        if (ai_result_.wait_for(std::chrono::seconds{}) !=
+            std::future_status::ready) {
+          return;
         }
+
+        const SearchResult result{ai_result_.get()};
+        LOGF_DEBUG("GAME", "AI searched depth {} score {} nodes {} nps {}",
+                   result.depth, result.score, result.nodes, result.nps);
+        move = result.best_move;
       }
+
+      active_move_ = {};
+      active_move_.tile = move.tile;
+      active_move_.target = move.target;
+      active_move_.promotion = move.promotion;
+      active_move_.position = calculate_tile_position(move.tile);
     }
     return;
   }
@@ -138,17 +262,15 @@ void Game::update() {
     if (active_move_.is_undo) {
       board_.undo();
     } else {
-      PieceType promotion{};
-      if (board_.get_type(active_move_.tile) == PieceType::Pawn &&
-          (active_move_.target < 8 || active_move_.target > 55)) {
-        promotion = PieceType::Queen;
-      }
-      board_.move({active_move_.tile, active_move_.target, promotion});
+      board_.move(
+          {active_move_.tile, active_move_.target, active_move_.promotion});
     }
     if (!is_controlling_camera()) {
       enable_cursor();
     }
     update_picking_texture_ = true;
+    // One more frame so the AI, or a pending undo, gets to run
+    redraw_ = true;
     active_move_.angle = 0.0F;
     active_move_.is_completed = true;
     return;
@@ -188,40 +310,69 @@ void Game::process_input() {
 }
 
 void Game::update_picking_texture() {
+  const Profiler::Scope zone{profiler_, "update_picking_texture", true};
+
   if (update_picking_texture_) {
     renderer_.bind_shader(picking_);
     renderer_.bind_framebuffer(picking_texture_, GL_DRAW_FRAMEBUFFER);
     Renderer::clear_framebuffer();
 
+    // Colors share a model here, one draw per piece type
+    std::array<Instances, 7> pieces;
     for (int tile = 0; tile < 64; tile++) {
-      const Piece piece{board_.get_tile(tile)};
-      if (get_piece_type(piece) == PieceType::None) {
-        continue;
+      const PieceType type{board_.get_type(tile)};
+      if (type != PieceType::None) {
+        pieces[to_underlying(type)].emplace_back(
+            Renderer::calculate_model_matrix(calculate_piece_transform(tile)),
+            tile);
       }
-
-      Model* model = get_model(piece);
-      renderer_.set_shader_uniform(picking_, "color", tile);
-      renderer_.draw_model(calculate_piece_transform(tile), model, nullptr);
+    }
+    for (size_t type = 1; type < pieces.size(); type++) {
+      const Instances& batch{pieces[type]};
+      renderer_.draw_model_instances(get_model(static_cast<PieceType>(type)),
+                                     nullptr, {batch.begin(), batch.end()});
     }
 
-    Model* model = get_model(ModelType::SelectableTile);
+    Instances tiles;
     for (int i = 0; i < selectable_tiles_.size; i++) {
       const int target{selectable_tiles_.data[i].target};
-      renderer_.set_shader_uniform(picking_, "color", target);
-      renderer_.draw_model(calculate_tile_transform(target), model, nullptr);
+      tiles.emplace_back(
+          Renderer::calculate_model_matrix(calculate_tile_transform(target)),
+          target);
     }
+    renderer_.draw_model_instances(get_model(ModelType::SelectableTile),
+                                   nullptr, {tiles.begin(), tiles.end()});
 
     renderer_.unbind_framebuffer(GL_DRAW_FRAMEBUFFER);
 
-    glFlush();
-    glFinish();
-
     update_picking_texture_ = false;
+    pick_pixel_ = true;
   }
+}
+
+void Game::read_picking_pixel() {
+  const Profiler::Scope zone{profiler_, "read_picking_pixel"};
+
+  // The tile under the cursor is read back a frame late, waiting for it in
+  // the same frame would stall on the GPU
+  int pixel{};
+  const bool has_pixel{renderer_.poll_pixel(pixel)};
 
   GLFWwindow* window = renderer_.get_window();
   if (!is_cursor_active()) {
+    // Picked again once the cursor is back
     pixel_ = -1;
+    pick_pixel_ = false;
+    return;
+  }
+
+  if (has_pixel && pixel != pixel_) {
+    pixel_ = pixel;
+    redraw_ = true;
+  }
+
+  // A picking texture about to be drawn again would give a stale tile
+  if (!pick_pixel_ || update_picking_texture_) {
     return;
   }
 
@@ -232,12 +383,16 @@ void Game::update_picking_texture() {
 
   glm::ivec2 coord{mouse_last_position_};
   coord.y = height - coord.y;
-  pixel_ = Renderer::read_pixel(coord);
+  if (renderer_.request_pixel(coord)) {
+    pick_pixel_ = false;
+  }
 
   renderer_.unbind_framebuffer(GL_READ_FRAMEBUFFER);
 }
 
 void Game::draw_board() {
+  const Profiler::Scope zone{profiler_, "draw_board", true};
+
   Transform transform{};
   transform.scale = k_game_scale;
   transform.rotation = -90.0F;
@@ -245,52 +400,68 @@ void Game::draw_board() {
   Model* model = get_model(ModelType::Board);
 
   renderer_.bind_shader(lighting_);
-  renderer_.set_shader_uniform(lighting_, "light_pos", k_light_position);
-  renderer_.set_shader_uniform(lighting_, "view_pos", camera_.get_position());
   renderer_.draw_model(transform, model, model->mesh.default_);
 }
 
 void Game::draw_pieces() {
+  const Profiler::Scope zone{profiler_, "draw_pieces", true};
+
+  // Pieces of one type and color share a model and material, so each group is
+  // a single draw. Outlined pieces write the stencil and go on their own.
+  std::array<std::array<Instances, 7>, 2> batches;
   for (int tile = 0; tile < 64; tile++) {
     const Piece piece{board_.get_tile(tile)};
-    if (get_piece_type(piece) == PieceType::None) {
+    if (get_piece_type(piece) == PieceType::None || is_outlined_piece(tile)) {
       continue;
     }
 
     Transform transform{calculate_piece_transform(tile)};
-    Model* model = get_model(piece);
-    Material* material = get_piece_color(piece) == PieceColor::White
-                             ? model->mesh.white
-                             : model->mesh.black;
-
     if (!active_move_.is_completed && active_move_.tile == tile) {
       transform.position = active_move_.position;
-      renderer_.draw_model(transform, model, material);
-      continue;
     }
 
-    const bool outline{tile == pixel_ || tile == selected_tile_};
-    if (outline) {
-      // renderer_.clear_stencil();
-      renderer_.begin_stencil_writing();
+    batches[get_color_index(get_piece_color(piece))]
+           [to_underlying(get_piece_type(piece))]
+               .emplace_back(Renderer::calculate_model_matrix(transform), tile);
+  }
+
+  for (const PieceColor color : {PieceColor::Black, PieceColor::White}) {
+    for (size_t type = 1; type < 7; type++) {
+      const Instances& batch{batches[get_color_index(color)][type]};
+      Model* model = get_model(static_cast<PieceType>(type));
+      renderer_.draw_model_instances(
+          model,
+          color == PieceColor::White ? model->mesh.white : model->mesh.black,
+          {batch.begin(), batch.end()});
     }
+  }
 
-    renderer_.draw_model(transform, model, material);
+  for (const int tile : {selected_tile_, pixel_}) {
+    if (!is_outlined_piece(tile) ||
+        (tile == pixel_ && pixel_ == selected_tile_)) {
+      continue;
+    }
 
-    if (outline) {
-      renderer_.end_stencil_writing();
+    const Transform transform{calculate_piece_transform(tile)};
+    const Piece piece{board_.get_tile(tile)};
+    Model* model = get_model(piece);
+    Material* material = get_piece_color(piece) == PieceColor::White
+                             ? model->mesh.white
+                             : model->mesh.black;
 
-      renderer_.bind_shader(outlining_);
-      renderer_.draw_model_outline(transform, model, 0.0125F, k_outline_color);
-      renderer_.bind_shader(lighting_);
-      renderer_.set_shader_uniform(lighting_, "light_pos", k_light_position);
-      renderer_.set_shader_uniform(lighting_, "view_pos",
-                                   camera_.get_position());
-    }
+    renderer_.begin_stencil_writing();
+    renderer_.draw_model(transform, model, material);
+    renderer_.end_stencil_writing();
+
+    renderer_.bind_shader(outlining_);
+    renderer_.draw_model_outline(transform, model, 0.0125F, k_outline_color);
+    renderer_.bind_shader(lighting_);
   }
 }
 
 void Game::draw_selectable_tiles() {
+  const Profiler::Scope zone{profiler_, "draw_selectable_tiles", true};
+
   renderer_.bind_shader(shader_);
 
   glEnable(GL_BLEND);
@@ -303,13 +474,21 @@ void Game::draw_selectable_tiles() {
     hover = pixel_;
   }
 
+  Instances tiles;
   for (int i = 0; i < selectable_tiles_.size; i++) {
-    Material* material{&selectable_tile_};
     const int target{selectable_tiles_.data[i].target};
-    if (target == hover) {
-      material = &selectable_tile_hover_;
+    if (target != hover) {
+      tiles.emplace_back(
+          Renderer::calculate_model_matrix(calculate_tile_transform(target)),
+          target);
     }
-    renderer_.draw_model(calculate_tile_transform(target), model, material);
+  }
+  renderer_.draw_model_instances(model, &selectable_tile_,
+                                 {tiles.begin(), tiles.end()});
+
+  if (is_selectable_tile(hover)) {
+    renderer_.draw_model(calculate_tile_transform(hover), model,
+                         &selectable_tile_hover_);
   }
 
   glDisable(GL_BLEND);
@@ -328,6 +507,7 @@ bool Game::is_cursor_active() const {
 void Game::enable_cursor() {
   glfwSetInputMode(renderer_.get_window(), GLFW_CURSOR, GLFW_CURSOR_NORMAL);
   mouse_last_position_ = mouse_last_position_real_;
+  pick_pixel_ = true;
 }
 
 void Game::disable_cursor() {
@@ -336,8 +516,10 @@ void Game::disable_cursor() {
 }
 
 Model* Game::get_model(Piece piece) const {
-  const PieceType type{get_piece_type(piece)};
+  return get_model(get_piece_type(piece));
+}
 
+Model* Game::get_model(PieceType type) const {
 #define PIECE_TO_MODEL(piece, model) \
   if (type == (piece)) {             \
     return get_model(model);         \
@@ -358,6 +540,12 @@ Model* Game::get_model(ModelType type) const {
   return models_[to_underlying(type)];
 }
 
+bool Game::is_outlined_piece(int tile) const {
+  return is_valid_tile(tile) && (tile == pixel_ || tile == selected_tile_) &&
+         board_.get_type(tile) != PieceType::None &&
+         (active_move_.is_completed || active_move_.tile != tile);
+}
+
 bool Game::is_selectable_tile(int tile) const {
   for (int i = 0; i < selectable_tiles_.size; ++i) {
     if (selectable_tiles_.data[i].target == tile) {
@@ -375,6 +563,10 @@ void Game::move_selected_to(int target) {
   active_move_ = {};
   active_move_.tile = selected_tile_;
   active_move_.target = target;
+  if (board_.get_type(selected_tile_) == PieceType::Pawn &&
+      (target < 8 || target > 55)) {
+    active_move_.promotion = PieceType::Queen;
+  }
   active_move_.position = calculate_tile_position(selected_tile_);
 
   selectable_tiles_ = {};
@@ -395,6 +587,11 @@ void Game::undo() {
   }
 }
 
+void Game::cancel_ai() {
+  ai_search_.stop();
+  ai_result_ = {};
+}
+
 Transform Game::calculate_piece_transform(int tile) {
   const Piece piece{board_.get_tile(tile)};
   return calculate_tile_transform(
@@ -436,6 +633,7 @@ void Game::mouse_button_callback(GLFWwindow* window, int button, int action,
   }
 
   game->update_picking_texture_ = true;
+  game->redraw_ = true;
 }
 
 void Game::mouse_move_callback(GLFWwindow* window, double xpos, double ypos) {
@@ -454,11 +652,15 @@ void Game::mouse_move_callback(GLFWwindow* window, double xpos, double ypos) {
 
   if (game->is_controlling_camera()) {
     game->camera_.process_mouse_movement(offset_x, offset_y);
+    game->redraw_ = true;
 
     if (game->is_cursor_active()) {
       game->disable_cursor();
     }
   }
+
+  // Only redrawn if the hovered tile turns out to be different
+  game->pick_pixel_ = true;
 }
 
 void Game::mouse_scroll_callback(GLFWwindow* window, double /*xoffset*/,
@@ -466,20 +668,33 @@ void Game::mouse_scroll_callback(GLFWwindow* window, double /*xoffset*/,
   auto* game = static_cast<Game*>(glfwGetWindowUserPointer(window));
   game->camera_.process_mouse_scroll(static_cast<float>(yoffset));
   game->update_picking_texture_ = true;
+  game->redraw_ = true;
+}
+
+void Game::window_refresh_callback(GLFWwindow* window) {
+  auto* game = static_cast<Game*>(glfwGetWindowUserPointer(window));
+  game->redraw_ = true;
 }
 
 void Game::key_callback(GLFWwindow* window, int key, int /*scancode*/,
                         int action, int /*mods*/) {
   auto* game = static_cast<Game*>(glfwGetWindowUserPointer(window));
+  if (key == GLFW_KEY_F3 && action == GLFW_PRESS) {
+    game->toggle_profiling();
+    return;
+  }
   if (!game->active_move_.is_completed) {
     return;
   }
   if (key == GLFW_KEY_U && action == GLFW_PRESS) {
+    game->cancel_ai();
     game->undo();
   } else if (key == GLFW_KEY_R && action == GLFW_PRESS) {
+    game->cancel_ai();
     game->board_.load_fen();
   }
   game->selectable_tiles_ = {};
   game->selected_tile_ = -1;
   game->update_picking_texture_ = true;
+  game->redraw_ = true;
 }
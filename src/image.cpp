@@ -0,0 +1,121 @@
+#include "image.hpp"
+
+#include <glad/gl.h>
+#include <stb_image.h>
+
+#include <cstring>
+
+namespace {
+
+constexpr std::array<uint8_t, 12> k_ktx_identifier{
+    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+constexpr uint32_t k_ktx_endianness{0x04030201};
+
+// By component count
+constexpr std::array<uint32_t, 5> k_formats{0, GL_RED, GL_RG, GL_RGB, GL_RGBA};
+
+struct KtxHeader {
+  std::array<uint8_t, 12> identifier;
+  uint32_t endianness;
+  uint32_t type;
+  uint32_t type_size;
+  uint32_t format;
+  uint32_t internal_format;
+  uint32_t base_internal_format;
+  uint32_t width;
+  uint32_t height;
+  uint32_t depth;
+  uint32_t array_elements;
+  uint32_t faces;
+  uint32_t mipmap_levels;
+  uint32_t key_value_bytes;
+};
+
+static_assert(sizeof(KtxHeader) == 64);
+
+}  // namespace
+
+Image load_image(const fs::path& path) {
+  Image image;
+
+  int width{};
+  int height{};
+  int components{};
+  image.pixels = {
+      stbi_load(path.string().c_str(), &width, &height, &components, 0),
+      stbi_image_free};
+  if (image.pixels == nullptr || components < 1 || components > 4) {
+    LOGF_ERROR("GL", "Failed to load \"{}\"", path.string());
+    return {};
+  }
+
+  image.format = k_formats[static_cast<size_t>(components)];
+  image.internal_format = image.format;
+  image.type = GL_UNSIGNED_BYTE;
+  image.levels.push_back(
+      {width, height,
+       {image.pixels.get(), static_cast<size_t>(width) *
+                                static_cast<size_t>(height) *
+                                static_cast<size_t>(components)}});
+  return image;
+}
+
+Image load_ktx(const fs::path& path) {
+  Image image;
+  image.file = std::make_unique<MappedFile>();
+  if (!image.file->open(path)) {
+    return {};
+  }
+
+  const std::string_view data{image.file->get_view()};
+
+  KtxHeader header{};
+  if (data.size() < sizeof(header)) {
+    LOGF_ERROR("GL", "Invalid KTX file \"{}\"", path.string());
+    return {};
+  }
+  std::memcpy(&header, data.data(), sizeof(header));
+
+  // Files written on the other endianness are not worth supporting
+  if (header.identifier != k_ktx_identifier ||
+      header.endianness != k_ktx_endianness || header.width == 0 ||
+      header.height == 0 || header.depth > 1 || header.array_elements > 0 ||
+      header.faces != 1) {
+    LOGF_ERROR("GL", "Unsupported KTX file \"{}\"", path.string());
+    return {};
+  }
+
+  image.format = header.format;
+  image.internal_format = header.internal_format;
+  image.type = header.type;
+
+  size_t offset{sizeof(header) + header.key_value_bytes};
+  const uint32_t level_count{std::max(header.mipmap_levels, 1U)};
+  for (uint32_t level = 0; level < level_count; level++) {
+    uint32_t size{};
+    if (offset > data.size() || data.size() - offset < sizeof(size)) {
+      break;
+    }
+    std::memcpy(&size, data.data() + offset, sizeof(size));
+    offset += sizeof(size);
+
+    if (data.size() - offset < size) {
+      break;
+    }
+
+    image.levels.push_back(
+        {static_cast<int>(std::max(header.width >> level, 1U)),
+         static_cast<int>(std::max(header.height >> level, 1U)),
+         {reinterpret_cast<const uint8_t*>(data.data() + offset), size}});
+
+    // Levels are padded to four bytes
+    offset += (size + 3U) & ~3U;
+  }
+
+  if (image.levels.size() != level_count) {
+    LOGF_ERROR("GL", "Truncated KTX file \"{}\"", path.string());
+    return {};
+  }
+
+  return image;
+}
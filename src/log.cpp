@@ -1,18 +1,160 @@
 #include "log.hpp"
 
-#include <chrono>
-#include <filesystem>
+#include <atomic>
+#include <bit>
 #include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
 
-void log(std::string_view tag, std::string_view message,
-         std::source_location source) {
-  std::cerr
-      << std::format(
-             "[{:%F %T}] - [{}] {} ({}:{}:{})",
-             std::chrono::zoned_time{std::chrono::current_zone(),
-                                     std::chrono::system_clock::now()},
-             tag, message,
-             std::filesystem::path{source.file_name()}.filename().string(),
-             source.function_name(), source.line())
-      << '\n';
+namespace {
+
+constexpr std::array<std::string_view, 3> k_level_names{"DEBUG", "INFO",
+                                                        "ERROR"};
+
+std::string_view get_file_name(std::string_view path) {
+  const size_t separator{path.find_last_of("/\\")};
+  return separator == std::string_view::npos ? path
+                                             : path.substr(separator + 1);
 }
+
+// Bounded multi-producer queue after Dmitry Vyukov, with a single consumer.
+// Producers claim a position with one CAS and own its record until they
+// publish it, so they never wait on each other.
+class Logger {
+  static constexpr size_t k_capacity{512};
+  static_assert(std::has_single_bit(k_capacity));
+
+ public:
+  Logger()
+      : records_{std::make_unique<LogRecord[]>(k_capacity)},
+        sequences_{std::make_unique<std::atomic<size_t>[]>(k_capacity)},
+        zone_{std::chrono::current_zone()} {
+    for (size_t i = 0; i < k_capacity; i++) {
+      sequences_[i].store(i, std::memory_order_relaxed);
+    }
+    writer_ = std::jthread{[this](std::stop_token stop_token) {
+      write(std::move(stop_token));
+    }};
+  }
+
+  ~Logger() {
+    writer_.request_stop();
+    committed_.fetch_add(1, std::memory_order_release);
+    committed_.notify_one();
+  }
+
+  Logger(const Logger&) = delete;
+  Logger& operator=(const Logger&) = delete;
+
+  Logger(Logger&&) = delete;
+  Logger& operator=(Logger&&) = delete;
+
+  LogRecord& begin() {
+    size_t position{enqueue_position_.load(std::memory_order_relaxed)};
+    while (true) {
+      const size_t index{position & (k_capacity - 1)};
+      const auto lag{static_cast<std::ptrdiff_t>(
+          sequences_[index].load(std::memory_order_acquire) - position)};
+      if (lag == 0) {
+        if (enqueue_position_.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed)) {
+          return records_[index];
+        }
+      } else {
+        // Negative when full and the writer has yet to free the slot,
+        // positive when another producer got here first
+        if (lag < 0) {
+          std::this_thread::yield();
+        }
+        position = enqueue_position_.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  void commit(LogRecord& record) {
+    // Nobody else touches the sequence of a claimed slot, it still holds the
+    // position it was claimed at
+    std::atomic<size_t>& sequence{
+        sequences_[static_cast<size_t>(&record - records_.get())]};
+    sequence.store(sequence.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+
+    // Only reaches the kernel when the writer is asleep
+    committed_.fetch_add(1, std::memory_order_release);
+    committed_.notify_one();
+  }
+
+ private:
+  void write(std::stop_token stop_token) {
+    std::string line;
+    size_t position{};
+    while (true) {
+      const uint64_t committed{committed_.load(std::memory_order_acquire)};
+
+      // Records are written in the order their slots were claimed
+      while (true) {
+        const size_t index{position & (k_capacity - 1)};
+        if (sequences_[index].load(std::memory_order_acquire) != position + 1) {
+          break;
+        }
+
+        format(records_[index], line);
+        std::cerr.write(line.data(), static_cast<std::streamsize>(line.size()));
+
+        sequences_[index].store(position + k_capacity,
+                                std::memory_order_release);
+        position++;
+      }
+
+      if (stop_token.stop_requested() &&
+          enqueue_position_.load(std::memory_order_acquire) == position) {
+        break;
+      }
+      committed_.wait(committed, std::memory_order_acquire);
+    }
+  }
+
+  void format(const LogRecord& record, std::string& line) const {
+    line.clear();
+    std::format_to(
+        std::back_inserter(line), "[{:%F %T}] - [{}] [{}] {} ({}:{}:{})\n",
+        std::chrono::zoned_time{zone_, record.time},
+        k_level_names[static_cast<size_t>(record.level)], record.tag,
+        std::string_view{record.message.data(), record.size},
+        get_file_name(record.source.file_name()),
+        record.source.function_name(), record.source.line());
+  }
+
+  std::unique_ptr<LogRecord[]> records_;
+  // Whose turn each record is: position when free to claim, position + 1
+  // once committed
+  std::unique_ptr<std::atomic<size_t>[]> sequences_;
+  std::atomic<size_t> enqueue_position_{};
+  // Bumped on every commit, the writer sleeps on it
+  std::atomic<uint64_t> committed_{};
+
+  // Looked up once, finding the zone goes through the tz database
+  const std::chrono::time_zone* zone_{};
+
+  std::jthread writer_;
+};
+
+Logger& get_logger() {
+  static Logger logger;
+  return logger;
+}
+
+}  // namespace
+
+LogRecord& begin_log_record(LogLevel level, std::string_view tag,
+                            std::source_location source) {
+  LogRecord& record{get_logger().begin()};
+  record.level = level;
+  record.tag = tag;
+  record.source = source;
+  record.time = std::chrono::system_clock::now();
+  return record;
+}
+
+void commit_log_record(LogRecord& record) { get_logger().commit(record); }
@@ -27,14 +27,15 @@ int main() {
   return 0;
 }
 
+#ifndef NDEBUG
 void gl_callback_pre(const char* name, GLADapiproc apiproc, int /*len_args*/,
                      ...) {
   if (apiproc == nullptr) {
-    LOGF("GL", "{} is NULL", name);
+    LOGF_ERROR("GL", "{} is NULL", name);
     return;
   }
   if (glad_glGetError == nullptr) {
-    LOG("GL", "glGetError is NULL");
+    LOG_ERROR("GL", "glGetError is NULL");
     return;
   }
 
@@ -45,12 +46,13 @@ void gl_callback_post(void* /*ret*/, const char* name, GLADapiproc /*apiproc*/,
                       int /*len_args*/, ...) {
   GLenum error_code = glad_glGetError();
   if (error_code != GL_NO_ERROR) {
-    LOGF("GL", "Error in {} ({})", name, error_code);
+    LOGF_ERROR("GL", "Error in {} ({})", name, error_code);
   }
 }
+#endif
 
 void error_callback(int /*error_code*/, const char* description) {
-  LOG("GLFW", description);
+  LOG_ERROR("GLFW", description);
 }
 
 void framebuffer_resize_callback(GLFWwindow* window, int width, int height) {
@@ -63,7 +65,7 @@ GLFWwindow* glfw_init() {
   glfwSetErrorCallback(error_callback);
 
   if (glfwInit() != 1) {
-    LOG("GLFW", "Failed to initialize");
+    LOG_ERROR("GLFW", "Failed to initialize");
     return nullptr;
   }
 
@@ -75,10 +77,10 @@ GLFWwindow* glfw_init() {
   glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
 
-  GLFWwindow* window{glfwCreateWindow(k_window_size.x, k_window_size.y, "Chess",
-                                      nullptr, nullptr)};
+  GLFWwindow* window{glfwCreateWindow(k_window_size.x, k_window_size.y,
+                                      k_window_title, nullptr, nullptr)};
   if (window == nullptr) {
-    LOG("GLFW", "Failed to initialize window");
+    LOG_ERROR("GLFW", "Failed to initialize window");
     glfw_destroy();
     return nullptr;
   }
@@ -88,16 +90,24 @@ GLFWwindow* glfw_init() {
   glfwMakeContextCurrent(window);
   glfwSwapInterval(1);
 
+#ifndef NDEBUG
   gladSetGLPreCallback(gl_callback_pre);
   gladSetGLPostCallback(gl_callback_post);
+#endif
 
   const int version{gladLoadGL(glfwGetProcAddress)};
   if (version == 0) {
-    LOG("GLFW", "Failed to load GL");
+    LOG_ERROR("GLFW", "Failed to load GL");
     glfw_destroy();
     return nullptr;
   }
 
+#ifdef NDEBUG
+  // Release builds call GL directly instead of checking glGetError around
+  // every call
+  gladUninstallGLDebug();
+#endif
+
   return window;
 }
 
@@ -0,0 +1,118 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() { close(); }
+
+#ifdef _WIN32
+
+bool MappedFile::open(const fs::path& path, Access access) {
+  close();
+
+  file_ = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                      OPEN_EXISTING,
+                      access == Access::Sequential ? FILE_FLAG_SEQUENTIAL_SCAN
+                                                   : FILE_FLAG_RANDOM_ACCESS,
+                      nullptr);
+  if (file_ == INVALID_HANDLE_VALUE) {
+    file_ = nullptr;
+    LOGF_ERROR("File", "Failed to open \"{}\"", path.string());
+    return false;
+  }
+
+  LARGE_INTEGER size{};
+  if (GetFileSizeEx(file_, &size) == 0) {
+    LOGF_ERROR("File", "Failed to get the size of \"{}\"", path.string());
+    close();
+    return false;
+  }
+  if (size.QuadPart == 0) {
+    return true;
+  }
+
+  mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+  if (mapping_ != nullptr) {
+    data_ = static_cast<const char*>(
+        MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+  }
+  if (data_ == nullptr) {
+    LOGF_ERROR("File", "Failed to map \"{}\"", path.string());
+    close();
+    return false;
+  }
+
+  size_ = static_cast<size_t>(size.QuadPart);
+  return true;
+}
+
+void MappedFile::close() {
+  if (data_ != nullptr) {
+    UnmapViewOfFile(data_);
+  }
+  if (mapping_ != nullptr) {
+    CloseHandle(mapping_);
+  }
+  if (file_ != nullptr) {
+    CloseHandle(file_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+  mapping_ = nullptr;
+  file_ = nullptr;
+}
+
+#else
+
+bool MappedFile::open(const fs::path& path, Access access) {
+  close();
+
+  const int fd{::open(path.c_str(), O_RDONLY)};
+  if (fd == -1) {
+    LOGF_ERROR("File", "Failed to open \"{}\"", path.string());
+    return false;
+  }
+
+  struct stat status {};
+  if (fstat(fd, &status) != 0) {
+    LOGF_ERROR("File", "Failed to get the size of \"{}\"", path.string());
+    ::close(fd);
+    return false;
+  }
+  if (status.st_size == 0) {
+    ::close(fd);
+    return true;
+  }
+
+  const auto size{static_cast<size_t>(status.st_size)};
+  void* data{mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0)};
+  // The mapping keeps its own reference to the file
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    LOGF_ERROR("File", "Failed to map \"{}\"", path.string());
+    return false;
+  }
+
+  madvise(data, size,
+          access == Access::Sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+  data_ = static_cast<const char*>(data);
+  size_ = size;
+  return true;
+}
+
+void MappedFile::close() {
+  if (data_ != nullptr) {
+    munmap(const_cast<char*>(data_), size_);
+  }
+  data_ = nullptr;
+  size_ = 0;
+}
+
+#endif
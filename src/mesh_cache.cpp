@@ -0,0 +1,190 @@
+#include "mesh_cache.hpp"
+
+#include <cstring>
+#include <fstream>
+
+namespace {
+
+constexpr uint32_t k_magic{0x4348534D};  // "MSHC"
+constexpr uint32_t k_version{1};
+
+// Vertex data starts at this alignment, mappings are page aligned
+constexpr size_t k_data_alignment{16};
+
+static_assert(sizeof(Vertex) == 8 * sizeof(float));
+
+struct Header {
+  uint32_t magic{k_magic};
+  uint32_t version{k_version};
+  uint64_t stamp{};
+  uint32_t vertex_count{};
+  uint32_t index_count{};
+};
+
+// Mixes size and write time of a file, zero if it does not exist
+uint64_t get_file_stamp(const fs::path& path) {
+  std::error_code error;
+  const uintmax_t size{fs::file_size(path, error)};
+  if (error) {
+    return 0;
+  }
+  const auto time{fs::last_write_time(path, error)};
+  if (error) {
+    return 0;
+  }
+
+  const auto ticks{static_cast<uint64_t>(time.time_since_epoch().count())};
+  return (static_cast<uint64_t>(size) * 0x9E3779B97F4A7C15ULL) ^ ticks;
+}
+
+size_t align_up(size_t offset) {
+  return (offset + k_data_alignment - 1) & ~(k_data_alignment - 1);
+}
+
+// Bounds-checked reads from the mapped file
+class Reader {
+ public:
+  explicit Reader(std::string_view data) : data_{data} {}
+
+  template <typename T>
+  bool read(T& value) {
+    if (data_.size() - offset_ < sizeof(T)) {
+      return false;
+    }
+    std::memcpy(&value, data_.data() + offset_, sizeof(T));
+    offset_ += sizeof(T);
+    return true;
+  }
+
+  bool read(std::string& text) {
+    uint32_t size{};
+    if (!read(size) || data_.size() - offset_ < size) {
+      return false;
+    }
+    text.assign(data_.data() + offset_, size);
+    offset_ += size;
+    return true;
+  }
+
+  template <typename T>
+  bool read(std::span<const T>& values, size_t count) {
+    offset_ = align_up(offset_);
+    if (offset_ > data_.size() ||
+        (data_.size() - offset_) / sizeof(T) < count) {
+      return false;
+    }
+    values = {reinterpret_cast<const T*>(data_.data() + offset_), count};
+    offset_ += count * sizeof(T);
+    return true;
+  }
+
+ private:
+  std::string_view data_;
+  size_t offset_{};
+};
+
+}  // namespace
+
+MeshCache::MeshCache(const fs::path& gltf_path)
+    : path_{fs::path{gltf_path}.replace_extension(".mesh")},
+      stamp_{get_file_stamp(gltf_path) ^
+             (get_file_stamp(fs::path{gltf_path}.replace_extension(".bin"))
+              << 1U)} {}
+
+bool MeshCache::load(MeshSource& source) {
+  std::error_code error;
+  if (!fs::exists(path_, error) || !file_.open(path_)) {
+    return false;
+  }
+
+  Reader reader{file_.get_view()};
+
+  Header header;
+  if (!reader.read(header) || header.magic != k_magic ||
+      header.version != k_version || header.stamp != stamp_) {
+    LOGF("GL", "Mesh cache \"{}\" is stale", path_.string());
+    file_.close();
+    return false;
+  }
+
+  for (MeshSource::MaterialSource& material : source.materials) {
+    if (!reader.read(material.name) || !reader.read(material.base_color_uri)) {
+      LOGF_ERROR("GL", "Mesh cache \"{}\" is damaged", path_.string());
+      file_.close();
+      return false;
+    }
+  }
+
+  if (!reader.read(source.vertices, header.vertex_count) ||
+      !reader.read(source.indices, header.index_count)) {
+    LOGF_ERROR("GL", "Mesh cache \"{}\" is damaged", path_.string());
+    file_.close();
+    return false;
+  }
+
+  return true;
+}
+
+void MeshCache::store(const MeshSource& source) const {
+  // Written aside and renamed, so a crash never leaves a torn cache behind
+  fs::path temporary_path{path_};
+  temporary_path += ".tmp";
+
+  {
+    std::ofstream file{temporary_path, std::ios::binary | std::ios::trunc};
+    if (!file) {
+      LOGF_ERROR("GL", "Failed to create mesh cache \"{}\"", path_.string());
+      return;
+    }
+
+    size_t offset{};
+    auto write = [&file, &offset](const void* data, size_t size) {
+      file.write(static_cast<const char*>(data),
+                 static_cast<std::streamsize>(size));
+      offset += size;
+    };
+    auto write_string = [&write](const std::string& text) {
+      const auto size{static_cast<uint32_t>(text.size())};
+      write(&size, sizeof(size));
+      write(text.data(), text.size());
+    };
+    auto pad = [&write, &offset] {
+      constexpr std::array<char, k_data_alignment> k_zeros{};
+      write(k_zeros.data(), align_up(offset) - offset);
+    };
+
+    const Header header{
+        .stamp = stamp_,
+        .vertex_count = static_cast<uint32_t>(source.vertices.size()),
+        .index_count = static_cast<uint32_t>(source.indices.size())};
+    write(&header, sizeof(header));
+
+    for (const MeshSource::MaterialSource& material : source.materials) {
+      write_string(material.name);
+      write_string(material.base_color_uri);
+    }
+
+    pad();
+    write(source.vertices.data(), source.vertices.size_bytes());
+    pad();
+    write(source.indices.data(), source.indices.size_bytes());
+
+    if (!file) {
+      LOGF_ERROR("GL", "Failed to write mesh cache \"{}\"", path_.string());
+      file.close();
+      std::error_code error;
+      fs::remove(temporary_path, error);
+      return;
+    }
+  }
+
+  std::error_code error;
+  fs::rename(temporary_path, path_, error);
+  if (error) {
+    LOGF_ERROR("GL", "Failed to write mesh cache \"{}\"", path_.string());
+    fs::remove(temporary_path, error);
+    return;
+  }
+
+  LOGF_DEBUG("GL", "Mesh cache written (file: \"{}\")", path_.string());
+}
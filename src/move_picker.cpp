@@ -0,0 +1,106 @@
+#include "move_picker.hpp"
+
+#include "evaluation.hpp"
+
+MovePicker::MovePicker(const Board& board, Board::Move table_move,
+                       const Killers& killers, const HistoryTable& history,
+                       bool noisy_only)
+    : board_{board},
+      history_{history},
+      table_move_{table_move},
+      killers_{killers},
+      noisy_only_{noisy_only} {
+  // Table moves can come from another position that collided in the table
+  if (!board_.is_legal_move(table_move_) ||
+      (noisy_only_ && board_.is_quiet(table_move_))) {
+    table_move_ = {};
+  }
+}
+
+Board::Move MovePicker::next() {
+  while (true) {
+    switch (stage_) {
+      case Stage::TableMove:
+        stage_ = Stage::GenerateNoisy;
+        if (table_move_.tile != -1) {
+          return table_move_;
+        }
+        break;
+      case Stage::GenerateNoisy:
+        moves_.size = 0;
+        index_ = 0;
+        board_.generate_noisy(moves_);
+        for (int i = 0; i < moves_.size; i++) {
+          const Board::Move move{moves_.data[i]};
+          PieceType victim{board_.get_type(move.target)};
+          if (victim == PieceType::None && move.promotion == PieceType::None) {
+            victim = PieceType::Pawn;
+          }
+          // Victim values are at least 10 apart, the attacker only breaks
+          // ties. The king has no value, its captures are never recaptured.
+          scores_[i] = 10 * (get_piece_value(victim) +
+                             get_piece_value(move.promotion)) -
+                       get_piece_value(board_.get_type(move.tile)) / 10;
+        }
+        stage_ = Stage::Noisy;
+        break;
+      case Stage::Noisy:
+        while (index_ < moves_.size) {
+          if (const Board::Move move{pick_best()}; move != table_move_) {
+            return move;
+          }
+        }
+        stage_ = noisy_only_ ? Stage::Done : Stage::Killers;
+        break;
+      case Stage::Killers:
+        while (killer_index_ < static_cast<int>(killers_.size())) {
+          const Board::Move killer{killers_[killer_index_++]};
+          if (killer.tile != -1 && killer != table_move_ &&
+              board_.is_quiet(killer) && board_.is_legal_move(killer)) {
+            return killer;
+          }
+        }
+        stage_ = Stage::GenerateQuiet;
+        break;
+      case Stage::GenerateQuiet: {
+        moves_.size = 0;
+        index_ = 0;
+        board_.generate_quiet(moves_);
+        const auto& history{history_[get_color_index(board_.get_turn())]};
+        for (int i = 0; i < moves_.size; i++) {
+          scores_[i] = history[moves_.data[i].tile][moves_.data[i].target];
+        }
+        stage_ = Stage::Quiet;
+        break;
+      }
+      case Stage::Quiet:
+        while (index_ < moves_.size) {
+          if (const Board::Move move{pick_best()}; !is_skipped(move)) {
+            return move;
+          }
+        }
+        stage_ = Stage::Done;
+        break;
+      case Stage::Done:
+        return {};
+    }
+  }
+}
+
+// Selection sort one step at a time, cheaper than a full sort when a cutoff
+// comes after a few moves
+Board::Move MovePicker::pick_best() {
+  int best{index_};
+  for (int i = index_ + 1; i < moves_.size; i++) {
+    if (scores_[i] > scores_[best]) {
+      best = i;
+    }
+  }
+  std::swap(moves_.data[best], moves_.data[index_]);
+  std::swap(scores_[best], scores_[index_]);
+  return moves_.data[index_++];
+}
+
+bool MovePicker::is_skipped(Board::Move move) const {
+  return move == table_move_ || move == killers_[0] || move == killers_[1];
+}
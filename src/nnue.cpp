@@ -0,0 +1,294 @@
+#include "nnue.hpp"
+
+#include <bit>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace {
+
+// Quantization of the hidden layer and the output weights, and the scale that
+// turns the output into centipawns
+constexpr int k_hidden_scale{255};
+constexpr int k_output_scale{64};
+constexpr int k_eval_scale{400};
+
+constexpr size_t k_network_values{
+    size_t{k_network_inputs} * k_network_hidden + k_network_hidden +
+    2 * k_network_hidden + 1};
+
+// Trainers pad the file to a multiple of this
+constexpr size_t k_network_alignment{64};
+
+// Indexed by PieceType, pawn to king as the trainer orders them
+constexpr std::array<int, 7> k_feature_types{0, 5, 4, 2, 1, 3, 0};
+
+int get_feature(PieceColor side, Piece piece, int tile) {
+  // Each side sees the board from its own first rank
+  const int relative_tile{side == PieceColor::White ? tile : tile ^ 56};
+  const int relation{get_piece_color(piece) == side ? 0 : 1};
+  const int type{k_feature_types[to_underlying(get_piece_type(piece))]};
+  return (relation * 6 + type) * 64 + relative_tile;
+}
+
+// The kernels below are written once against these, the widest instruction
+// set the compiler targets is picked
+#if defined(__AVX2__)
+
+using Vector = __m256i;
+using Sum = __m256i;
+
+Vector load(const int16_t* data) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+}
+
+void store(int16_t* data, Vector value) {
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(data), value);
+}
+
+Vector add(Vector a, Vector b) { return _mm256_add_epi16(a, b); }
+Vector subtract(Vector a, Vector b) { return _mm256_sub_epi16(a, b); }
+
+Sum zero_sum() { return _mm256_setzero_si256(); }
+
+// Adds clamp(value)^2 * weight, the first product fits 16 bits as long as the
+// weights stay within +-127
+Sum add_squared_product(Sum sum, Vector value, Vector weights) {
+  const Vector clipped{_mm256_min_epi16(
+      _mm256_max_epi16(value, _mm256_setzero_si256()),
+      _mm256_set1_epi16(k_hidden_scale))};
+  return _mm256_add_epi32(
+      sum, _mm256_madd_epi16(_mm256_mullo_epi16(clipped, weights), clipped));
+}
+
+int reduce(Sum sum) {
+  __m128i half{_mm_add_epi32(_mm256_castsi256_si128(sum),
+                             _mm256_extracti128_si256(sum, 1))};
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+  half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+  return _mm_cvtsi128_si32(half);
+}
+
+#elif defined(__SSE2__)
+
+using Vector = __m128i;
+using Sum = __m128i;
+
+Vector load(const int16_t* data) {
+  return _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+}
+
+void store(int16_t* data, Vector value) {
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(data), value);
+}
+
+Vector add(Vector a, Vector b) { return _mm_add_epi16(a, b); }
+Vector subtract(Vector a, Vector b) { return _mm_sub_epi16(a, b); }
+
+Sum zero_sum() { return _mm_setzero_si128(); }
+
+Sum add_squared_product(Sum sum, Vector value, Vector weights) {
+  const Vector clipped{
+      _mm_min_epi16(_mm_max_epi16(value, _mm_setzero_si128()),
+                    _mm_set1_epi16(k_hidden_scale))};
+  return _mm_add_epi32(
+      sum, _mm_madd_epi16(_mm_mullo_epi16(clipped, weights), clipped));
+}
+
+int reduce(Sum sum) {
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+  sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+  return _mm_cvtsi128_si32(sum);
+}
+
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+
+using Vector = int16x8_t;
+using Sum = int32x4_t;
+
+Vector load(const int16_t* data) { return vld1q_s16(data); }
+void store(int16_t* data, Vector value) { vst1q_s16(data, value); }
+
+Vector add(Vector a, Vector b) { return vaddq_s16(a, b); }
+Vector subtract(Vector a, Vector b) { return vsubq_s16(a, b); }
+
+Sum zero_sum() { return vdupq_n_s32(0); }
+
+Sum add_squared_product(Sum sum, Vector value, Vector weights) {
+  const Vector clipped{vminq_s16(vmaxq_s16(value, vdupq_n_s16(0)),
+                                 vdupq_n_s16(k_hidden_scale))};
+  const Vector product{vmulq_s16(clipped, weights)};
+  sum = vmlal_s16(sum, vget_low_s16(product), vget_low_s16(clipped));
+  return vmlal_high_s16(sum, product, clipped);
+}
+
+int reduce(Sum sum) { return vaddvq_s32(sum); }
+
+#else
+
+using Vector = int16_t;
+using Sum = int;
+
+Vector load(const int16_t* data) { return *data; }
+void store(int16_t* data, Vector value) { *data = value; }
+
+Vector add(Vector a, Vector b) { return static_cast<int16_t>(a + b); }
+Vector subtract(Vector a, Vector b) { return static_cast<int16_t>(a - b); }
+
+Sum zero_sum() { return 0; }
+
+Sum add_squared_product(Sum sum, Vector value, Vector weights) {
+  const int clipped{std::clamp<int>(value, 0, k_hidden_scale)};
+  return sum + clipped * clipped * weights;
+}
+
+int reduce(Sum sum) { return sum; }
+
+#endif
+
+constexpr int k_lanes{sizeof(Vector) / sizeof(int16_t)};
+static_assert(k_network_hidden % k_lanes == 0);
+
+using Rows = FixedStack<const int16_t*, 2>;
+
+// output = input + added - removed, a vector at a time
+void update_rows(const int16_t* input, int16_t* output, const Rows& added,
+                 const Rows& removed) {
+  for (int i = 0; i < k_network_hidden; i += k_lanes) {
+    Vector value{load(input + i)};
+    for (const int16_t* row : added) {
+      value = add(value, load(row + i));
+    }
+    for (const int16_t* row : removed) {
+      value = subtract(value, load(row + i));
+    }
+    store(output + i, value);
+  }
+}
+
+int sum_squared_products(const int16_t* values, const int16_t* weights) {
+  Sum sum{zero_sum()};
+  for (int i = 0; i < k_network_hidden; i += k_lanes) {
+    sum = add_squared_product(sum, load(values + i), load(weights + i));
+  }
+  return reduce(sum);
+}
+
+}  // namespace
+
+bool Network::open(const fs::path& path) {
+  close();
+
+  if constexpr (std::endian::native != std::endian::little) {
+    LOG_ERROR("NNUE", "Networks are little-endian, this machine is not");
+    return false;
+  }
+
+  if (!file_.open(path)) {
+    return false;
+  }
+
+  const std::string_view data{file_.get_view()};
+  const size_t size{k_network_values * sizeof(int16_t)};
+  if (data.size() < size || data.size() - size >= k_network_alignment) {
+    LOGF_ERROR("NNUE", "Invalid network \"{}\" (size: {}, expected: {})",
+               path.string(), data.size(), size);
+    file_.close();
+    return false;
+  }
+
+  // Mappings start on a page, every layer stays aligned
+  const auto* values{reinterpret_cast<const int16_t*>(data.data())};
+  feature_weights_ = values;
+  feature_biases_ =
+      feature_weights_ + size_t{k_network_inputs} * k_network_hidden;
+  output_weights_ = feature_biases_ + k_network_hidden;
+  output_bias_ = output_weights_[2 * k_network_hidden];
+
+  LOGF_DEBUG("NNUE", "Network opened (file: \"{}\")", path.string());
+  return true;
+}
+
+void Network::close() {
+  file_.close();
+  feature_weights_ = nullptr;
+  feature_biases_ = nullptr;
+  output_weights_ = nullptr;
+  output_bias_ = 0;
+}
+
+Accumulators::Accumulators(const Network& network, size_t capacity)
+    : network_{network}, accumulators_(capacity) {
+  ASSERT(network_.is_open() && capacity > 0);
+}
+
+void Accumulators::reset(const Board& board) {
+  size_ = 1;
+  Accumulator& accumulator{accumulators_[0]};
+
+  for (const PieceColor side : {PieceColor::Black, PieceColor::White}) {
+    std::array<int16_t, k_network_hidden>& values{
+        accumulator.values[get_color_index(side)]};
+    std::copy_n(network_.get_feature_biases(), k_network_hidden,
+                values.begin());
+
+    for (Bitboard pieces{board.get_occupancy()}; pieces != 0;) {
+      const int tile{pop_first_tile(pieces)};
+      Rows added;
+      added.emplace_back(
+          network_.get_feature_weights(get_feature(side, board.get_tile(tile),
+                                                   tile)));
+      update_rows(values.data(), values.data(), added, {});
+    }
+  }
+}
+
+void Accumulators::push(const Board& board) {
+  ASSERT(size_ > 0 && size_ < accumulators_.size());
+
+  const Board::MoveChanges changes{board.get_last_move_changes()};
+  const Accumulator& previous{accumulators_[size_ - 1]};
+  Accumulator& next{accumulators_[size_++]};
+
+  for (const PieceColor side : {PieceColor::Black, PieceColor::White}) {
+    Rows added;
+    for (const Board::PieceChange& change : changes.added) {
+      added.emplace_back(network_.get_feature_weights(
+          get_feature(side, change.piece, change.tile)));
+    }
+    Rows removed;
+    for (const Board::PieceChange& change : changes.removed) {
+      removed.emplace_back(network_.get_feature_weights(
+          get_feature(side, change.piece, change.tile)));
+    }
+
+    const uint8_t index{get_color_index(side)};
+    update_rows(previous.values[index].data(), next.values[index].data(),
+                added, removed);
+  }
+}
+
+void Accumulators::pop() {
+  ASSERT(size_ > 1);
+  size_--;
+}
+
+int Accumulators::evaluate(PieceColor turn) const {
+  ASSERT(size_ > 0);
+
+  const Accumulator& accumulator{accumulators_[size_ - 1]};
+  const int16_t* weights{network_.get_output_weights()};
+  const int sum{
+      sum_squared_products(accumulator.values[get_color_index(turn)].data(),
+                           weights) +
+      sum_squared_products(
+          accumulator.values[get_color_index(get_opposite_color(turn))].data(),
+          weights + k_network_hidden)};
+
+  // The squares carry the hidden scale twice, the bias only once
+  return (sum / k_hidden_scale + network_.get_output_bias()) * k_eval_scale /
+         (k_hidden_scale * k_output_scale);
+}
@@ -0,0 +1,232 @@
+#include "notation.hpp"
+
+namespace {
+
+constexpr char get_promotion_char(PieceType type) {
+  switch (type) {
+    case PieceType::Queen:
+      return 'q';
+    case PieceType::Bishop:
+      return 'b';
+    case PieceType::Knight:
+      return 'n';
+    case PieceType::Rook:
+      return 'r';
+    default:
+      return '\0';
+  }
+}
+
+// Indexed by PieceType, pawns have no letter
+constexpr std::string_view k_san_piece_chars{" KQBNR"};
+
+PieceType parse_san_piece_char(char ch) {
+  const size_t index{k_san_piece_chars.find(ch)};
+  return index == std::string_view::npos || index == 0
+             ? PieceType::None
+             : static_cast<PieceType>(index);
+}
+
+bool is_castling(const Board& board, Board::Move move) {
+  return board.get_type(move.tile) == PieceType::King &&
+         std::abs(move.target - move.tile) == 2;
+}
+
+}  // namespace
+
+std::string get_tile_name(int tile) {
+  if (!is_valid_tile(tile)) {
+    return "-";
+  }
+  return {static_cast<char>('a' + get_tile_column(tile)),
+          static_cast<char>('1' + get_tile_row(tile))};
+}
+
+int parse_tile_name(std::string_view name) {
+  if (name.size() != 2 || name[0] < 'a' || name[0] > 'h' || name[1] < '1' ||
+      name[1] > '8') {
+    return -1;
+  }
+  return 8 * (name[1] - '1') + (name[0] - 'a');
+}
+
+std::string to_uci_move(Board::Move move) {
+  if (move.tile == -1) {
+    return "0000";
+  }
+
+  std::string text{get_tile_name(move.tile) + get_tile_name(move.target)};
+  if (const char promotion{get_promotion_char(move.promotion)};
+      promotion != '\0') {
+    text += promotion;
+  }
+  return text;
+}
+
+Board::Move parse_uci_move(const Board& board, std::string_view text) {
+  if (text.size() != 4 && text.size() != 5) {
+    return {};
+  }
+
+  const int tile{parse_tile_name(text.substr(0, 2))};
+  const int target{parse_tile_name(text.substr(2, 2))};
+  if (tile == -1 || target == -1) {
+    return {};
+  }
+
+  PieceType promotion{};
+  if (text.size() == 5) {
+    for (const PieceType type : {PieceType::Queen, PieceType::Bishop,
+                                 PieceType::Knight, PieceType::Rook}) {
+      if (get_promotion_char(type) == text[4]) {
+        promotion = type;
+      }
+    }
+    if (promotion == PieceType::None) {
+      return {};
+    }
+  }
+
+  const Board::Move move{tile, target, promotion};
+  return board.is_legal_move(move) ? move : Board::Move{};
+}
+
+std::string to_san_move(Board& board, Board::Move move) {
+  std::string text;
+  const PieceType type{board.get_type(move.tile)};
+
+  if (is_castling(board, move)) {
+    text = move.target > move.tile ? "O-O" : "O-O-O";
+  } else {
+    // En passant is the only capture onto an empty tile
+    const bool is_capture{board.get_type(move.target) != PieceType::None ||
+                          (type == PieceType::Pawn &&
+                           get_tile_column(move.tile) !=
+                               get_tile_column(move.target))};
+
+    if (type == PieceType::Pawn) {
+      if (is_capture) {
+        text += get_tile_name(move.tile).front();
+      }
+    } else {
+      text += k_san_piece_chars[to_underlying(type)];
+
+      // Name as little of the origin as tells it apart from the other pieces
+      // of its kind that can reach the target
+      bool is_ambiguous{};
+      bool shares_column{};
+      bool shares_row{};
+      Board::Moves moves;
+      board.generate_all(moves);
+      for (int i = 0; i < moves.size; i++) {
+        const Board::Move other{moves.data[i]};
+        if (other.target == move.target && other.tile != move.tile &&
+            board.get_type(other.tile) == type) {
+          is_ambiguous = true;
+          shares_column |=
+              get_tile_column(other.tile) == get_tile_column(move.tile);
+          shares_row |= get_tile_row(other.tile) == get_tile_row(move.tile);
+        }
+      }
+
+      const std::string origin{get_tile_name(move.tile)};
+      if (is_ambiguous && (!shares_column || shares_row)) {
+        text += origin[0];
+      }
+      if (is_ambiguous && shares_column) {
+        text += origin[1];
+      }
+    }
+
+    if (is_capture) {
+      text += 'x';
+    }
+    text += get_tile_name(move.target);
+    if (move.promotion != PieceType::None) {
+      text += '=';
+      text += k_san_piece_chars[to_underlying(move.promotion)];
+    }
+  }
+
+  board.move(move);
+  if (board.is_in_check()) {
+    text += board.has_any_legal_move() ? '+' : '#';
+  }
+  board.undo();
+
+  return text;
+}
+
+Board::Move parse_san_move(const Board& board, std::string_view text) {
+  while (!text.empty() && std::string_view{"+#!?"}.find(text.back()) !=
+                              std::string_view::npos) {
+    text.remove_suffix(1);
+  }
+
+  Board::Moves moves;
+  board.generate_all(moves);
+
+  if (text == "O-O" || text == "0-0" || text == "O-O-O" || text == "0-0-0") {
+    const bool is_short{text.size() == 3};
+    for (int i = 0; i < moves.size; i++) {
+      const Board::Move move{moves.data[i]};
+      if (is_castling(board, move) && (move.target > move.tile) == is_short) {
+        return move;
+      }
+    }
+    return {};
+  }
+
+  PieceType type{PieceType::Pawn};
+  if (!text.empty() && parse_san_piece_char(text.front()) != PieceType::None) {
+    type = parse_san_piece_char(text.front());
+    text.remove_prefix(1);
+  }
+
+  PieceType promotion{};
+  if (type == PieceType::Pawn && text.size() > 2 &&
+      parse_san_piece_char(text.back()) != PieceType::None) {
+    promotion = parse_san_piece_char(text.back());
+    text.remove_suffix(text[text.size() - 2] == '=' ? 2 : 1);
+  }
+
+  if (text.size() < 2) {
+    return {};
+  }
+  const int target{parse_tile_name(text.substr(text.size() - 2))};
+  text.remove_suffix(2);
+  if (!text.empty() && text.back() == 'x') {
+    text.remove_suffix(1);
+  }
+
+  // Whatever is left names the origin, a column, a row or both
+  int column{-1};
+  int row{-1};
+  if (!text.empty() && text.front() >= 'a' && text.front() <= 'h') {
+    column = text.front() - 'a';
+    text.remove_prefix(1);
+  }
+  if (!text.empty() && text.front() >= '1' && text.front() <= '8') {
+    row = text.front() - '1';
+    text.remove_prefix(1);
+  }
+  if (target == -1 || !text.empty()) {
+    return {};
+  }
+
+  Board::Move found;
+  for (int i = 0; i < moves.size; i++) {
+    const Board::Move move{moves.data[i]};
+    if (move.target != target || move.promotion != promotion ||
+        board.get_type(move.tile) != type ||
+        (column != -1 && get_tile_column(move.tile) != column) ||
+        (row != -1 && get_tile_row(move.tile) != row)) {
+      continue;
+    }
+    if (found.tile != -1) {
+      return {};
+    }
+    found = move;
+  }
+  return found;
+}
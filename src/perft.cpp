@@ -0,0 +1,193 @@
+#include "perft.hpp"
+
+#include <algorithm>
+#include <numeric>
+
+#include "thread_pool.hpp"
+
+namespace {
+
+// Node counts never get close to 2^56, which leaves the low byte for the depth
+constexpr uint64_t pack_entry(int depth, uint64_t nodes) {
+  return (nodes << 8U) | static_cast<uint8_t>(depth);
+}
+
+constexpr int get_entry_depth(uint64_t data) {
+  return static_cast<int>(data & 0xFFU);
+}
+
+constexpr uint64_t get_entry_nodes(uint64_t data) { return data >> 8U; }
+
+}  // namespace
+
+PerftTable::PerftTable(size_t size_mb) {
+  // Round down to a power of two so the bucket index is a mask
+  bucket_count_ = std::bit_floor(
+      std::max<size_t>(size_mb * 1024 * 1024 / sizeof(Bucket), 1));
+  buckets_ = std::make_unique<Bucket[]>(bucket_count_);
+  clear();
+}
+
+bool PerftTable::probe(uint64_t hash, int depth, uint64_t& nodes) const {
+  for (const Entry& entry : get_bucket(hash).entries) {
+    const uint64_t data{entry.data.load(std::memory_order_relaxed)};
+    if ((entry.key.load(std::memory_order_relaxed) ^ data) == hash &&
+        get_entry_depth(data) == depth) {
+      nodes = get_entry_nodes(data);
+      return true;
+    }
+  }
+  return false;
+}
+
+void PerftTable::store(uint64_t hash, int depth, uint64_t nodes) {
+  // Replace the shallowest entry, deep subtrees are the expensive ones
+  Entry* replace{};
+  int replace_depth{256};
+  for (Entry& entry : get_bucket(hash).entries) {
+    const int entry_depth{
+        get_entry_depth(entry.data.load(std::memory_order_relaxed))};
+    if (entry_depth < replace_depth) {
+      replace = &entry;
+      replace_depth = entry_depth;
+    }
+  }
+
+  const uint64_t data{pack_entry(depth, nodes)};
+  replace->key.store(hash ^ data, std::memory_order_relaxed);
+  replace->data.store(data, std::memory_order_relaxed);
+}
+
+void PerftTable::clear() {
+  for (size_t i = 0; i < bucket_count_; i++) {
+    for (Entry& entry : buckets_[i].entries) {
+      entry.key.store(0, std::memory_order_relaxed);
+      entry.data.store(0, std::memory_order_relaxed);
+    }
+  }
+}
+
+uint64_t perft(Board& board, int depth, const PerftOptions& options) {
+  if (depth == 0) {
+    return 1;
+  }
+
+  uint64_t nodes{};
+  if (options.table != nullptr &&
+      options.table->probe(board.get_hash(), depth, nodes)) {
+    return nodes;
+  }
+
+  Board::Moves moves;
+  board.generate_all(moves);
+
+  if (depth == 1 && options.bulk_counting) {
+    nodes = static_cast<uint64_t>(moves.size);
+  } else {
+    for (int i = 0; i < moves.size; i++) {
+      board.move(moves.data[i]);
+      nodes += perft(board, depth - 1, options);
+      board.undo();
+    }
+  }
+
+  // Depth 1 is cheaper to regenerate than to look up
+  if (options.table != nullptr && depth > 1) {
+    options.table->store(board.get_hash(), depth, nodes);
+  }
+
+  return nodes;
+}
+
+PerftDivide perft_divide(const Board& board, int depth, int threads,
+                         const PerftOptions& options) {
+  Board root{board};
+
+  Board::Moves moves;
+  root.generate_all(moves);
+
+  PerftDivide divide(static_cast<size_t>(moves.size));
+  for (int i = 0; i < moves.size; i++) {
+    divide[static_cast<size_t>(i)].move = moves.data[i];
+  }
+
+  if (depth <= 1) {
+    for (PerftSplit& split : divide) {
+      split.nodes = depth == 1 ? 1 : 0;
+    }
+    return divide;
+  }
+
+  // A job is a root move and, when deep enough, one reply to it
+  struct Job {
+    int root{};
+    Board::Move reply;
+  };
+
+  std::vector<Job> jobs;
+  for (int i = 0; i < moves.size; i++) {
+    if (depth < 3) {
+      jobs.push_back({i, {}});
+      continue;
+    }
+
+    root.move(moves.data[i]);
+    Board::Moves replies;
+    root.generate_all(replies);
+    for (int j = 0; j < replies.size; j++) {
+      jobs.push_back({i, replies.data[j]});
+    }
+    root.undo();
+  }
+
+  ThreadPool pool{threads};
+  std::atomic<size_t> next_job{};
+
+  auto work = [&] {
+    Board worker{root};
+    std::vector<uint64_t> nodes(divide.size());
+    for (size_t i = next_job++; i < jobs.size(); i = next_job++) {
+      const Job& job{jobs[i]};
+      worker.move(moves.data[job.root]);
+      if (depth < 3) {
+        nodes[static_cast<size_t>(job.root)] +=
+            perft(worker, depth - 1, options);
+      } else {
+        worker.move(job.reply);
+        nodes[static_cast<size_t>(job.root)] +=
+            perft(worker, depth - 2, options);
+        worker.undo();
+      }
+      worker.undo();
+    }
+    return nodes;
+  };
+
+  std::vector<std::future<std::vector<uint64_t>>> results;
+  for (int i = 0; i < pool.get_size(); i++) {
+    results.push_back(pool.submit(work));
+  }
+
+  for (auto& result : results) {
+    const std::vector<uint64_t> nodes{result.get()};
+    for (size_t i = 0; i < divide.size(); i++) {
+      divide[i].nodes += nodes[i];
+    }
+  }
+
+  return divide;
+}
+
+uint64_t perft_parallel(const Board& board, int depth, int threads,
+                        const PerftOptions& options) {
+  if (depth == 0) {
+    return 1;
+  }
+
+  const PerftDivide divide{perft_divide(board, depth, threads, options)};
+  return std::accumulate(
+      divide.begin(), divide.end(), uint64_t{},
+      [](uint64_t nodes, const PerftSplit& split) {
+        return nodes + split.nodes;
+      });
+}
@@ -0,0 +1,231 @@
+#include "pgn.hpp"
+
+#include <istream>
+
+#include "notation.hpp"
+
+namespace {
+
+// Read size, a line longer than this grows the buffer
+constexpr size_t k_chunk_size{size_t{1} << 16U};
+
+constexpr std::string_view k_byte_order_mark{"\xEF\xBB\xBF"};
+
+// [Name "Value"], with \" and \\ escaped in the value
+bool parse_tag(std::string_view line, PgnTag& tag) {
+  line.remove_prefix(1);
+  const size_t quote{line.find('"')};
+  if (quote == std::string_view::npos) {
+    return false;
+  }
+
+  const std::string_view name{line.substr(0, quote)};
+  tag.name = name.substr(0, std::min(name.find_first_of(" \t"), name.size()));
+  tag.value.clear();
+  for (size_t i = quote + 1; i < line.size(); i++) {
+    if (line[i] == '"') {
+      return !tag.name.empty();
+    }
+    if (line[i] == '\\' && i + 1 < line.size()) {
+      i++;
+    }
+    tag.value += line[i];
+  }
+  return false;
+}
+
+// Whether a brace comment is still open at the end of the line
+bool is_in_comment(std::string_view line, bool in_comment) {
+  for (const char ch : line) {
+    if (in_comment) {
+      in_comment = ch != '}';
+    } else if (ch == '{') {
+      in_comment = true;
+    } else if (ch == ';') {
+      break;
+    }
+  }
+  return in_comment;
+}
+
+void skip_past(std::string_view& text, char ch) {
+  text.remove_prefix(std::min(text.find(ch), text.size() - 1) + 1);
+}
+
+void skip_variation(std::string_view& text) {
+  int depth{};
+  while (!text.empty()) {
+    const char ch{text.front()};
+    if (ch == '{') {
+      skip_past(text, '}');
+      continue;
+    }
+    if (ch == ';') {
+      skip_past(text, '\n');
+      continue;
+    }
+
+    text.remove_prefix(1);
+    if (ch == '(') {
+      depth++;
+    } else if (ch == ')' && --depth == 0) {
+      return;
+    }
+  }
+}
+
+bool is_digit(char ch) { return ch >= '0' && ch <= '9'; }
+
+// Next move of the movetext, empty at its end or at the result
+std::string_view next_san_token(std::string_view& text) {
+  while (!text.empty()) {
+    const char ch{text.front()};
+    if (ch == ' ' || ch == '\t' || ch == '\n' || ch == '.' || ch == ')' ||
+        ch == '}') {
+      text.remove_prefix(1);
+    } else if (ch == '{') {
+      skip_past(text, '}');
+    } else if (ch == ';') {
+      skip_past(text, '\n');
+    } else if (ch == '(') {
+      skip_variation(text);
+    } else if (ch == '$') {
+      text.remove_prefix(
+          std::min(text.find_first_not_of("0123456789", 1), text.size()));
+    } else if (const size_t digits{text.find_first_not_of("0123456789")};
+               is_digit(ch) && digits != std::string_view::npos &&
+               text[digits] == '.') {
+      // Move numbers like 12. or 12...
+      text.remove_prefix(digits);
+    } else {
+      const size_t end{
+          std::min(text.find_first_of(" \t\n{}();$"), text.size())};
+      const std::string_view token{text.substr(0, end)};
+      text.remove_prefix(end);
+      if (token == "1-0" || token == "0-1" || token == "1/2-1/2" ||
+          token == "*") {
+        return {};
+      }
+      return token;
+    }
+  }
+  return {};
+}
+
+}  // namespace
+
+std::string_view PgnGame::get_tag(std::string_view name) const {
+  for (const PgnTag& tag : tags) {
+    if (tag.name == name) {
+      return tag.value;
+    }
+  }
+  return {};
+}
+
+PgnReader::PgnReader(std::istream& input)
+    : input_{input}, buffer_(k_chunk_size) {}
+
+bool PgnReader::read_game(PgnGame& game) {
+  game.tags.clear();
+  game.movetext.clear();
+
+  bool in_comment{};
+  std::string_view line;
+  for (;;) {
+    if (has_pending_line_) {
+      line = pending_line_;
+      has_pending_line_ = false;
+    } else if (!read_line(line)) {
+      break;
+    }
+
+    if (line.starts_with(k_byte_order_mark)) {
+      line.remove_prefix(k_byte_order_mark.size());
+    }
+    line.remove_prefix(std::min(line.find_first_not_of(" \t"), line.size()));
+
+    if (!in_comment) {
+      if (line.empty()) {
+        if (!game.movetext.empty()) {
+          return true;
+        }
+        continue;
+      }
+      if (line.front() == '%') {
+        continue;
+      }
+      if (line.front() == '[') {
+        if (!game.movetext.empty()) {
+          pending_line_ = line;
+          has_pending_line_ = true;
+          return true;
+        }
+        if (PgnTag tag; parse_tag(line, tag)) {
+          game.tags.push_back(std::move(tag));
+        }
+        continue;
+      }
+    }
+
+    // Kept as lines, a ; comment runs to the end of one
+    game.movetext.append(line).push_back('\n');
+    in_comment = is_in_comment(line, in_comment);
+  }
+
+  return !game.tags.empty() || !game.movetext.empty();
+}
+
+bool PgnReader::read_line(std::string_view& line) {
+  for (;;) {
+    const auto begin{buffer_.begin() + static_cast<std::ptrdiff_t>(begin_)};
+    const auto end{buffer_.begin() + static_cast<std::ptrdiff_t>(end_)};
+    const auto newline{std::find(begin, end, '\n')};
+    if (newline != end || (!input_ && begin_ != end_)) {
+      line = {buffer_.data() + begin_,
+              static_cast<size_t>(newline - begin)};
+      begin_ = std::min(end_, begin_ + line.size() + 1);
+      if (!line.empty() && line.back() == '\r') {
+        line.remove_suffix(1);
+      }
+      return true;
+    }
+    if (!input_) {
+      return false;
+    }
+
+    // Keep the partial line at the front and fill up the rest
+    std::copy(begin, end, buffer_.begin());
+    end_ -= begin_;
+    begin_ = 0;
+    if (end_ == buffer_.size()) {
+      buffer_.resize(buffer_.size() * 2);
+    }
+    input_.read(buffer_.data() + end_,
+                static_cast<std::streamsize>(buffer_.size() - end_));
+    end_ += static_cast<size_t>(input_.gcount());
+  }
+}
+
+bool replay_pgn_game(const PgnGame& game, Board& board,
+                     const PgnMoveCallback& on_move) {
+  if (const std::string_view fen{game.get_tag("FEN")}; fen.empty()) {
+    board.load_fen();
+  } else if (!board.load_fen(fen)) {
+    return false;
+  }
+
+  std::string_view movetext{game.movetext};
+  for (std::string_view token{next_san_token(movetext)}; !token.empty();
+       token = next_san_token(movetext)) {
+    const Board::Move move{parse_san_move(board, token)};
+    if (move.tile == -1 || board.get_records().full()) {
+      return false;
+    }
+    if (on_move) {
+      on_move(board, move);
+    }
+    board.move(move);
+  }
+  return true;
+}
@@ -0,0 +1,101 @@
+#include "profiler.hpp"
+
+Profiler::Profiler() {
+  for (auto& queries : queries_) {
+    glGenQueries(static_cast<GLsizei>(queries.size()), queries.data());
+  }
+}
+
+Profiler::~Profiler() {
+  for (auto& queries : queries_) {
+    glDeleteQueries(static_cast<GLsizei>(queries.size()), queries.data());
+  }
+}
+
+void Profiler::set_enabled(bool enabled) {
+  ASSERT(open_zones_.empty());
+  if (enabled && !enabled_) {
+    zone_count_ = 0;
+    queries_issued_ = {};
+  }
+  enabled_ = enabled;
+}
+
+void Profiler::begin_frame() {
+  if (!enabled_) {
+    return;
+  }
+
+  // The queries of this frame were last issued k_query_frames ago, results
+  // that still aren't there are skipped
+  auto& issued{queries_issued_[frame_ % k_query_frames]};
+  const auto& queries{queries_[frame_ % k_query_frames]};
+  for (size_t i = 0; i < zone_count_; i++) {
+    if (!issued[i]) {
+      continue;
+    }
+
+    GLint available{};
+    glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available == GL_TRUE) {
+      GLuint64 elapsed{};
+      glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &elapsed);
+      zones_[i].gpu_ms = static_cast<double>(elapsed) / 1e6;
+    }
+    issued[i] = false;
+  }
+}
+
+void Profiler::end_frame() {
+  if (!enabled_) {
+    return;
+  }
+
+  ASSERT(open_zones_.empty());
+  frame_++;
+}
+
+void Profiler::begin_zone(const char* name, bool gpu) {
+  if (!enabled_) {
+    return;
+  }
+
+  size_t index{};
+  while (index < zone_count_ && zones_[index].name != name) {
+    index++;
+  }
+  if (index == zone_count_ && zone_count_ < k_max_zones) {
+    zones_[zone_count_++] = {name, gpu};
+  }
+
+  // Past k_max_zones the zone is still opened so end_zone pairs up, and
+  // then ignored
+  open_zones_.emplace_back(index, std::chrono::steady_clock::now());
+  if (index < zone_count_ && zones_[index].gpu) {
+    ASSERT(!query_active_ && "GPU zones can't nest");
+    glBeginQuery(GL_TIME_ELAPSED, queries_[frame_ % k_query_frames][index]);
+    query_active_ = true;
+  }
+}
+
+void Profiler::end_zone() {
+  if (!enabled_) {
+    return;
+  }
+
+  const OpenZone open{open_zones_.back()};
+  open_zones_.pop_back();
+  if (open.index >= zone_count_) {
+    return;
+  }
+
+  Zone& zone{zones_[open.index]};
+  zone.cpu_ms = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - open.start)
+                    .count();
+  if (zone.gpu) {
+    glEndQuery(GL_TIME_ELAPSED);
+    queries_issued_[frame_ % k_query_frames][open.index] = true;
+    query_active_ = false;
+  }
+}
@@ -2,13 +2,161 @@
 
 #include <GLFW/glfw3.h>
 #include <cgltf.h>
-#include <stb_image.h>
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 
-Renderer::Renderer(GLFWwindow* window) : window_{window} {}
+#include "image.hpp"
+#include "mesh_cache.hpp"
+
+namespace {
+
+// Mirrors the std140 layout of the Camera block in the shaders
+struct CameraBlock {
+  glm::mat4 projection;
+  glm::mat4 view;
+  glm::vec4 position;
+};
+
+// Reads the single primitive of a model into the vectors and points the
+// source at them
+bool load_gltf(const fs::path& path, MeshSource& source,
+               std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+  const cgltf_options options{};
+  cgltf_data* data{};
+  cgltf_result result{cgltf_parse_file(&options, path.string().c_str(), &data)};
+  if (result != cgltf_result_success) {
+    LOGF_ERROR("GL", "Failed to load \"{}\"", path.string());
+    return false;
+  }
+
+  result = cgltf_load_buffers(&options, data, path.string().c_str());
+  if (result != cgltf_result_success) {
+    LOGF_ERROR("GL", "Failed to load buffers for \"{}\"", path.string());
+    cgltf_free(data);
+    return false;
+  }
+
+  result = cgltf_validate(data);
+  if (result != cgltf_result_success) {
+    LOGF_ERROR("GL", "Invalid gltf file \"{}\"", path.string());
+    cgltf_free(data);
+    return false;
+  }
+
+  ASSERT(data->scene->nodes_count == 1);
+  const cgltf_node* node = data->scene->nodes[0];
+
+  ASSERT(node->children_count == 0);
+  ASSERT(node->mesh->primitives_count == 1);
+  const cgltf_primitive* primitive = &node->mesh->primitives[0];
+
+  auto get_material_source = [](const cgltf_material* cgltf_material) {
+    return MeshSource::MaterialSource{
+        cgltf_material->name,
+        cgltf_material->pbr_metallic_roughness.base_color_texture.texture
+            ->image->uri};
+  };
+
+  if (primitive->material != nullptr) {
+    source.materials[0] = get_material_source(primitive->material);
+  }
+
+  ASSERT(primitive->mappings_count == 0 || primitive->mappings_count == 2);
+
+  if (primitive->mappings_count == 2) {
+    source.materials[1] = get_material_source(primitive->mappings[0].material);
+    source.materials[2] = get_material_source(primitive->mappings[1].material);
+  }
+
+  const cgltf_accessor* position{};
+  const cgltf_accessor* normal{};
+  const cgltf_accessor* tex_coord{};
+  for (size_t i = 0; i < primitive->attributes_count; i++) {
+    const cgltf_attribute* attribute = &primitive->attributes[i];
+    const cgltf_accessor* accessor = attribute->data;
+
+    switch (attribute->type) {
+      case cgltf_attribute_type_position:
+        position = accessor;
+        break;
+      case cgltf_attribute_type_normal:
+        normal = accessor;
+        break;
+      case cgltf_attribute_type_texcoord:
+        tex_coord = accessor;
+        break;
+      default:
+        ASSERT(false && "Unknown attribute type");
+        break;
+    }
+  }
+
+  vertices.resize(position->count);
+  for (size_t i = 0; i < position->count; i++) {
+    cgltf_accessor_read_float(position, i,
+                              glm::value_ptr(vertices[i].position), 3);
+    cgltf_accessor_read_float(normal, i, glm::value_ptr(vertices[i].normal), 3);
+    cgltf_accessor_read_float(tex_coord, i,
+                              glm::value_ptr(vertices[i].tex_coord), 2);
+  }
+
+  indices.resize(primitive->indices->count);
+  for (size_t i = 0; i < primitive->indices->count; i++) {
+    indices[i] =
+        static_cast<uint32_t>(cgltf_accessor_read_index(primitive->indices, i));
+  }
+
+  cgltf_free(data);
+
+  source.vertices = vertices;
+  source.indices = indices;
+  return true;
+}
+
+}  // namespace
+
+Renderer::Renderer(GLFWwindow* window) : window_{window} {
+  glGenBuffers(1, &camera_buffer_);
+  glBindBuffer(GL_UNIFORM_BUFFER, camera_buffer_);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), nullptr,
+               GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  glBindBufferBase(GL_UNIFORM_BUFFER, k_camera_binding, camera_buffer_);
+
+  glGenBuffers(static_cast<GLsizei>(pixel_buffers_.size()),
+               pixel_buffers_.data());
+  for (const GLuint buffer : pixel_buffers_) {
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, sizeof(GLint), nullptr, GL_STREAM_READ);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  GLint format_count{};
+  glGetIntegerv(GL_NUM_COMPRESSED_TEXTURE_FORMATS, &format_count);
+  compressed_formats_.resize(static_cast<size_t>(format_count));
+  glGetIntegerv(GL_COMPRESSED_TEXTURE_FORMATS, compressed_formats_.data());
+}
 
 Renderer::~Renderer() {
+  // Decodes still running may read the format list
+  pending_textures_.clear();
+  texture_pool_.reset();
+
+  for (GLsync& fence : pixel_fences_) {
+    if (fence != nullptr) {
+      glDeleteSync(fence);
+      fence = nullptr;
+    }
+  }
+  glDeleteBuffers(static_cast<GLsizei>(pixel_buffers_.size()),
+                  pixel_buffers_.data());
+
+  if (camera_buffer_ != 0) {
+    glDeleteBuffers(1, &camera_buffer_);
+  }
+
   for (size_t i = framebuffers_.size(); i-- > 0;) {
     destroy_framebuffer(&framebuffers_[i]);
   }
@@ -46,7 +194,7 @@ Shader* Renderer::create_shader(const fs::path& vert_path,
   auto read_file = [](const fs::path& path) -> std::string {
     std::ifstream file{path};
     if (!file) {
-      LOGF("GL", "Failed to open \"{}\"", path.string());
+      LOGF_ERROR("GL", "Failed to open \"{}\"", path.string());
       return {};
     }
 
@@ -57,7 +205,7 @@ Shader* Renderer::create_shader(const fs::path& vert_path,
       return text;
     }
 
-    LOGF("GL", "Failed to read \"{}\"", path.string());
+    LOGF_ERROR("GL", "Failed to read \"{}\"", path.string());
     return {};
   };
 
@@ -82,7 +230,7 @@ Shader* Renderer::create_shader(const fs::path& vert_path,
     if (success == 0) {
       glGetShaderInfoLog(shader, static_cast<GLsizei>(buffer.size()), nullptr,
                          buffer.data());
-      LOG("GL", buffer);
+      LOG_ERROR("GL", buffer);
     }
 
     return shader;
@@ -110,14 +258,51 @@ Shader* Renderer::create_shader(const fs::path& vert_path,
   if (success == 0) {
     glGetProgramInfoLog(program, static_cast<GLsizei>(buffer.size()), nullptr,
                         buffer.data());
-    LOG("GL", buffer);
+    LOG_ERROR("GL", buffer);
     return nullptr;
   }
 
-  Shader* shader = &shaders_.emplace_back(vert_path, frag_path, program);
+  if (const GLuint block{glGetUniformBlockIndex(program, "Camera")};
+      block != GL_INVALID_INDEX) {
+    glUniformBlockBinding(program, block, k_camera_binding);
+  }
 
-  LOGF("GL", "Shader created (vertex: \"{}\") (fragment: \"{}\") (id: {})",
-       vert_path.string(), frag_path.string(), program);
+  UniformLocations uniform_locations;
+
+  GLint uniform_count{};
+  glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniform_count);
+  for (GLuint i = 0; i < static_cast<GLuint>(uniform_count); i++) {
+    GLsizei length{};
+    GLint size{};
+    GLenum type{};
+    glGetActiveUniform(program, i, static_cast<GLsizei>(buffer.size()), &length,
+                       &size, &type, buffer.data());
+
+    // Arrays are reported as name[0], block members have no location
+    std::string name{buffer.data(), static_cast<size_t>(length)};
+    if (name.ends_with("[0]")) {
+      name.resize(name.size() - 3);
+    }
+    if (const GLint location{glGetUniformLocation(program, buffer.data())};
+        location != -1) {
+      uniform_locations.emplace(std::move(name), location);
+    }
+  }
+
+  // Textures always come from unit 0, which never changes after linking
+  if (const auto it{uniform_locations.find("base_tex")};
+      it != uniform_locations.end()) {
+    glUseProgram(program);
+    glUniform1i(it->second, 0);
+    glUseProgram(bound_shader_ != nullptr ? bound_shader_->id : 0);
+  }
+
+  Shader* shader = &shaders_.emplace_back(vert_path, frag_path, program,
+                                          std::move(uniform_locations));
+
+  LOGF_DEBUG("GL",
+             "Shader created (vertex: \"{}\") (fragment: \"{}\") (id: {})",
+             vert_path.string(), frag_path.string(), program);
 
   return shader;
 }
@@ -126,8 +311,10 @@ void Renderer::destroy_shader(Shader* shader) {
   if (shader->id != 0) {
     glDeleteProgram(shader->id);
   }
-  LOGF("GL", "Shader destroyed (vertex: \"{}\") (fragment: \"{}\") (id: {})",
-       shader->vert_path.string(), shader->frag_path.string(), shader->id);
+  LOGF_DEBUG("GL",
+             "Shader destroyed (vertex: \"{}\") (fragment: \"{}\") (id: {})",
+             shader->vert_path.string(), shader->frag_path.string(),
+             shader->id);
   *shader = {};
 }
 
@@ -147,65 +334,102 @@ Texture* Renderer::create_texture(const fs::path& path) {
     return &(*it);
   }
 
-  int width{};
-  int height{};
-  int components{};
-
-  unsigned char* data =
-      stbi_load(path.string().c_str(), &width, &height, &components, 0);
-  if (data == nullptr) {
-    LOGF("GL", "Failed to load \"{}\"", path.string());
+  std::error_code error;
+  if (!fs::exists(path, error)) {
+    LOGF_ERROR("GL", "Failed to load \"{}\"", path.string());
     return nullptr;
   }
 
+  if (!texture_pool_) {
+    texture_pool_ = std::make_unique<ThreadPool>();
+  }
+
+  // A KTX file next to the image wins if the driver takes its format
+  std::future<Image> image{texture_pool_->submit([this, path] {
+    const fs::path ktx_path{fs::path{path}.replace_extension(".ktx")};
+    std::error_code ktx_error;
+    if (fs::exists(ktx_path, ktx_error)) {
+      Image ktx{load_ktx(ktx_path)};
+      if (!ktx.levels.empty() &&
+          (!ktx.is_compressed() ||
+           std::find(compressed_formats_.begin(), compressed_formats_.end(),
+                     static_cast<GLint>(ktx.internal_format)) !=
+               compressed_formats_.end())) {
+        return ktx;
+      }
+      LOGF("GL", "Falling back to \"{}\"", path.string());
+    }
+    return load_image(path);
+  })};
+
   GLuint id{};
   glGenTextures(1, &id);
-  glBindTexture(GL_TEXTURE_2D, id);
-
-  GLint format{};
-  switch (components) {
-    case 1:
-      format = GL_RED;
-      break;
-    case 2:
-      format = GL_RG;
-      break;
-    case 3:
-      format = GL_RGB;
-      break;
-    case 4:
-      format = GL_RGBA;
-      break;
-    default:
-      ASSERT(false && "Unknown format");
-      break;
-  }
-
-  glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format,
-               GL_UNSIGNED_BYTE, data);
-  glGenerateMipmap(GL_TEXTURE_2D);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
-                  GL_LINEAR_MIPMAP_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-  glBindTexture(GL_TEXTURE_2D, 0);
-
-  stbi_image_free(data);
 
   Texture* texture = &textures_.emplace_back(path, id);
+  pending_textures_.push_back({texture, std::move(image)});
 
-  LOGF("GL", "Texture created (file: \"{}\") (id: {})", path.string(), id);
+  LOGF_DEBUG("GL", "Texture created (file: \"{}\") (id: {})", path.string(),
+             id);
 
   return texture;
 }
 
+bool Renderer::upload_textures() {
+  bool uploaded{true};
+  for (PendingTexture& pending : pending_textures_) {
+    const Image image{pending.image.get()};
+    if (image.levels.empty()) {
+      uploaded = false;
+      continue;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, pending.texture->id);
+
+    // Rows of decoded images are tightly packed
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (size_t level = 0; level < image.levels.size(); level++) {
+      const Image::Level& data{image.levels[level]};
+      if (image.is_compressed()) {
+        glCompressedTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level),
+                               image.internal_format, data.width, data.height,
+                               0, static_cast<GLsizei>(data.data.size()),
+                               data.data.data());
+      } else {
+        glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level),
+                     static_cast<GLint>(image.internal_format), data.width,
+                     data.height, 0, image.format, image.type,
+                     data.data.data());
+      }
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    // Compressed mip chains come prebuilt, and only from the file
+    if (image.levels.size() == 1 && !image.is_compressed()) {
+      glGenerateMipmap(GL_TEXTURE_2D);
+    } else {
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                      static_cast<GLint>(image.levels.size() - 1));
+    }
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                    GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  pending_textures_.clear();
+  texture_pool_.reset();
+  return uploaded;
+}
+
 void Renderer::destroy_texture(Texture* texture) {
   if (texture->id != 0) {
     glDeleteTextures(1, &texture->id);
   }
-  LOGF("GL", "Texture destroyed (file: \"{}\") (id: {})",
-       texture->path.string(), texture->id);
+  LOGF_DEBUG("GL", "Texture destroyed (file: \"{}\") (id: {})",
+             texture->path.string(), texture->id);
   *texture = {};
 }
 
@@ -217,114 +441,47 @@ Model* Renderer::create_model(const fs::path& path) {
     return &(*it);
   }
 
-  const cgltf_options options{};
-  cgltf_data* data{};
-  cgltf_result result{cgltf_parse_file(&options, path.string().c_str(), &data)};
-  if (result != cgltf_result_success) {
-    LOGF("GL", "Failed to load \"{}\"", path.string());
-    return nullptr;
-  }
-
-  result = cgltf_load_buffers(&options, data, path.string().c_str());
-  if (result != cgltf_result_success) {
-    LOGF("GL", "Failed to load buffers for \"{}\"", path.string());
-    cgltf_free(data);
-    return nullptr;
-  }
-
-  result = cgltf_validate(data);
-  if (result != cgltf_result_success) {
-    LOGF("GL", "Invalid gltf file \"{}\"", path.string());
-    cgltf_free(data);
-    return nullptr;
-  }
-
+  // The glTF file is only parsed when the cache is missing or stale, the
+  // vectors then hold what the source points at
+  MeshCache cache{path};
+  MeshSource source;
   std::vector<Vertex> vertices;
-  std::vector<unsigned int> indices;
-
-  ASSERT(data->scene->nodes_count == 1);
-  const cgltf_node* node = data->scene->nodes[0];
-
-  ASSERT(node->children_count == 0);
-  ASSERT(node->mesh->primitives_count == 1);
-  const cgltf_primitive* primitive = &node->mesh->primitives[0];
-
-  auto create_material = [this](const fs::path& parent,
-                                cgltf_material* cgltf_material) {
-    if (auto it = std::find_if(materials_.begin(), materials_.end(),
-                               [&](const Material& material) {
-                                 return material.name == cgltf_material->name;
-                               });
-        it != materials_.end()) {
-      return &(*it);
+  std::vector<uint32_t> indices;
+  if (!cache.load(source)) {
+    if (!load_gltf(path, source, vertices, indices)) {
+      return nullptr;
     }
-
-    fs::path path{parent};
-    path += '/';
-    path += cgltf_material->pbr_metallic_roughness.base_color_texture.texture
-                ->image->uri;
-
-    Material* material =
-        &materials_.emplace_back(cgltf_material->name, create_texture(path));
-
-    return material;
-  };
-
-  Material* material{};
-
-  if (primitive->material != nullptr) {
-    material = create_material(path.parent_path(), primitive->material);
+    cache.store(source);
   }
 
-  ASSERT(primitive->mappings_count == 0 || primitive->mappings_count == 2);
-
-  Material* white{};
-  Material* black{};
-  if (primitive->mappings_count == 2) {
-    white =
-        create_material(path.parent_path(), primitive->mappings[0].material);
-    black =
-        create_material(path.parent_path(), primitive->mappings[1].material);
-  }
-
-  const cgltf_accessor* position{};
-  const cgltf_accessor* normal{};
-  const cgltf_accessor* tex_coord{};
-  for (size_t i = 0; i < primitive->attributes_count; i++) {
-    const cgltf_attribute* attribute = &primitive->attributes[i];
-    const cgltf_accessor* accessor = attribute->data;
-
-    switch (attribute->type) {
-      case cgltf_attribute_type_position:
-        position = accessor;
-        break;
-      case cgltf_attribute_type_normal:
-        normal = accessor;
-        break;
-      case cgltf_attribute_type_texcoord:
-        tex_coord = accessor;
-        break;
-      default:
-        ASSERT(false && "Unknown attribute type");
-        break;
-    }
-  }
-
-  size_t vertex_count{vertices.size()};
-  vertices.resize(vertex_count + position->count);
-  for (size_t i = 0; i < position->count; i++, vertex_count++) {
-    cgltf_accessor_read_float(
-        position, i, glm::value_ptr(vertices[vertex_count].position), 3);
-    cgltf_accessor_read_float(normal, i,
-                              glm::value_ptr(vertices[vertex_count].normal), 3);
-    cgltf_accessor_read_float(
-        tex_coord, i, glm::value_ptr(vertices[vertex_count].tex_coord), 2);
-  }
-
-  indices.resize(primitive->indices->count);
-  for (size_t i = 0; i < primitive->indices->count; i++) {
-    indices[i] = cgltf_accessor_read_index(primitive->indices, i);
-  }
+  auto create_material =
+      [this, &path](const MeshSource::MaterialSource& material_source) {
+        Material* material{};
+        if (material_source.name.empty()) {
+          return material;
+        }
+
+        if (auto it = std::find_if(materials_.begin(), materials_.end(),
+                                   [&](const Material& candidate) {
+                                     return candidate.name ==
+                                            material_source.name;
+                                   });
+            it != materials_.end()) {
+          return &(*it);
+        }
+
+        fs::path texture_path{path.parent_path()};
+        texture_path += '/';
+        texture_path += material_source.base_color_uri;
+
+        material = &materials_.emplace_back(material_source.name,
+                                            create_texture(texture_path));
+        return material;
+      };
+
+  Material* material{create_material(source.materials[0])};
+  Material* white{create_material(source.materials[1])};
+  Material* black{create_material(source.materials[2])};
 
   GLuint vao{};
   GLuint vbo{};
@@ -337,13 +494,13 @@ Model* Renderer::create_model(const fs::path& path) {
   glBindVertexArray(vao);
   glBindBuffer(GL_ARRAY_BUFFER, vbo);
   glBufferData(GL_ARRAY_BUFFER,
-               static_cast<GLsizeiptr>(vertices.size() * sizeof(Vertex)),
-               vertices.data(), GL_STATIC_DRAW);
+               static_cast<GLsizeiptr>(source.vertices.size_bytes()),
+               source.vertices.data(), GL_STATIC_DRAW);
 
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-               static_cast<GLsizeiptr>(indices.size() * sizeof(unsigned int)),
-               indices.data(), GL_STATIC_DRAW);
+               static_cast<GLsizeiptr>(source.indices.size_bytes()),
+               source.indices.data(), GL_STATIC_DRAW);
 
   glEnableVertexAttribArray(0);
   glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex),
@@ -355,13 +512,36 @@ Model* Renderer::create_model(const fs::path& path) {
   glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
                         reinterpret_cast<void*>(offsetof(Vertex, tex_coord)));
 
+  // Instance attributes advance once per instance, the matrix takes four
+  // locations, one per column
+  GLuint instance_vbo{};
+  glGenBuffers(1, &instance_vbo);
+  glBindBuffer(GL_ARRAY_BUFFER, instance_vbo);
+  glBufferData(GL_ARRAY_BUFFER,
+               static_cast<GLsizeiptr>(k_initial_instances * sizeof(Instance)),
+               nullptr, GL_STREAM_DRAW);
+
+  for (GLuint column = 0; column < 4; column++) {
+    glEnableVertexAttribArray(3 + column);
+    glVertexAttribPointer(
+        3 + column, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+        reinterpret_cast<void*>(offsetof(Instance, model) +
+                                column * sizeof(glm::vec4)));
+    glVertexAttribDivisor(3 + column, 1);
+  }
+  glEnableVertexAttribArray(7);
+  glVertexAttribIPointer(7, 1, GL_INT, sizeof(Instance),
+                         reinterpret_cast<void*>(offsetof(Instance, id)));
+  glVertexAttribDivisor(7, 1);
+
   glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
 
   Model* model = &models_.emplace_back(
-      path, Mesh{vao, vbo, ebo, static_cast<GLsizei>(indices.size()), material,
-                 white, black});
+      path, Mesh{vao, vbo, ebo, static_cast<GLsizei>(source.indices.size()),
+                 instance_vbo, k_initial_instances, material, white, black});
 
-  LOGF("GL", "Model created (file: \"{}\")", path.string());
+  LOGF_DEBUG("GL", "Model created (file: \"{}\")", path.string());
 
   return model;
 }
@@ -376,13 +556,26 @@ void Renderer::destroy_model(Model* model) {
   if (model->mesh.ebo != 0) {
     glDeleteBuffers(1, &model->mesh.ebo);
   }
-  LOGF("GL", "Model destroyed (file: \"{}\") (vao: {})", model->path.string(),
-       model->mesh.vao);
+  if (model->mesh.instance_vbo != 0) {
+    glDeleteBuffers(1, &model->mesh.instance_vbo);
+  }
+  LOGF_DEBUG("GL", "Model destroyed (file: \"{}\") (vao: {})",
+             model->path.string(), model->mesh.vao);
   *model = {};
 }
 
 void Renderer::draw_model(const Transform& transform, Model* model,
-                          Material* material) {
+                          Material* material, int id) {
+  const Instance instance{calculate_model_matrix(transform), id};
+  draw_model_instances(model, material, {&instance, 1});
+}
+
+void Renderer::draw_model_instances(Model* model, Material* material,
+                                    std::span<const Instance> instances) {
+  if (instances.empty()) {
+    return;
+  }
+
   if (material != nullptr && bound_material_ != material) {
     glActiveTexture(GL_TEXTURE0);
     glBindTexture(GL_TEXTURE_2D, material->base_color->id);
@@ -390,32 +583,24 @@ void Renderer::draw_model(const Transform& transform, Model* model,
 
   bound_material_ = material;
 
-  int width{};
-  int height{};
-  glfwGetWindowSize(window_, &width, &height);
+  Mesh& mesh{model->mesh};
+  const auto size{static_cast<GLsizeiptr>(instances.size_bytes())};
+  glBindBuffer(GL_ARRAY_BUFFER, mesh.instance_vbo);
+  if (instances.size() > mesh.instance_capacity) {
+    mesh.instance_capacity = instances.size();
+    glBufferData(GL_ARRAY_BUFFER, size, instances.data(), GL_STREAM_DRAW);
+  } else {
+    glBufferSubData(GL_ARRAY_BUFFER, 0, size, instances.data());
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-  const float aspect_ratio{static_cast<float>(width) /
-                           static_cast<float>(height)};
-  set_shader_uniform(
-      bound_shader_, "projection",
-      glm::perspective(glm::radians(60.0F), aspect_ratio, 0.1F, 125.0F));
-  set_shader_uniform(bound_shader_, "view", camera_->calculate_view_matrix());
-  set_shader_uniform(
-      bound_shader_, "model",
-      glm::scale(
-          glm::rotate(
-              glm::translate(glm::identity<glm::mat4>(), transform.position),
-              glm::radians(transform.rotation), {0.0F, 1.0F, 0.0F}),
-          glm::vec3{transform.scale}));
-
-  if (bound_material_ != nullptr) {
-    set_shader_uniform(bound_shader_, "base_tex", 0);
-  }
-
-  glBindVertexArray(model->mesh.vao);
-  glDrawElements(GL_TRIANGLES, model->mesh.index_count, GL_UNSIGNED_INT,
-                 nullptr);
+  glBindVertexArray(mesh.vao);
+  glDrawElementsInstanced(GL_TRIANGLES, mesh.index_count, GL_UNSIGNED_INT,
+                          nullptr, static_cast<GLsizei>(instances.size()));
   glBindVertexArray(0);
+
+  stats_.draw_calls++;
+  stats_.instances += static_cast<int>(instances.size());
 }
 
 void Renderer::draw_model_outline(const Transform& transform, Model* model,
@@ -466,8 +651,8 @@ Framebuffer* Renderer::create_framebuffer(const glm::ivec2& size) {
 
   auto* framebuffer = &framebuffers_.emplace_back(static_cast<Framebuffer>(id));
 
-  LOGF("GL", "Framebuffer created (id: {}) (color: {}) (depth: {})", id, color,
-       depth);
+  LOGF_DEBUG("GL", "Framebuffer created (id: {}) (color: {}) (depth: {})", id,
+             color, depth);
 
   return framebuffer;
 }
@@ -497,8 +682,8 @@ void Renderer::destroy_framebuffer(Framebuffer* framebuffer) {
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
     glDeleteFramebuffers(1, &id);
 
-    LOGF("GL", "Framebuffer destroyed (id: {}) (color: {}) (depth: {})", id,
-         u_color, u_depth);
+    LOGF_DEBUG("GL", "Framebuffer destroyed (id: {}) (color: {}) (depth: {})",
+               id, u_color, u_depth);
     *framebuffer = {};
   }
 }
@@ -523,18 +708,83 @@ void Renderer::clear_framebuffer() {
   glClearBufferfv(GL_DEPTH, 0, &clear_depth);
 }
 
-int Renderer::read_pixel(const glm::ivec2& coord) {
-  int data{};
+bool Renderer::request_pixel(const glm::ivec2& coord) {
+  if (pixel_pending_ == pixel_buffers_.size()) {
+    return false;
+  }
+
+  const size_t slot{(pixel_head_ + pixel_pending_) % pixel_buffers_.size()};
+
+  // With a pack buffer bound the read only records a copy on the GPU
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, pixel_buffers_[slot]);
   glReadBuffer(GL_COLOR_ATTACHMENT0);
-  glReadPixels(coord.x, coord.y, 1, 1, GL_RED_INTEGER, GL_INT, &data);
+  glReadPixels(coord.x, coord.y, 1, 1, GL_RED_INTEGER, GL_INT, nullptr);
   glReadBuffer(GL_NONE);
-  return data;
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  pixel_fences_[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  // Reads also happen without a frame, which would have flushed them
+  glFlush();
+  pixel_pending_++;
+  return true;
+}
+
+bool Renderer::poll_pixel(int& value) {
+  if (pixel_pending_ == 0) {
+    return false;
+  }
+
+  GLsync& fence{pixel_fences_[pixel_head_]};
+  const GLenum status{glClientWaitSync(fence, 0, 0)};
+  if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+    return false;
+  }
+  glDeleteSync(fence);
+  fence = nullptr;
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, pixel_buffers_[pixel_head_]);
+  const void* data{glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, sizeof(GLint),
+                                    GL_MAP_READ_BIT)};
+  const bool mapped{data != nullptr};
+  if (mapped) {
+    std::memcpy(&value, data, sizeof(GLint));
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  pixel_head_ = (pixel_head_ + 1) % pixel_buffers_.size();
+  pixel_pending_--;
+  return mapped;
+}
+
+glm::mat4 Renderer::calculate_model_matrix(const Transform& transform) {
+  return glm::scale(
+      glm::rotate(
+          glm::translate(glm::identity<glm::mat4>(), transform.position),
+          glm::radians(transform.rotation), {0.0F, 1.0F, 0.0F}),
+      glm::vec3{transform.scale});
 }
 
 void Renderer::begin_drawing(Camera& camera) {
   glClearColor(0.25F, 0.25F, 0.25F, 1.0F);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
   camera_ = &camera;
+  stats_ = {};
+
+  int width{};
+  int height{};
+  glfwGetWindowSize(window_, &width, &height);
+
+  const float aspect_ratio{static_cast<float>(width) /
+                           static_cast<float>(std::max(height, 1))};
+  const CameraBlock block{
+      glm::perspective(glm::radians(60.0F), aspect_ratio, 0.1F, 125.0F),
+      camera.calculate_view_matrix(), glm::vec4{camera.get_position(), 1.0F}};
+
+  glBindBuffer(GL_UNIFORM_BUFFER, camera_buffer_);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraBlock), &block);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  stats_.uniform_uploads++;
 }
 
 void Renderer::end_drawing() {
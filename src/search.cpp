@@ -0,0 +1,443 @@
+#include "search.hpp"
+
+#include <algorithm>
+#include <atomic>
+
+#include "evaluation.hpp"
+#include "move_picker.hpp"
+#include "nnue.hpp"
+#include "tablebase.hpp"
+
+namespace {
+
+// Mate scores are stored relative to the node so they stay valid wherever the
+// position shows up in the tree
+int to_table_score(int score, int ply) {
+  if (score >= k_mate_bound) {
+    return score + ply;
+  }
+  if (score <= -k_mate_bound) {
+    return score - ply;
+  }
+  return score;
+}
+
+int from_table_score(int score, int ply) {
+  if (score >= k_mate_bound) {
+    return score - ply;
+  }
+  if (score <= -k_mate_bound) {
+    return score + ply;
+  }
+  return score;
+}
+
+// Tablebase wins rank below every mate found by the search, and closer ones
+// above farther ones. Wins and losses lost to the fifty-move rule are draws.
+int to_tablebase_score(Wdl wdl, int ply) {
+  switch (wdl) {
+    case Wdl::Win:
+      return k_mate_bound - 1 - ply;
+    case Wdl::Loss:
+      return -k_mate_bound + 1 + ply;
+    default:
+      return 0;
+  }
+}
+
+// Search state of one thread
+class SearchWorker {
+ public:
+  struct Line {
+    int size{};
+    std::array<Board::Move, k_max_ply> moves;
+  };
+
+  SearchWorker(const Board& board, const Board::Moves& root_moves,
+               const SearchLimits& limits, TranspositionTable& table,
+               const Tablebases* tablebases, const Network* network,
+               std::stop_token stop_token,
+               std::chrono::steady_clock::time_point start)
+      : board_{board},
+        root_moves_{root_moves},
+        limits_{limits},
+        table_{table},
+        tablebases_{tablebases},
+        stop_token_{std::move(stop_token)},
+        start_{start} {
+    if (network != nullptr) {
+      // One per ply, and the root
+      accumulators_ = std::make_unique<Accumulators>(*network, k_max_ply + 1);
+      accumulators_->reset(board_);
+    }
+  }
+
+  // Score of the position searched to depth, only valid if not stopped
+  int search_root(int depth, Line& pv) {
+    return negamax(depth, -k_infinity, k_infinity, 0, pv);
+  }
+
+  [[nodiscard]] bool is_stopped() const { return stopped_; }
+
+  [[nodiscard]] uint64_t get_nodes() const {
+    return nodes_.load(std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] std::chrono::microseconds get_elapsed() const {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start_);
+  }
+
+ private:
+  int negamax(int depth, int alpha, int beta, int ply, Line& pv);
+  int quiescence(int alpha, int beta, int ply);
+
+  // Rewards a quiet move that caused a beta cutoff
+  void update_quiet_stats(Board::Move move, int depth, int ply);
+
+  void count_node();
+
+  // Keep the accumulators in step with the board
+  void make_move(Board::Move move);
+  void undo_move();
+
+  [[nodiscard]] int evaluate_position() const;
+
+  Board board_;
+  // The only moves tried at the root
+  Board::Moves root_moves_;
+  SearchLimits limits_;
+  TranspositionTable& table_;
+  const Tablebases* tablebases_;
+  std::stop_token stop_token_;
+  std::chrono::steady_clock::time_point start_;
+
+  std::array<Killers, k_max_ply> killers_{};
+  HistoryTable history_{};
+
+  // Only with a network, the piece-square tables evaluate otherwise
+  std::unique_ptr<Accumulators> accumulators_;
+
+  // Only written by the owning thread, atomic so totals can be read while
+  // searching
+  std::atomic<uint64_t> nodes_{};
+  bool stopped_{};
+};
+
+int SearchWorker::negamax(int depth, int alpha, int beta, int ply, Line& pv) {
+  pv.size = 0;
+
+  const bool in_check{board_.is_in_check()};
+  if (in_check) {
+    depth++;
+  }
+
+  if (depth <= 0) {
+    return quiescence(alpha, beta, ply);
+  }
+
+  count_node();
+
+  if (ply > 0 && board_.is_draw()) {
+    return 0;
+  }
+
+  // Also where the game history has no room for another move
+  if (ply >= k_max_ply - 1 || board_.get_records().full()) {
+    return evaluate_position();
+  }
+
+  const uint64_t hash{board_.get_hash()};
+
+  // The root always searches so it has a move and a principal variation
+  TranspositionEntry entry;
+  const bool found{table_.probe(hash, entry)};
+  if (found && ply > 0 && entry.depth >= depth) {
+    const int score{from_table_score(entry.score, ply)};
+    if (entry.bound == Bound::Exact ||
+        (entry.bound == Bound::Lower && score >= beta) ||
+        (entry.bound == Bound::Upper && score <= alpha)) {
+      return std::clamp(score, alpha, beta);
+    }
+  }
+
+  // Only right after a capture or pawn move, where the material just changed
+  // and the fifty-move count of the table matches the board
+  if (tablebases_ != nullptr && ply > 0 && board_.get_halfmove_clock() == 0 &&
+      board_.get_piece_count() <= tablebases_->get_max_pieces()) {
+    if (const std::optional<Wdl> wdl{tablebases_->probe_wdl(board_)}) {
+      const int score{to_tablebase_score(*wdl, ply)};
+      table_.store(hash, {{}, to_table_score(score, ply), depth, Bound::Exact});
+      return std::clamp(score, alpha, beta);
+    }
+  }
+
+  MovePicker picker{board_, found ? entry.move : Board::Move{}, killers_[ply],
+                    history_};
+
+  const int original_alpha{alpha};
+  Board::Move best_move;
+  int move_count{};
+
+  Line line;
+  for (Board::Move move{picker.next()}; move.tile != -1;
+       move = picker.next()) {
+    if (ply == 0 &&
+        std::find(root_moves_.data.begin(),
+                  root_moves_.data.begin() + root_moves_.size,
+                  move) == root_moves_.data.begin() + root_moves_.size) {
+      continue;
+    }
+    move_count++;
+
+    make_move(move);
+    const int score{-negamax(depth - 1, -beta, -alpha, ply + 1, line)};
+    undo_move();
+
+    if (is_stopped()) {
+      return 0;
+    }
+
+    if (score > alpha) {
+      alpha = score;
+      best_move = move;
+
+      pv.moves[0] = move;
+      std::copy_n(line.moves.begin(), line.size, pv.moves.begin() + 1);
+      pv.size = line.size + 1;
+
+      if (alpha >= beta) {
+        if (board_.is_quiet(move)) {
+          update_quiet_stats(move, depth, ply);
+        }
+        break;
+      }
+    }
+  }
+
+  if (move_count == 0) {
+    return in_check ? -k_mate_score + ply : 0;
+  }
+
+  Bound bound{Bound::Upper};
+  if (alpha >= beta) {
+    bound = Bound::Lower;
+  } else if (alpha > original_alpha) {
+    bound = Bound::Exact;
+  }
+  table_.store(hash, {best_move, to_table_score(alpha, ply), depth, bound});
+
+  return alpha;
+}
+
+int SearchWorker::quiescence(int alpha, int beta, int ply) {
+  count_node();
+
+  const bool in_check{board_.is_in_check()};
+  if (ply >= k_max_ply - 1 || board_.get_records().full()) {
+    return in_check ? 0 : evaluate_position();
+  }
+
+  // In check every evasion has to be searched, standing pat could hide a mate
+  if (!in_check) {
+    const int stand_pat{evaluate_position()};
+    if (stand_pat >= beta) {
+      return beta;
+    }
+    alpha = std::max(alpha, stand_pat);
+  }
+
+  MovePicker picker{board_, {}, {}, history_, !in_check};
+
+  int move_count{};
+  for (Board::Move move{picker.next()}; move.tile != -1;
+       move = picker.next()) {
+    move_count++;
+
+    make_move(move);
+    const int score{-quiescence(-beta, -alpha, ply + 1)};
+    undo_move();
+
+    if (is_stopped()) {
+      return 0;
+    }
+
+    if (score > alpha) {
+      alpha = score;
+      if (alpha >= beta) {
+        break;
+      }
+    }
+  }
+
+  if (in_check && move_count == 0) {
+    return -k_mate_score + ply;
+  }
+
+  return alpha;
+}
+
+void SearchWorker::update_quiet_stats(Board::Move move, int depth, int ply) {
+  Killers& killers{killers_[ply]};
+  if (killers[0] != move) {
+    killers[1] = killers[0];
+    killers[0] = move;
+  }
+
+  // Deep cutoffs count more, and scores saturate towards k_max_history
+  int& history{history_[get_color_index(board_.get_turn())][move.tile]
+                       [move.target]};
+  const int bonus{std::min(depth * depth, k_max_history)};
+  history += bonus - history * bonus / k_max_history;
+}
+
+void SearchWorker::count_node() {
+  const uint64_t nodes{nodes_.load(std::memory_order_relaxed) + 1};
+  nodes_.store(nodes, std::memory_order_relaxed);
+
+  if (limits_.nodes != 0 && nodes >= limits_.nodes) {
+    stopped_ = true;
+  }
+
+  // The clock and the stop request are only polled every few thousand nodes
+  if ((nodes & 2047U) == 0 &&
+      (stop_token_.stop_requested() ||
+       (limits_.movetime.count() != 0 && get_elapsed() >= limits_.movetime))) {
+    stopped_ = true;
+  }
+}
+
+void SearchWorker::make_move(Board::Move move) {
+  board_.move(move);
+  if (accumulators_) {
+    accumulators_->push(board_);
+  }
+}
+
+void SearchWorker::undo_move() {
+  board_.undo();
+  if (accumulators_) {
+    accumulators_->pop();
+  }
+}
+
+int SearchWorker::evaluate_position() const {
+  if (!accumulators_) {
+    return evaluate(board_);
+  }
+  // Never mistaken for a mate or a tablebase result
+  constexpr int k_max_score{k_mate_bound - k_max_ply - 1};
+  return std::clamp(accumulators_->evaluate(board_.get_turn()), -k_max_score,
+                    k_max_score);
+}
+
+}  // namespace
+
+Search::Search(size_t hash_mb, int threads) : table_{hash_mb} {
+  set_threads(threads);
+}
+
+void Search::set_threads(int threads) {
+  threads_ = std::max(threads, 1);
+  helpers_.reset();
+  if (threads_ > 1) {
+    helpers_ = std::make_unique<ThreadPool>(threads_ - 1);
+  }
+}
+
+SearchResult Search::run(const Board& board, const SearchLimits& limits,
+                         const IterationCallback& on_iteration,
+                         std::stop_token stop_token) {
+  const auto start{std::chrono::steady_clock::now()};
+  table_.new_search();
+
+  // With a full history not even the root moves can be tried, the fallback
+  // move below is played
+  const int max_depth{board.get_records().full()
+                          ? 0
+                          : std::min(limits.depth, k_max_ply - 1)};
+
+  // Tablebases leave only the moves that keep the best result
+  Board::Moves moves;
+  board.generate_all(moves);
+  if (tablebases_ != nullptr &&
+      board.get_piece_count() <= tablebases_->get_max_pieces()) {
+    Board root{board};
+    tablebases_->filter_root_moves(root, moves);
+  }
+
+  // Helpers only stop when told to, or when they run out of depth
+  std::stop_source helpers_stop;
+  std::vector<std::unique_ptr<SearchWorker>> helpers;
+  std::vector<std::future<void>> helper_results;
+  for (int i = 1; i < threads_; i++) {
+    auto& helper{helpers.emplace_back(std::make_unique<SearchWorker>(
+        board, moves, SearchLimits{.depth = max_depth}, table_, tablebases_,
+        network_, helpers_stop.get_token(), start))};
+    helper_results.push_back(
+        helpers_->submit([worker = helper.get(), i, max_depth] {
+          SearchWorker::Line pv;
+          for (int depth = 1 + i % 2; depth <= max_depth; depth++) {
+            worker->search_root(depth, pv);
+            if (worker->is_stopped()) {
+              break;
+            }
+          }
+        }));
+  }
+
+  // Workers are large with their history tables, keep them off the stack
+  const auto main{std::make_unique<SearchWorker>(
+      board, moves, limits, table_, tablebases_, network_,
+      std::move(stop_token), start)};
+
+  SearchResult result;
+
+  auto update_stats = [&] {
+    const std::chrono::microseconds elapsed{main->get_elapsed()};
+    result.nodes = main->get_nodes();
+    for (const auto& helper : helpers) {
+      result.nodes += helper->get_nodes();
+    }
+    result.time = std::chrono::duration_cast<std::chrono::milliseconds>(elapsed);
+    result.nps = result.nodes * 1000000 /
+                 std::max<uint64_t>(static_cast<uint64_t>(elapsed.count()), 1);
+  };
+
+  // Played if not even the first iteration completes
+  if (moves.size != 0) {
+    result.best_move = moves.data[0];
+
+    for (int depth = 1; depth <= max_depth; depth++) {
+      SearchWorker::Line pv;
+      const int score{main->search_root(depth, pv)};
+      if (main->is_stopped()) {
+        break;
+      }
+
+      result.best_move = pv.moves[0];
+      result.score = score;
+      result.depth = depth;
+      result.pv.assign(pv.moves.begin(), pv.moves.begin() + pv.size);
+      update_stats();
+
+      if (on_iteration) {
+        on_iteration(result);
+      }
+
+      // The next iteration takes longer than all previous ones together
+      if (limits.movetime.count() != 0 &&
+          main->get_elapsed() * 2 > limits.movetime) {
+        break;
+      }
+    }
+  }
+
+  helpers_stop.request_stop();
+  for (auto& helper_result : helper_results) {
+    helper_result.wait();
+  }
+
+  update_stats();
+  return result;
+}
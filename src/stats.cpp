@@ -0,0 +1,85 @@
+#include "stats.hpp"
+
+#include <mutex>
+
+namespace {
+
+constexpr std::array<std::string_view, k_stat_counter_count> k_counter_names{
+    "move",
+    "undo",
+    "generate_legal_moves",
+    "generated_moves",
+    "evasions",
+    "double_checks",
+    "king_sources",
+    "queen_sources",
+    "bishop_sources",
+    "knight_sources",
+    "rook_sources",
+    "pawn_sources",
+    "pinned_sources",
+    "king_targets_tested",
+    "king_targets_rejected",
+    "enpassant_tested",
+    "enpassant_rejected",
+    "is_threatened",
+    "is_legal_move",
+    "illegal_moves",
+};
+
+struct Registry {
+  std::mutex mutex;
+  std::vector<ThreadStats*> threads;
+  // Left behind by threads that have exited
+  StatCounters finished{};
+};
+
+// Thread locals, even those of the main thread, are destroyed before it
+Registry& get_registry() {
+  static Registry registry;
+  return registry;
+}
+
+}  // namespace
+
+ThreadStats::ThreadStats() {
+  Registry& registry{get_registry()};
+  const std::lock_guard lock{registry.mutex};
+  registry.threads.push_back(this);
+}
+
+ThreadStats::~ThreadStats() {
+  Registry& registry{get_registry()};
+  const std::lock_guard lock{registry.mutex};
+  for (size_t i = 0; i < k_stat_counter_count; i++) {
+    registry.finished[i] += counters[i].load(std::memory_order_relaxed);
+  }
+  std::erase(registry.threads, this);
+}
+
+std::string_view get_stat_counter_name(StatCounter counter) {
+  return k_counter_names[to_underlying(counter)];
+}
+
+StatCounters get_stat_counters() {
+  Registry& registry{get_registry()};
+  const std::lock_guard lock{registry.mutex};
+  StatCounters totals{registry.finished};
+  for (const ThreadStats* stats : registry.threads) {
+    for (size_t i = 0; i < k_stat_counter_count; i++) {
+      totals[i] += stats->counters[i].load(std::memory_order_relaxed);
+    }
+  }
+  return totals;
+}
+
+void reset_stat_counters() {
+  Registry& registry{get_registry()};
+  const std::lock_guard lock{registry.mutex};
+  registry.finished.fill(0);
+  for (ThreadStats* stats : registry.threads) {
+    for (std::atomic<uint64_t>& counter : stats->counters) {
+      counter.store(0, std::memory_order_relaxed);
+    }
+  }
+}
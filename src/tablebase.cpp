@@ -0,0 +1,1429 @@
+#include "tablebase.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <mutex>
+
+#include "attacks.hpp"
+#include "mapped_file.hpp"
+
+namespace {
+
+constexpr std::array<uint8_t, 4> k_wdl_magic{0x71, 0xE8, 0x23, 0x5D};
+constexpr std::array<uint8_t, 4> k_dtz_magic{0xD7, 0x66, 0x0C, 0xA5};
+
+// Largest tables the format has
+constexpr int k_max_table_pieces{7};
+
+// Root move ranks go up to this, wins within the fifty-move rule rank above
+// half of it
+constexpr int k_max_dtz{1 << 18};
+
+#ifdef _WIN32
+constexpr char k_path_separator{';'};
+#else
+constexpr char k_path_separator{':'};
+#endif
+
+// Flags of a table file
+constexpr uint8_t k_table_split{1};
+constexpr uint8_t k_table_has_pawns{2};
+
+// Flags of a compressed table
+constexpr uint8_t k_pairs_black_to_move{1};
+constexpr uint8_t k_pairs_mapped{2};
+constexpr uint8_t k_pairs_win_plies{4};
+constexpr uint8_t k_pairs_loss_plies{8};
+constexpr uint8_t k_pairs_wide_map{16};
+constexpr uint8_t k_pairs_single_value{128};
+
+// The right half of a leaf in the symbol tree, its left half is the value
+constexpr uint16_t k_leaf_symbol{0xFFF};
+
+// Tables number pawns to kings 1 to 6, black adds 8. Indexed by PieceType.
+constexpr std::array<uint8_t, 7> k_piece_codes{0, 6, 5, 3, 2, 4, 1};
+constexpr uint8_t k_black_code{8};
+constexpr uint8_t k_pawn_code{1};
+
+uint8_t get_piece_code(Piece piece) {
+  return static_cast<uint8_t>(
+      k_piece_codes[to_underlying(get_piece_type(piece))] |
+      (get_piece_color(piece) == PieceColor::Black ? k_black_code : 0U));
+}
+
+// Rank minus file, zero on the a1-h8 diagonal and negative below it
+constexpr int get_diagonal_offset(int tile) { return (tile >> 3) - (tile & 7); }
+
+// The numbering of piece placements the generator uses
+struct IndexTables {
+  // binomial[k][n] ways to choose k of n tiles
+  std::array<std::array<uint64_t, 64>, 6> binomial{};
+  // Tiles below the a1-h8 diagonal, 0 to 27
+  std::array<int, 64> below_diagonal{};
+  // The a1-d1-d4 triangle, 0 to 9 with the tiles on the diagonal last
+  std::array<int, 64> triangle{};
+  // The 462 placements of two kings with the first one in the triangle
+  std::array<std::array<int, 64>, 10> kings{};
+  // Tiles a2 to h7 counting down from 47 towards the middle and up the
+  // board, the leading pawn is the one with the highest number
+  std::array<int, 64> pawns{};
+  // By count of leading pawns, where the placements with the leading one
+  // on a tile start and how many there are for each of the files a to d
+  std::array<std::array<uint64_t, 64>, 6> lead_pawns{};
+  std::array<std::array<uint64_t, 4>, 6> lead_pawns_size{};
+};
+
+constexpr IndexTables k_index{[] {
+  IndexTables tables;
+
+  tables.binomial[0][0] = 1;
+  for (size_t n = 1; n < 64; n++) {
+    for (size_t k = 0; k < 6; k++) {
+      tables.binomial[k][n] = (k > 0 ? tables.binomial[k - 1][n - 1] : 0) +
+                              tables.binomial[k][n - 1];
+    }
+  }
+
+  int code{};
+  for (int tile = 0; tile < 64; tile++) {
+    if (get_diagonal_offset(tile) < 0) {
+      tables.below_diagonal[static_cast<size_t>(tile)] = code++;
+    }
+  }
+
+  tables.triangle.fill(-1);
+  code = 0;
+  for (const bool on_diagonal : {false, true}) {
+    for (int tile = 0; tile < 64; tile++) {
+      if ((tile & 7) <= 3 && tile < 32 &&
+          (get_diagonal_offset(tile) == 0) == on_diagonal &&
+          get_diagonal_offset(tile) <= 0) {
+        tables.triangle[static_cast<size_t>(tile)] = code++;
+      }
+    }
+  }
+
+  // A first king on the diagonal keeps the other one on or below it, and
+  // placements with both on the diagonal come last
+  code = 0;
+  for (const bool on_diagonal : {false, true}) {
+    for (int first = 0; first < 10; first++) {
+      for (int king = 0; king < 32; king++) {
+        if (tables.triangle[static_cast<size_t>(king)] != first) {
+          continue;
+        }
+        const Bitboard near{k_king_attacks[static_cast<size_t>(king)] |
+                            tile_bitboard(king)};
+        for (int other = 0; other < 64; other++) {
+          if (has_tile(near, other) ||
+              (get_diagonal_offset(king) == 0 &&
+               get_diagonal_offset(other) > 0)) {
+            continue;
+          }
+          if ((get_diagonal_offset(king) == 0 &&
+               get_diagonal_offset(other) == 0) == on_diagonal) {
+            tables.kings[static_cast<size_t>(first)]
+                        [static_cast<size_t>(other)] = code++;
+          }
+        }
+      }
+    }
+  }
+
+  int available{47};
+  for (size_t count = 1; count <= 5; count++) {
+    for (size_t file = 0; file < 4; file++) {
+      uint64_t index{};
+      for (size_t rank = 1; rank <= 6; rank++) {
+        const size_t tile{rank * 8 + file};
+        if (count == 1) {
+          tables.pawns[tile] = available--;
+          tables.pawns[tile ^ 7] = available--;
+        }
+        tables.lead_pawns[count][tile] = index;
+        index += tables.binomial[count - 1]
+                                [static_cast<size_t>(tables.pawns[tile])];
+      }
+      tables.lead_pawns_size[count][file] = index;
+    }
+  }
+
+  return tables;
+}()};
+
+static_assert(k_index.kings[9][63] == 461);
+
+template <typename T>
+T read_little_endian(const uint8_t* data) {
+  T value{};
+  for (size_t i = sizeof(T); i-- > 0;) {
+    value = static_cast<T>(value << 8U | data[i]);
+  }
+  return value;
+}
+
+template <typename T>
+T read_big_endian(const uint8_t* data) {
+  T value{};
+  for (size_t i = 0; i < sizeof(T); i++) {
+    value = static_cast<T>(value << 8U | data[i]);
+  }
+  return value;
+}
+
+// Walks a table file in order, reading past its end gives zeros and leaves
+// the reader invalid
+class TableReader {
+ public:
+  explicit TableReader(std::string_view data)
+      : data_{reinterpret_cast<const uint8_t*>(data.data())},
+        size_{data.size()} {}
+
+  // Start of the next size bytes, null if the file is too short
+  const uint8_t* skip(size_t size) {
+    if (!is_valid() || size > size_ - position_) {
+      position_ = size_ + 1;
+      return nullptr;
+    }
+    const uint8_t* start{data_ + position_};
+    position_ += size;
+    return start;
+  }
+
+  template <typename T>
+  T read() {
+    const uint8_t* data{skip(sizeof(T))};
+    return data != nullptr ? read_little_endian<T>(data) : T{};
+  }
+
+  // Offsets are aligned from the start of the file
+  void align(size_t alignment) {
+    position_ = (position_ + alignment - 1) / alignment * alignment;
+  }
+
+  [[nodiscard]] size_t get_position() const { return position_; }
+  [[nodiscard]] bool is_valid() const { return position_ <= size_; }
+
+ private:
+  const uint8_t* data_;
+  size_t size_;
+  size_t position_{};
+};
+
+// What a table holds, read from its name
+struct Material {
+  int piece_count{};
+  bool has_pawns{};
+  // A piece other than a king that is alone of its kind
+  bool has_unique_pieces{};
+  // Of the leading color and of the other one
+  std::array<int, 2> pawn_counts{};
+};
+
+// Values of one side to move, and one file of the leading pawn in tables
+// with pawns. The values are runs of Huffman coded symbols which expand to
+// pairs of symbols, blocks of them are found through a sparse index.
+struct PairsData {
+  uint8_t flags{};
+  uint8_t single_value{};
+
+  size_t block_size{};
+  size_t block_count{};
+  // Values in each block, minus one
+  const uint8_t* block_lengths{};
+  size_t block_lengths_size{};
+  const uint8_t* blocks{};
+
+  // An entry for every span values, the block and offset of the middle one
+  const uint8_t* sparse_index{};
+  size_t sparse_index_size{};
+  size_t span{};
+
+  // Lowest symbol of each length, longer codes have lower values
+  const uint8_t* lowest_symbols{};
+  // And those codes left aligned in 64 bits
+  std::vector<uint64_t> bases;
+  int min_symbol_length{};
+
+  // Three bytes per symbol, the two 12 bit symbols it expands to
+  const uint8_t* symbol_tree{};
+  // Values a symbol expands to, minus one
+  std::vector<uint8_t> symbol_lengths;
+
+  // Order of the pieces in the index, alike pieces are grouped
+  std::array<uint8_t, k_max_table_pieces> pieces{};
+  // Zero after the last group
+  std::array<size_t, k_max_table_pieces + 1> group_lengths{};
+  // Factor of each group in the index, the last one is the table size
+  std::array<uint64_t, k_max_table_pieces + 1> group_factors{};
+
+  // Where the DTZ maps of a win, loss, cursed win and blessed loss start,
+  // and their lengths
+  std::array<uint16_t, 4> dtz_maps{};
+  std::array<uint16_t, 4> dtz_map_lengths{};
+};
+
+uint16_t get_lowest_symbol(const PairsData& pairs, size_t length) {
+  return read_little_endian<uint16_t>(pairs.lowest_symbols + 2 * length);
+}
+
+uint16_t get_left_symbol(const PairsData& pairs, uint16_t symbol) {
+  const uint8_t* node{pairs.symbol_tree + 3 * size_t{symbol}};
+  return static_cast<uint16_t>((node[1] & 0xFU) << 8U | node[0]);
+}
+
+uint16_t get_right_symbol(const PairsData& pairs, uint16_t symbol) {
+  const uint8_t* node{pairs.symbol_tree + 3 * size_t{symbol}};
+  return static_cast<uint16_t>(node[2] << 4U | node[1] >> 4U);
+}
+
+// Values of the table, the factor after the last group
+uint64_t get_table_size(const PairsData& pairs) {
+  const auto last_group{std::find(pairs.group_lengths.begin(),
+                                  pairs.group_lengths.end(), size_t{0}) -
+                        pairs.group_lengths.begin()};
+  return pairs.group_factors[static_cast<size_t>(last_group)];
+}
+
+int get_block_length(const PairsData& pairs, size_t block) {
+  return read_little_endian<uint16_t>(pairs.block_lengths + 2 * block);
+}
+
+Material get_material(uint64_t key) {
+  Material material;
+  std::array<int, 2> pawns{};
+  for (const PieceColor color : {PieceColor::White, PieceColor::Black}) {
+    for (int type = to_underlying(PieceType::King);
+         type <= to_underlying(PieceType::Pawn); type++) {
+      const int count{get_material_count(
+          key, make_piece(color, static_cast<PieceType>(type)))};
+      material.piece_count += count;
+      if (type != to_underlying(PieceType::King) && count == 1) {
+        material.has_unique_pieces = true;
+      }
+      if (type == to_underlying(PieceType::Pawn)) {
+        pawns[color == PieceColor::White ? 0 : 1] = count;
+      }
+    }
+  }
+
+  // The side with fewer pawns leads, which compresses better
+  material.has_pawns = pawns[0] + pawns[1] != 0;
+  const bool white_leads{pawns[1] == 0 ||
+                         (pawns[0] != 0 && pawns[1] >= pawns[0])};
+  material.pawn_counts = white_leads ? pawns : std::array{pawns[1], pawns[0]};
+  return material;
+}
+
+// The pieces of a file must be the material of its name, as the first side
+// is white
+bool has_material(const PairsData& pairs, uint64_t key,
+                  const Material& material) {
+  std::array<int, 16> counts{};
+  for (size_t i = 0; i < static_cast<size_t>(material.piece_count); i++) {
+    counts[pairs.pieces[i]]++;
+  }
+  for (const PieceColor color : {PieceColor::White, PieceColor::Black}) {
+    for (int type = to_underlying(PieceType::King);
+         type <= to_underlying(PieceType::Pawn); type++) {
+      const Piece piece{make_piece(color, static_cast<PieceType>(type))};
+      if (counts[get_piece_code(piece)] != get_material_count(key, piece)) {
+        return false;
+      }
+    }
+  }
+  return !material.has_pawns || (pairs.pieces[0] & 7U) == k_pawn_code;
+}
+
+// Splits the pieces into groups and gives each a factor in the index, in
+// the order the file stores
+void set_groups(PairsData& pairs, const Material& material,
+                std::array<size_t, 2> order, size_t file) {
+  // Leading pawns, or the first two or three pieces, are the first group
+  int first_length{material.has_pawns           ? 0
+                   : material.has_unique_pieces ? 3
+                                                : 2};
+  size_t groups{};
+  pairs.group_lengths[0] = 1;
+  for (size_t i = 1; i < static_cast<size_t>(material.piece_count); i++) {
+    if (--first_length > 0 || pairs.pieces[i] == pairs.pieces[i - 1]) {
+      pairs.group_lengths[groups]++;
+    } else {
+      pairs.group_lengths[++groups] = 1;
+    }
+  }
+  pairs.group_lengths[++groups] = 0;
+
+  // The pawns of the other color come second and keep off ranks 1 and 8
+  const bool has_other_pawns{material.pawn_counts[1] != 0};
+  size_t next{has_other_pawns ? 2U : 1U};
+  size_t free_tiles{64 - pairs.group_lengths[0] -
+                    (has_other_pawns ? pairs.group_lengths[1] : 0)};
+  uint64_t factor{1};
+  for (size_t k = 0; next < groups || k == order[0] || k == order[1]; k++) {
+    if (k == order[0]) {
+      pairs.group_factors[0] = factor;
+      factor *= material.has_pawns
+                    ? k_index.lead_pawns_size[pairs.group_lengths[0]][file]
+                : material.has_unique_pieces ? 31332
+                                             : 462;
+    } else if (k == order[1]) {
+      pairs.group_factors[1] = factor;
+      factor *= k_index.binomial[pairs.group_lengths[1]]
+                                [48 - pairs.group_lengths[0]];
+    } else {
+      pairs.group_factors[next] = factor;
+      factor *= k_index.binomial[pairs.group_lengths[next]][free_tiles];
+      free_tiles -= pairs.group_lengths[next++];
+    }
+  }
+  pairs.group_factors[groups] = factor;
+}
+
+enum class Visit : uint8_t { None, Started, Done };
+
+// Values a symbol expands to, each symbol is visited once. False if the
+// tree has a cycle or a symbol expands to more values than fit.
+bool set_symbol_length(PairsData& pairs, uint16_t symbol,
+                       std::vector<Visit>& visits) {
+  visits[symbol] = Visit::Started;
+  const uint16_t right{get_right_symbol(pairs, symbol)};
+  if (right == k_leaf_symbol) {
+    pairs.symbol_lengths[symbol] = 0;
+    visits[symbol] = Visit::Done;
+    return true;
+  }
+
+  const uint16_t left{get_left_symbol(pairs, symbol)};
+  if (left >= visits.size() || right >= visits.size()) {
+    return false;
+  }
+  for (const uint16_t child : {left, right}) {
+    if (visits[child] == Visit::Started ||
+        (visits[child] == Visit::None &&
+         !set_symbol_length(pairs, child, visits))) {
+      return false;
+    }
+  }
+  const int length{pairs.symbol_lengths[left] + pairs.symbol_lengths[right] +
+                   1};
+  if (length > std::numeric_limits<uint8_t>::max()) {
+    return false;
+  }
+  pairs.symbol_lengths[symbol] = static_cast<uint8_t>(length);
+  visits[symbol] = Visit::Done;
+  return true;
+}
+
+bool read_pairs(PairsData& pairs, TableReader& reader) {
+  pairs.flags = reader.read<uint8_t>();
+  if ((pairs.flags & k_pairs_single_value) != 0) {
+    pairs.single_value = reader.read<uint8_t>();
+    return reader.is_valid();
+  }
+
+  const uint64_t size{get_table_size(pairs)};
+
+  const uint8_t block_shift{reader.read<uint8_t>()};
+  const uint8_t span_shift{reader.read<uint8_t>()};
+  if (block_shift >= 32 || span_shift >= 32) {
+    return false;
+  }
+  pairs.block_size = size_t{1} << block_shift;
+  pairs.span = size_t{1} << span_shift;
+  pairs.sparse_index_size = (size + pairs.span - 1) / pairs.span;
+  // Padded so the sparse index never points past them
+  const uint8_t padding{reader.read<uint8_t>()};
+  pairs.block_count = reader.read<uint32_t>();
+  pairs.block_lengths_size = pairs.block_count + padding;
+
+  const int max_symbol_length{reader.read<uint8_t>()};
+  pairs.min_symbol_length = reader.read<uint8_t>();
+  if (pairs.min_symbol_length < 1 ||
+      max_symbol_length < pairs.min_symbol_length || max_symbol_length > 63) {
+    return false;
+  }
+  const auto lengths{
+      static_cast<size_t>(max_symbol_length - pairs.min_symbol_length + 1)};
+  pairs.lowest_symbols = reader.skip(2 * lengths);
+  if (pairs.lowest_symbols == nullptr) {
+    return false;
+  }
+
+  // Codes of a length follow each other and end where the next shorter
+  // length starts, one bit up
+  pairs.bases.assign(lengths, 0);
+  for (size_t i = lengths - 1; i-- > 0;) {
+    if (get_lowest_symbol(pairs, i) < get_lowest_symbol(pairs, i + 1)) {
+      return false;
+    }
+    pairs.bases[i] = (pairs.bases[i + 1] + get_lowest_symbol(pairs, i) -
+                      get_lowest_symbol(pairs, i + 1)) /
+                     2;
+  }
+  for (size_t i = 0; i < lengths; i++) {
+    const size_t bits{i + static_cast<size_t>(pairs.min_symbol_length)};
+    if ((pairs.bases[i] >> bits) != 0) {
+      return false;
+    }
+    pairs.bases[i] <<= 64 - bits;
+  }
+
+  const uint16_t symbol_count{reader.read<uint16_t>()};
+  pairs.symbol_tree = reader.skip(3 * size_t{symbol_count});
+  reader.skip(symbol_count & 1U);
+  if (!reader.is_valid()) {
+    return false;
+  }
+
+  // Every code decodes to a symbol of the tree
+  for (size_t i = 0; i < lengths; i++) {
+    const uint64_t end{i == 0 ? std::numeric_limits<uint64_t>::max()
+                              : pairs.bases[i - 1] - 1};
+    if (i != 0 && pairs.bases[i - 1] == pairs.bases[i]) {
+      continue;
+    }
+    const size_t bits{i + static_cast<size_t>(pairs.min_symbol_length)};
+    if (((end - pairs.bases[i]) >> (64 - bits)) +
+            get_lowest_symbol(pairs, i) >=
+        symbol_count) {
+      return false;
+    }
+  }
+
+  pairs.symbol_lengths.assign(symbol_count, 0);
+  std::vector<Visit> visits(symbol_count);
+  for (uint16_t symbol = 0; symbol < symbol_count; symbol++) {
+    if (visits[symbol] == Visit::None &&
+        !set_symbol_length(pairs, symbol, visits)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Moves to the block holding the value at offset from the start of block,
+// false if that is not one of the blocks
+bool find_block(const PairsData& pairs, size_t& block, int64_t& offset) {
+  while (offset < 0) {
+    if (block == 0) {
+      return false;
+    }
+    offset += get_block_length(pairs, --block) + 1;
+  }
+  while (offset > get_block_length(pairs, block)) {
+    offset -= get_block_length(pairs, block++) + 1;
+    if (block >= pairs.block_count) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// The sparse index entries point into the blocks, and walking the block
+// lengths from them reaches every value within the blocks
+bool has_valid_blocks(const PairsData& pairs) {
+  if ((pairs.flags & k_pairs_single_value) != 0) {
+    return true;
+  }
+
+  const uint64_t size{get_table_size(pairs)};
+  const auto half_span{static_cast<int64_t>(pairs.span / 2)};
+  for (size_t entry = 0; entry < pairs.sparse_index_size; entry++) {
+    const uint8_t* data{pairs.sparse_index + 6 * entry};
+    const size_t block{read_little_endian<uint32_t>(data)};
+    if (block >= pairs.block_count) {
+      return false;
+    }
+
+    // The walks to the first and last value of the span bound the others
+    const int64_t offset{read_little_endian<uint16_t>(data + 4)};
+    const auto count{
+        static_cast<int64_t>(std::min(pairs.span, size - entry * pairs.span))};
+    for (int64_t last : {offset - half_span, offset + count - 1 - half_span}) {
+      size_t last_block{block};
+      if (!find_block(pairs, last_block, last)) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Value at an index: its block is found through the sparse index, then the
+// symbols of the block are walked and the one holding it is expanded down to
+// a leaf
+int decompress(const PairsData& pairs, uint64_t index) {
+  if ((pairs.flags & k_pairs_single_value) != 0) {
+    return pairs.single_value;
+  }
+
+  const uint64_t entry_index{index / pairs.span};
+  ASSERT(entry_index < pairs.sparse_index_size);
+  const uint8_t* entry{pairs.sparse_index + 6 * entry_index};
+  size_t block{read_little_endian<uint32_t>(entry)};
+  int64_t offset{read_little_endian<uint16_t>(entry + 4) +
+                 static_cast<int64_t>(index % pairs.span) -
+                 static_cast<int64_t>(pairs.span / 2)};
+
+  // Checked for every index when the table was read
+  [[maybe_unused]] const bool is_found{find_block(pairs, block, offset)};
+  ASSERT(is_found);
+
+  // Symbols are read big endian 32 bits at a time, a block never ends in the
+  // middle of one
+  const uint8_t* data{pairs.blocks + block * pairs.block_size};
+  const uint8_t* end{data + pairs.block_size};
+  auto read_word = [&data, end] {
+    const uint32_t word{data + 4 <= end ? read_big_endian<uint32_t>(data) : 0};
+    data += 4;
+    return uint64_t{word};
+  };
+
+  uint64_t buffer{read_word() << 32U};
+  buffer |= read_word();
+  int buffer_size{64};
+
+  uint16_t symbol{};
+  while (true) {
+    size_t length{};
+    while (buffer < pairs.bases[length]) {
+      length++;
+    }
+    const auto bits{length + static_cast<size_t>(pairs.min_symbol_length)};
+    symbol = static_cast<uint16_t>(
+        ((buffer - pairs.bases[length]) >> (64 - bits)) +
+        get_lowest_symbol(pairs, length));
+    ASSERT(symbol < pairs.symbol_lengths.size());
+
+    if (offset < pairs.symbol_lengths[symbol] + 1) {
+      break;
+    }
+    offset -= pairs.symbol_lengths[symbol] + 1;
+
+    buffer <<= bits;
+    buffer_size -= static_cast<int>(bits);
+    if (buffer_size <= 32) {
+      buffer_size += 32;
+      buffer |= read_word() << static_cast<unsigned>(64 - buffer_size);
+    }
+  }
+
+  // The two halves of a pair expand to adjacent runs of values
+  while (pairs.symbol_lengths[symbol] != 0) {
+    const uint16_t left{get_left_symbol(pairs, symbol)};
+    if (offset < pairs.symbol_lengths[left] + 1) {
+      symbol = left;
+    } else {
+      offset -= pairs.symbol_lengths[left] + 1;
+      symbol = get_right_symbol(pairs, symbol);
+    }
+  }
+  return get_left_symbol(pairs, symbol);
+}
+
+bool compare_pawns(int tile, int other) {
+  return k_index.pawns[static_cast<size_t>(tile)] <
+         k_index.pawns[static_cast<size_t>(other)];
+}
+
+// Stable insertion sort of tiles[begin, end), a group is a few pieces
+template <typename Compare>
+void sort_tiles(std::array<int, k_max_table_pieces>& tiles, size_t begin,
+                size_t end, Compare compare) {
+  ASSERT(end <= tiles.size());
+  for (size_t i = begin + 1; i < end; i++) {
+    for (size_t j = i; j > begin && compare(tiles[j], tiles[j - 1]); j--) {
+      std::swap(tiles[j], tiles[j - 1]);
+    }
+  }
+}
+
+// Three unique pieces placed together, the first one in the triangle
+uint64_t get_unique_pieces_index(
+    const std::array<int, k_max_table_pieces>& tiles) {
+  const auto first{static_cast<size_t>(tiles[0])};
+  const auto second{static_cast<size_t>(tiles[1])};
+  const auto third{static_cast<size_t>(tiles[2])};
+  const size_t skip_second{second > first ? 1U : 0U};
+  const size_t skip_third{(third > first ? 1U : 0U) +
+                          (third > second ? 1U : 0U)};
+
+  if (get_diagonal_offset(tiles[0]) != 0) {
+    return (static_cast<uint64_t>(k_index.triangle[first]) * 63 + second -
+            skip_second) *
+               62 +
+           third - skip_third;
+  }
+  // The first one on the diagonal, and the rest on or below it
+  if (get_diagonal_offset(tiles[1]) != 0) {
+    return (6 * 63 + (first >> 3) * 28 +
+            static_cast<uint64_t>(k_index.below_diagonal[second])) *
+               62 +
+           third - skip_third;
+  }
+  if (get_diagonal_offset(tiles[2]) != 0) {
+    return 6 * 63 * 62 + 4 * 28 * 62 + (first >> 3) * 7 * 28 +
+           ((second >> 3) - skip_second) * 28 +
+           static_cast<uint64_t>(k_index.below_diagonal[third]);
+  }
+  return 6 * 63 * 62 + 4 * 28 * 62 + 4 * 7 * 28 + (first >> 3) * 7 * 6 +
+         ((second >> 3) - skip_second) * 6 + (third >> 3) - skip_third;
+}
+
+// Index of the pieces on tiles, which are in the order of pairs.pieces with
+// the leading pawns first. The board is mirrored and turned to the part of
+// it the table covers.
+uint64_t get_position_index(const PairsData& pairs, const Material& material,
+                            std::array<int, k_max_table_pieces>& tiles,
+                            size_t lead_pawn_count) {
+  const auto size{static_cast<size_t>(material.piece_count)};
+  if ((tiles[0] & 7) > 3) {
+    for (size_t i = 0; i < size; i++) {
+      tiles[i] ^= 7;
+    }
+  }
+
+  uint64_t index{};
+  if (material.has_pawns) {
+    index = k_index.lead_pawns[lead_pawn_count][static_cast<size_t>(tiles[0])];
+    sort_tiles(tiles, 1, lead_pawn_count, compare_pawns);
+    for (size_t i = 1; i < lead_pawn_count; i++) {
+      index += k_index.binomial[i][static_cast<size_t>(
+          k_index.pawns[static_cast<size_t>(tiles[i])])];
+    }
+  } else {
+    if ((tiles[0] >> 3) > 3) {
+      for (size_t i = 0; i < size; i++) {
+        tiles[i] ^= 56;
+      }
+    }
+
+    // The first piece of the leading group off the a1-h8 diagonal goes
+    // below it
+    for (size_t i = 0; i < pairs.group_lengths[0]; i++) {
+      const int offset{get_diagonal_offset(tiles[i])};
+      if (offset == 0) {
+        continue;
+      }
+      if (offset > 0) {
+        for (size_t j = i; j < size; j++) {
+          tiles[j] = ((tiles[j] >> 3) | (tiles[j] << 3)) & 63;
+        }
+      }
+      break;
+    }
+
+    index = material.has_unique_pieces
+                ? get_unique_pieces_index(tiles)
+                : static_cast<uint64_t>(
+                      k_index.kings[static_cast<size_t>(
+                          k_index.triangle[static_cast<size_t>(tiles[0])])]
+                                   [static_cast<size_t>(tiles[1])]);
+  }
+  index *= pairs.group_factors[0];
+
+  // Each further group is one combination of the tiles the earlier groups
+  // left free, the other pawns also keep off ranks 1 and 8
+  size_t start{pairs.group_lengths[0]};
+  bool is_pawn_group{material.pawn_counts[1] != 0};
+  for (size_t group = 1; pairs.group_lengths[group] != 0; group++) {
+    const size_t length{pairs.group_lengths[group]};
+    ASSERT(start + length <= tiles.size());
+    sort_tiles(tiles, start, start + length, std::less{});
+
+    uint64_t combination{};
+    for (size_t i = 0; i < length; i++) {
+      const int tile{tiles[start + i]};
+      size_t taken{};
+      for (size_t j = 0; j < start; j++) {
+        taken += tiles[j] < tile ? 1U : 0U;
+      }
+      combination += k_index.binomial[i + 1][static_cast<size_t>(tile) - taken -
+                                             (is_pawn_group ? 8U : 0U)];
+    }
+    is_pawn_group = false;
+    index += combination * pairs.group_factors[group];
+    start += length;
+  }
+  return index;
+}
+
+// DTZ values go through a map for each result, and may count moves rather
+// than plies. False if the value is past the end of its map.
+bool to_dtz_plies(const PairsData& pairs, const uint8_t* map, Wdl wdl,
+                  int& value) {
+  // Indexed by Wdl, which map of win, loss, cursed win and blessed loss
+  constexpr std::array<size_t, 5> k_map_order{1, 3, 0, 2, 0};
+
+  if ((pairs.flags & k_pairs_mapped) != 0) {
+    const size_t order{
+        k_map_order[static_cast<size_t>(to_underlying(wdl) + 2)]};
+    if (value >= pairs.dtz_map_lengths[order]) {
+      return false;
+    }
+    const size_t i{pairs.dtz_maps[order] + static_cast<size_t>(value)};
+    value = (pairs.flags & k_pairs_wide_map) != 0
+                ? read_little_endian<uint16_t>(map + 2 * i)
+                : map[i];
+  }
+
+  if ((wdl == Wdl::Win && (pairs.flags & k_pairs_win_plies) == 0) ||
+      (wdl == Wdl::Loss && (pairs.flags & k_pairs_loss_plies) == 0) ||
+      wdl == Wdl::CursedWin || wdl == Wdl::BlessedLoss) {
+    value *= 2;
+  }
+  value++;
+  return true;
+}
+
+Wdl negate(Wdl wdl) { return static_cast<Wdl>(-to_underlying(wdl)); }
+
+int get_sign(int value) { return (value > 0 ? 1 : 0) - (value < 0 ? 1 : 0); }
+
+// DTZ right before a capture or pawn move with that result comes out of it
+int get_zeroing_dtz(Wdl wdl) {
+  switch (wdl) {
+    case Wdl::Win:
+      return 1;
+    case Wdl::CursedWin:
+      return 101;
+    case Wdl::BlessedLoss:
+      return -101;
+    case Wdl::Loss:
+      return -1;
+    default:
+      return 0;
+  }
+}
+
+bool is_capture(const Board& board, Board::Move move) {
+  return board.get_type(move.target) != PieceType::None ||
+         (board.get_type(move.tile) == PieceType::Pawn &&
+          (move.target & 7) != (move.tile & 7));
+}
+
+bool is_zeroing(const Board& board, Board::Move move) {
+  return is_capture(board, move) ||
+         board.get_type(move.tile) == PieceType::Pawn;
+}
+
+PieceType parse_piece_letter(char letter) {
+  switch (letter) {
+    case 'K':
+      return PieceType::King;
+    case 'Q':
+      return PieceType::Queen;
+    case 'R':
+      return PieceType::Rook;
+    case 'B':
+      return PieceType::Bishop;
+    case 'N':
+      return PieceType::Knight;
+    case 'P':
+      return PieceType::Pawn;
+    default:
+      return PieceType::None;
+  }
+}
+
+// Material keys of a name like KQvKR, with white as the first side and with
+// black as the first side. False if it is not a table name.
+bool parse_table_name(std::string_view name, uint64_t& key,
+                      uint64_t& mirrored_key, int& pieces) {
+  const size_t separator{name.find('v')};
+  if (separator == std::string_view::npos || separator == 0 ||
+      separator + 1 == name.size()) {
+    return false;
+  }
+
+  key = 0;
+  mirrored_key = 0;
+  pieces = 0;
+  for (size_t i = 0; i < name.size(); i++) {
+    if (i == separator) {
+      continue;
+    }
+    const PieceType type{parse_piece_letter(name[i])};
+    if (type == PieceType::None || pieces == k_max_table_pieces) {
+      return false;
+    }
+
+    const PieceColor color{i < separator ? PieceColor::White
+                                         : PieceColor::Black};
+    key += get_material_increment(make_piece(color, type));
+    mirrored_key +=
+        get_material_increment(make_piece(get_opposite_color(color), type));
+    pieces++;
+  }
+
+  // Both sides need their king
+  return get_material_count(key, make_piece(PieceColor::White,
+                                            PieceType::King)) == 1 &&
+         get_material_count(key, make_piece(PieceColor::Black,
+                                            PieceType::King)) == 1;
+}
+
+}  // namespace
+
+struct Tablebases::Table {
+  // The WDL or the DTZ file of the material
+  struct TableFile {
+    fs::path path;
+    std::once_flag mapped;
+    MappedFile mapping;
+    bool is_valid{};
+    // By side to move and file of the leading pawn. DTZ files and symmetric
+    // material hold one side, tables without pawns one file.
+    std::array<std::array<PairsData, 4>, 2> pairs;
+    const uint8_t* dtz_map{};
+  };
+
+  uint64_t key{};
+  uint64_t mirrored_key{};
+  Material material;
+  std::array<TableFile, 2> files;
+};
+
+Tablebases::Tablebases() = default;
+Tablebases::~Tablebases() = default;
+
+int Tablebases::init(std::string_view paths) {
+  clear();
+
+  while (!paths.empty()) {
+    const size_t end{std::min(paths.find(k_path_separator), paths.size())};
+    const fs::path directory{paths.substr(0, end)};
+    paths.remove_prefix(std::min(end + 1, paths.size()));
+
+    std::error_code error;
+    for (const fs::directory_entry& file :
+         fs::directory_iterator{directory, error}) {
+      const fs::path extension{file.path().extension()};
+      if (extension != ".rtbw" && extension != ".rtbz") {
+        continue;
+      }
+
+      uint64_t key{};
+      uint64_t mirrored_key{};
+      int pieces{};
+      if (!parse_table_name(file.path().stem().string(), key, mirrored_key,
+                            pieces)) {
+        continue;
+      }
+
+      Table* table{entries_[key]};
+      if (table == nullptr) {
+        table = tables_.emplace_back(std::make_unique<Table>()).get();
+        table->key = key;
+        table->mirrored_key = mirrored_key;
+        table->material = get_material(key);
+        // Symmetric material like KRvKR is the same either way round
+        entries_[key] = table;
+        entries_[mirrored_key] = table;
+      }
+
+      // The first directory with the file wins
+      const TableType type{extension == ".rtbw" ? TableType::Wdl
+                                                : TableType::Dtz};
+      fs::path& path{table->files[to_underlying(type)].path};
+      if (path.empty()) {
+        path = file.path();
+      }
+    }
+    if (error) {
+      LOGF_ERROR("Tablebase", "Failed to read \"{}\"", directory.string());
+    }
+  }
+
+  int wdl_tables{};
+  int dtz_tables{};
+  for (const auto& table : tables_) {
+    if (!table->files[to_underlying(TableType::Wdl)].path.empty()) {
+      wdl_tables++;
+      max_pieces_ = std::max(max_pieces_, table->material.piece_count);
+    }
+    if (!table->files[to_underlying(TableType::Dtz)].path.empty()) {
+      dtz_tables++;
+    }
+  }
+
+  LOGF("Tablebase", "Found {} WDL and {} DTZ tables of up to {} pieces",
+       wdl_tables, dtz_tables, max_pieces_);
+  return wdl_tables;
+}
+
+void Tablebases::clear() {
+  entries_.clear();
+  tables_.clear();
+  max_pieces_ = 0;
+}
+
+std::optional<Wdl> Tablebases::probe_wdl(Board& board) const {
+  // Syzygy tables assume no castling rights
+  if (board.get_piece_count() > max_pieces_ || board.has_castling_rights()) {
+    return std::nullopt;
+  }
+
+  ProbeState state{ProbeState::Ok};
+  const Wdl wdl{search_wdl(board, false, state)};
+  if (state == ProbeState::Failed) {
+    return std::nullopt;
+  }
+  return wdl;
+}
+
+std::optional<int> Tablebases::probe_dtz(Board& board) const {
+  if (board.get_piece_count() > max_pieces_ || board.has_castling_rights()) {
+    return std::nullopt;
+  }
+
+  ProbeState state{ProbeState::Ok};
+  const int dtz{search_dtz(board, state)};
+  if (state == ProbeState::Failed) {
+    return std::nullopt;
+  }
+  return dtz;
+}
+
+bool Tablebases::filter_root_moves(Board& board, Board::Moves& moves) const {
+  if (moves.size == 0 || board.get_piece_count() > max_pieces_ ||
+      board.has_castling_rights()) {
+    return false;
+  }
+
+  std::array<int, 256> ranks{};
+  if (!rank_by_dtz(board, moves, ranks) && !rank_by_wdl(board, moves, ranks)) {
+    return false;
+  }
+
+  const int best{*std::max_element(ranks.begin(), ranks.begin() + moves.size)};
+  size_t kept{};
+  for (size_t i = 0; i < static_cast<size_t>(moves.size); i++) {
+    if (ranks[i] == best) {
+      moves.data[kept++] = moves.data[i];
+    }
+  }
+  moves.size = static_cast<int>(kept);
+  return true;
+}
+
+int Tablebases::probe_table(const Board& board, TableType type, Wdl wdl,
+                            ProbeState& state) const {
+  // Only the kings
+  if (board.get_piece_count() == 2) {
+    return 0;
+  }
+
+  const auto it{entries_.find(board.get_material_key())};
+  if (it == entries_.end()) {
+    state = ProbeState::Failed;
+    return 0;
+  }
+
+  // Threads probing a table for the first time wait for one of them to map it
+  Table& table{*it->second};
+  Table::TableFile& file{table.files[to_underlying(type)]};
+  std::call_once(file.mapped, [&table, &file, type] {
+    file.is_valid = map_table(table, type);
+  });
+  if (!file.is_valid) {
+    state = ProbeState::Failed;
+    return 0;
+  }
+
+  // Tables have the first side of their name as white, and symmetric ones
+  // only white to move. Other positions swap the colors and turn the board.
+  const Material& material{table.material};
+  const bool is_black_to_move{board.get_turn() == PieceColor::Black};
+  const bool is_flipped{table.key == table.mirrored_key
+                            ? is_black_to_move
+                            : board.get_material_key() != table.key};
+  const uint8_t flip_code{is_flipped ? k_black_code : uint8_t{}};
+  const int flip_tiles{is_flipped ? 56 : 0};
+  const size_t side{is_flipped != is_black_to_move ? 1U : 0U};
+
+  std::array<int, k_max_table_pieces> tiles{};
+  std::array<uint8_t, k_max_table_pieces> codes{};
+  size_t size{};
+
+  // With pawns there is a table for each file of the leading pawn, the one
+  // nearest the edge and lowest on the board
+  Bitboard lead_pawns{};
+  size_t lead_file{};
+  if (material.has_pawns) {
+    const bool is_white_lead{
+        ((file.pairs[0][0].pieces[0] ^ flip_code) & k_black_code) == 0};
+    lead_pawns = board.get_piece_bitboard(
+        is_white_lead ? PieceColor::White : PieceColor::Black, PieceType::Pawn);
+    for (Bitboard pawns{lead_pawns}; pawns != 0;) {
+      tiles[size++] = pop_first_tile(pawns) ^ flip_tiles;
+    }
+    std::swap(tiles[0],
+              *std::max_element(tiles.begin(),
+                                tiles.begin() + static_cast<int64_t>(size),
+                                compare_pawns));
+    lead_file = static_cast<size_t>(std::min(tiles[0] & 7, 7 - (tiles[0] & 7)));
+  }
+  const size_t lead_pawn_count{size};
+
+  if (type == TableType::Dtz &&
+      ((file.pairs[0][lead_file].flags & k_pairs_black_to_move) != 0) !=
+          (side == 1) &&
+      (table.key != table.mirrored_key || material.has_pawns)) {
+    state = ProbeState::ChangeTurn;
+    return 0;
+  }
+
+  for (Bitboard pieces{board.get_occupancy() ^ lead_pawns}; pieces != 0;) {
+    const int tile{pop_first_tile(pieces)};
+    tiles[size] = tile ^ flip_tiles;
+    codes[size++] = get_piece_code(board.get_tile(tile)) ^ flip_code;
+  }
+
+  // In the order of the index
+  const PairsData& pairs{
+      file.pairs[type == TableType::Wdl ? side : 0][lead_file]};
+  for (size_t i = lead_pawn_count; i + 1 < size; i++) {
+    for (size_t j = i + 1; j < size; j++) {
+      if (pairs.pieces[i] == codes[j]) {
+        std::swap(codes[i], codes[j]);
+        std::swap(tiles[i], tiles[j]);
+        break;
+      }
+    }
+  }
+
+  int value{decompress(
+      pairs, get_position_index(pairs, material, tiles, lead_pawn_count))};
+  if (type == TableType::Wdl) {
+    return value - 2;
+  }
+  if (!to_dtz_plies(pairs, file.dtz_map, wdl, value)) {
+    state = ProbeState::Failed;
+    return 0;
+  }
+  return value;
+}
+
+Wdl Tablebases::search_wdl(Board& board, bool check_zeroing,
+                           ProbeState& state) const {
+  Board::Moves moves;
+  board.generate_all(moves);
+
+  Wdl best{Wdl::Loss};
+  int tried{};
+  for (size_t i = 0; i < static_cast<size_t>(moves.size); i++) {
+    const Board::Move move{moves.data[i]};
+    if (!is_capture(board, move) &&
+        (!check_zeroing || board.get_type(move.tile) != PieceType::Pawn)) {
+      continue;
+    }
+    if (board.get_records().full()) {
+      state = ProbeState::Failed;
+      return Wdl::Draw;
+    }
+    tried++;
+
+    board.move(move);
+    const Wdl wdl{negate(search_wdl(board, false, state))};
+    board.undo();
+
+    if (state == ProbeState::Failed) {
+      return Wdl::Draw;
+    }
+    if (wdl > best) {
+      best = wdl;
+      if (wdl == Wdl::Win) {
+        state = ProbeState::ZeroingBestMove;
+        return wdl;
+      }
+    }
+  }
+
+  // With every move tried the stored value is not needed, it could be wrong
+  // as the tables know nothing of en passant
+  const bool is_all_tried{tried != 0 && tried == moves.size};
+  Wdl wdl{best};
+  if (!is_all_tried) {
+    wdl = static_cast<Wdl>(probe_table(board, TableType::Wdl, {}, state));
+    if (state == ProbeState::Failed) {
+      return Wdl::Draw;
+    }
+  }
+
+  // Stored values don't matter where a capture does at least as well
+  if (best >= wdl) {
+    state = best > Wdl::Draw || is_all_tried ? ProbeState::ZeroingBestMove
+                                             : ProbeState::Ok;
+    return best;
+  }
+  state = ProbeState::Ok;
+  return wdl;
+}
+
+int Tablebases::search_dtz(Board& board, ProbeState& state) const {
+  state = ProbeState::Ok;
+  const Wdl wdl{search_wdl(board, true, state)};
+  if (state == ProbeState::Failed || wdl == Wdl::Draw) {
+    return 0;
+  }
+  if (state == ProbeState::ZeroingBestMove) {
+    return get_zeroing_dtz(wdl);
+  }
+
+  const int dtz{probe_table(board, TableType::Dtz, wdl, state)};
+  if (state == ProbeState::Failed) {
+    return 0;
+  }
+  if (state != ProbeState::ChangeTurn) {
+    const bool is_cursed{wdl == Wdl::CursedWin || wdl == Wdl::BlessedLoss};
+    return (dtz + (is_cursed ? 100 : 0)) * get_sign(to_underlying(wdl));
+  }
+
+  // The table holds the other side to move, the best reply decides
+  Board::Moves moves;
+  board.generate_all(moves);
+
+  int best{0xFFFF};
+  for (size_t i = 0; i < static_cast<size_t>(moves.size); i++) {
+    const Board::Move move{moves.data[i]};
+    if (board.get_records().full()) {
+      state = ProbeState::Failed;
+      return 0;
+    }
+    const bool zeroing{is_zeroing(board, move)};
+
+    // The DTZ of a zeroing move is the one from before it, the position
+    // after it only tells which way it goes
+    board.move(move);
+    int move_dtz{zeroing
+                     ? -get_zeroing_dtz(search_wdl(board, false, state))
+                     : -search_dtz(board, state)};
+    if (move_dtz == 1 && board.is_in_check() && !board.has_any_legal_move()) {
+      best = 1;
+    }
+    board.undo();
+
+    if (state == ProbeState::Failed) {
+      return 0;
+    }
+    if (!zeroing) {
+      move_dtz += get_sign(move_dtz);
+    }
+    if (move_dtz < best && get_sign(move_dtz) == get_sign(to_underlying(wdl))) {
+      best = move_dtz;
+    }
+  }
+
+  // Without a legal move it is mate
+  return best == 0xFFFF ? -1 : best;
+}
+
+bool Tablebases::rank_by_dtz(Board& board, const Board::Moves& moves,
+                             std::array<int, 256>& ranks) const {
+  const int halfmove_clock{board.get_halfmove_clock()};
+  const bool is_repeated{board.is_repetition()};
+
+  for (size_t i = 0; i < static_cast<size_t>(moves.size); i++) {
+    if (board.get_records().full()) {
+      return false;
+    }
+
+    ProbeState state{ProbeState::Ok};
+    board.move(moves.data[i]);
+    int dtz{};
+    if (board.get_halfmove_clock() == 0) {
+      dtz = get_zeroing_dtz(negate(search_wdl(board, false, state)));
+    } else if (board.get_halfmove_clock() >= 100 ||
+               board.count_repetitions() >= 2) {
+      dtz = 0;
+    } else {
+      dtz = -search_dtz(board, state);
+      dtz += get_sign(dtz);
+    }
+    // Mate is one ply away, not two
+    if (dtz == 2 && board.is_in_check() && !board.has_any_legal_move()) {
+      dtz = 1;
+    }
+    board.undo();
+
+    if (state == ProbeState::Failed) {
+      return false;
+    }
+
+    // The fastest win and the slowest loss rank highest, results past the
+    // fifty-move rule rank next to a draw
+    if (dtz > 0) {
+      ranks[i] = dtz + halfmove_clock <= 99 && !is_repeated
+                     ? k_max_dtz - dtz
+                     : k_max_dtz / 2 - (dtz + halfmove_clock);
+    } else if (dtz < 0) {
+      ranks[i] = -dtz * 2 + halfmove_clock < 100
+                     ? -k_max_dtz - dtz
+                     : -k_max_dtz / 2 + (-dtz + halfmove_clock);
+    } else {
+      ranks[i] = 0;
+    }
+  }
+  return true;
+}
+
+bool Tablebases::rank_by_wdl(Board& board, const Board::Moves& moves,
+                             std::array<int, 256>& ranks) const {
+  // Indexed by Wdl
+  constexpr std::array<int, 5> k_wdl_ranks{-k_max_dtz, -k_max_dtz + 101, 0,
+                                           k_max_dtz - 101, k_max_dtz};
+
+  for (size_t i = 0; i < static_cast<size_t>(moves.size); i++) {
+    if (board.get_records().full()) {
+      return false;
+    }
+
+    ProbeState state{ProbeState::Ok};
+    board.move(moves.data[i]);
+    const Wdl wdl{negate(search_wdl(board, false, state))};
+    board.undo();
+
+    if (state == ProbeState::Failed) {
+      return false;
+    }
+    ranks[i] = k_wdl_ranks[static_cast<size_t>(to_underlying(wdl) + 2)];
+  }
+  return true;
+}
+
+bool Tablebases::map_table(Table& table, TableType type) {
+  Table::TableFile& file{table.files[to_underlying(type)]};
+  if (file.path.empty() ||
+      !file.mapping.open(file.path, MappedFile::Access::Random)) {
+    return false;
+  }
+
+  if (!read_table(table, type)) {
+    LOGF_ERROR("Tablebase", "Invalid table \"{}\"", file.path.string());
+    file.mapping.close();
+    return false;
+  }
+
+  LOGF_DEBUG("Tablebase", "Table mapped (file: \"{}\")", file.path.string());
+  return true;
+}
+
+bool Tablebases::read_table(Table& table, TableType type) {
+  Table::TableFile& file{table.files[to_underlying(type)]};
+  TableReader reader{file.mapping.get_view()};
+
+  const std::array<uint8_t, 4>& magic{type == TableType::Wdl ? k_wdl_magic
+                                                             : k_dtz_magic};
+  const uint8_t* start{reader.skip(magic.size())};
+  if (start == nullptr || !std::equal(magic.begin(), magic.end(), start)) {
+    return false;
+  }
+
+  const Material& material{table.material};
+  const bool is_split{table.key != table.mirrored_key};
+  const uint8_t flags{reader.read<uint8_t>()};
+  if (((flags & k_table_has_pawns) != 0) != material.has_pawns ||
+      ((flags & k_table_split) != 0) != is_split) {
+    return false;
+  }
+
+  const size_t sides{type == TableType::Wdl && is_split ? 2U : 1U};
+  const size_t files{material.has_pawns ? 4U : 1U};
+
+  // The order of the groups in the index and the pieces, a nibble for each
+  // side to move
+  for (size_t f = 0; f < files; f++) {
+    const uint8_t order{reader.read<uint8_t>()};
+    const uint8_t other_order{material.pawn_counts[1] != 0
+                                  ? reader.read<uint8_t>()
+                                  : uint8_t{0xFF}};
+    for (size_t i = 0; i < static_cast<size_t>(material.piece_count); i++) {
+      const uint8_t pieces{reader.read<uint8_t>()};
+      for (size_t side = 0; side < sides; side++) {
+        file.pairs[side][f].pieces[i] =
+            static_cast<uint8_t>(side == 0 ? pieces & 0xFU : pieces >> 4U);
+      }
+    }
+
+    for (size_t side = 0; side < sides; side++) {
+      PairsData& pairs{file.pairs[side][f]};
+      if (!has_material(pairs, table.key, material)) {
+        return false;
+      }
+      const unsigned shift{side == 0 ? 0U : 4U};
+      set_groups(pairs, material,
+                 {(size_t{order} >> shift) & 0xFU,
+                  (size_t{other_order} >> shift) & 0xFU},
+                 f);
+    }
+  }
+  reader.align(2);
+
+  for (size_t f = 0; f < files; f++) {
+    for (size_t side = 0; side < sides; side++) {
+      if (!read_pairs(file.pairs[side][f], reader)) {
+        return false;
+      }
+    }
+  }
+
+  // One map for each result, its length first
+  if (type == TableType::Dtz) {
+    const size_t map_start{reader.get_position()};
+    file.dtz_map = reader.skip(0);
+    for (size_t f = 0; f < files; f++) {
+      PairsData& pairs{file.pairs[0][f]};
+      if ((pairs.flags & k_pairs_mapped) == 0) {
+        continue;
+      }
+      const bool is_wide{(pairs.flags & k_pairs_wide_map) != 0};
+      if (is_wide) {
+        reader.align(2);
+      }
+      for (size_t map = 0; map < pairs.dtz_maps.size(); map++) {
+        const uint16_t length{is_wide ? reader.read<uint16_t>()
+                                      : uint16_t{reader.read<uint8_t>()}};
+        const size_t offset{reader.get_position() - map_start};
+        pairs.dtz_maps[map] = static_cast<uint16_t>(is_wide ? offset / 2
+                                                            : offset);
+        pairs.dtz_map_lengths[map] = length;
+        reader.skip(is_wide ? 2 * size_t{length} : length);
+      }
+    }
+    reader.align(2);
+  }
+
+  for (size_t f = 0; f < files; f++) {
+    for (size_t side = 0; side < sides; side++) {
+      PairsData& pairs{file.pairs[side][f]};
+      pairs.sparse_index = reader.skip(6 * pairs.sparse_index_size);
+    }
+  }
+  for (size_t f = 0; f < files; f++) {
+    for (size_t side = 0; side < sides; side++) {
+      PairsData& pairs{file.pairs[side][f]};
+      pairs.block_lengths = reader.skip(2 * pairs.block_lengths_size);
+    }
+  }
+  for (size_t f = 0; f < files; f++) {
+    for (size_t side = 0; side < sides; side++) {
+      PairsData& pairs{file.pairs[side][f]};
+      reader.align(64);
+      pairs.blocks = reader.skip(pairs.block_count * pairs.block_size);
+    }
+  }
+  if (!reader.is_valid()) {
+    return false;
+  }
+
+  for (size_t f = 0; f < files; f++) {
+    for (size_t side = 0; side < sides; side++) {
+      if (!has_valid_blocks(file.pairs[side][f])) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
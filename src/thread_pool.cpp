@@ -0,0 +1,43 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threads) {
+  if (threads <= 0) {
+    threads =
+        std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+  }
+
+  threads_.reserve(static_cast<size_t>(threads));
+  for (int i = 0; i < threads; i++) {
+    threads_.emplace_back(&ThreadPool::work, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    const std::lock_guard lock{mutex_};
+    stopping_ = true;
+  }
+  condition_.notify_all();
+
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+
+void ThreadPool::work() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock lock{mutex_};
+      condition_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+      if (tasks_.empty()) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
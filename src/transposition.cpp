@@ -0,0 +1,115 @@
+#include "transposition.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+// Move in bits 0-15, score 16-31, depth 32-39, bound 40-47, generation 48-55
+uint64_t pack_entry(const TranspositionEntry& entry, uint8_t generation) {
+  uint64_t move{};
+  if (entry.move.tile != -1) {
+    move = static_cast<uint64_t>(entry.move.tile) |
+           static_cast<uint64_t>(entry.move.target) << 6U |
+           static_cast<uint64_t>(to_underlying(entry.move.promotion)) << 12U;
+  }
+  return move | static_cast<uint64_t>(static_cast<uint16_t>(entry.score)) << 16U |
+         static_cast<uint64_t>(static_cast<uint8_t>(entry.depth)) << 32U |
+         static_cast<uint64_t>(to_underlying(entry.bound)) << 40U |
+         static_cast<uint64_t>(generation) << 48U;
+}
+
+TranspositionEntry unpack_entry(uint64_t data) {
+  TranspositionEntry entry;
+  if (const auto move{static_cast<uint16_t>(data)}; move != 0) {
+    entry.move = {move & 63, (move >> 6U) & 63,
+                  static_cast<PieceType>(move >> 12U)};
+  }
+  entry.score = static_cast<int16_t>(data >> 16U);
+  entry.depth = static_cast<int8_t>(data >> 32U);
+  entry.bound = static_cast<Bound>((data >> 40U) & 0xFFU);
+  return entry;
+}
+
+constexpr uint8_t get_entry_generation(uint64_t data) {
+  return static_cast<uint8_t>(data >> 48U);
+}
+
+}  // namespace
+
+TranspositionTable::TranspositionTable(size_t size_mb) { resize(size_mb); }
+
+void TranspositionTable::resize(size_t size_mb) {
+  // Round down to a power of two so the bucket index is a mask
+  bucket_count_ = std::bit_floor(
+      std::max<size_t>(size_mb * 1024 * 1024 / sizeof(Bucket), 1));
+  buckets_ = std::make_unique<Bucket[]>(bucket_count_);
+  clear();
+}
+
+void TranspositionTable::clear() {
+  for (size_t i = 0; i < bucket_count_; i++) {
+    for (Entry& entry : buckets_[i].entries) {
+      entry.key.store(0, std::memory_order_relaxed);
+      entry.data.store(0, std::memory_order_relaxed);
+    }
+  }
+  generation_ = 0;
+}
+
+bool TranspositionTable::probe(uint64_t hash, TranspositionEntry& entry) const {
+  for (const Entry& candidate : get_bucket(hash).entries) {
+    const uint64_t data{candidate.data.load(std::memory_order_relaxed)};
+    if ((candidate.key.load(std::memory_order_relaxed) ^ data) == hash &&
+        data != 0) {
+      entry = unpack_entry(data);
+      return true;
+    }
+  }
+  return false;
+}
+
+void TranspositionTable::store(uint64_t hash, const TranspositionEntry& entry) {
+  // Same position first, otherwise the shallowest entry with older searches
+  // counting as shallower
+  TranspositionEntry stored{entry};
+  Entry* replace{};
+  int replace_value{std::numeric_limits<int>::max()};
+  for (Entry& candidate : get_bucket(hash).entries) {
+    const uint64_t data{candidate.data.load(std::memory_order_relaxed)};
+    if ((candidate.key.load(std::memory_order_relaxed) ^ data) == hash) {
+      // A fail low has no best move, keep the one found earlier
+      if (stored.move.tile == -1) {
+        stored.move = unpack_entry(data).move;
+      }
+      replace = &candidate;
+      break;
+    }
+
+    const int age{static_cast<uint8_t>(generation_ - get_entry_generation(data))};
+    const int value{unpack_entry(data).depth - 8 * age};
+    if (value < replace_value) {
+      replace = &candidate;
+      replace_value = value;
+    }
+  }
+
+  const uint64_t data{pack_entry(stored, generation_)};
+  replace->key.store(hash ^ data, std::memory_order_relaxed);
+  replace->data.store(data, std::memory_order_relaxed);
+}
+
+int TranspositionTable::get_hashfull() const {
+  const size_t buckets{std::min<size_t>(bucket_count_, 1000 / k_bucket_size)};
+
+  int used{};
+  for (size_t i = 0; i < buckets; i++) {
+    for (const Entry& entry : buckets_[i].entries) {
+      const uint64_t data{entry.data.load(std::memory_order_relaxed)};
+      if (data != 0 && get_entry_generation(data) == generation_) {
+        used++;
+      }
+    }
+  }
+  return 1000 * used / static_cast<int>(buckets * k_bucket_size);
+}
@@ -0,0 +1,348 @@
+#include "uci.hpp"
+
+#include <charconv>
+#include <condition_variable>
+#include <iostream>
+#include <sstream>
+
+#include "notation.hpp"
+#include "perft.hpp"
+#include "stats.hpp"
+
+namespace {
+
+constexpr int k_max_hash_mb{65536};
+constexpr int k_max_threads{1024};
+
+// Moves to plan for when the time control does not say
+constexpr int k_default_moves_to_go{30};
+// Kept back for the communication with the GUI
+constexpr std::chrono::milliseconds k_move_overhead{50};
+
+bool parse_int(std::string_view text, int& value) {
+  const auto* end{text.data() + text.size()};
+  const auto [ptr, error]{std::from_chars(text.data(), end, value)};
+  return error == std::errc{} && ptr == end;
+}
+
+std::string get_score_string(int score) {
+  if (std::abs(score) < k_mate_bound) {
+    return "cp " + std::to_string(score);
+  }
+
+  // In moves rather than plies, negative when getting mated
+  const int moves{(k_mate_score - std::abs(score) + 1) / 2};
+  return "mate " + std::to_string(score > 0 ? moves : -moves);
+}
+
+std::string get_info_string(const SearchResult& result, int hashfull) {
+  std::string info{"info depth " + std::to_string(result.depth) + " score " +
+                   get_score_string(result.score) + " nodes " +
+                   std::to_string(result.nodes) + " nps " +
+                   std::to_string(result.nps) + " time " +
+                   std::to_string(result.time.count()) + " hashfull " +
+                   std::to_string(hashfull)};
+  if (!result.pv.empty()) {
+    info += " pv";
+    for (const Board::Move move : result.pv) {
+      info += ' ' + to_uci_move(move);
+    }
+  }
+  return info;
+}
+
+}  // namespace
+
+Uci::Uci(std::istream& input, std::ostream& output)
+    : input_{input}, output_{output} {}
+
+void Uci::run() {
+  std::string line;
+  while (std::getline(input_, line)) {
+    std::istringstream args{line};
+    std::string command;
+    args >> command;
+
+    if (command == "uci") {
+      handle_uci();
+    } else if (command == "isready") {
+      write("readyok");
+    } else if (command == "ucinewgame") {
+      wait_for_search();
+      search_.clear();
+      board_.load_fen();
+    } else if (command == "position") {
+      wait_for_search();
+      handle_position(args);
+    } else if (command == "go") {
+      wait_for_search();
+      handle_go(args);
+    } else if (command == "stop") {
+      stop_search();
+    } else if (command == "setoption") {
+      wait_for_search();
+      handle_setoption(args);
+    } else if (command == "perft") {
+      wait_for_search();
+      int depth{};
+      if (args >> depth) {
+        handle_perft(depth);
+      }
+    } else if (command == "stats") {
+      wait_for_search();
+      handle_stats();
+    } else if (command == "quit") {
+      break;
+    } else if (!command.empty()) {
+      LOGF("UCI", "Unknown command: {}", command);
+    }
+  }
+
+  stop_search();
+}
+
+void Uci::handle_uci() {
+  write("id name Chess");
+  write("id author ecyk");
+  write("option name Hash type spin default " +
+        std::to_string(k_default_hash_mb) + " min 1 max " +
+        std::to_string(k_max_hash_mb));
+  write("option name Threads type spin default 1 min 1 max " +
+        std::to_string(k_max_threads));
+  write("option name OwnBook type check default false");
+  write("option name BookFile type string default <empty>");
+  write("option name SyzygyPath type string default <empty>");
+  write("option name EvalFile type string default <empty>");
+  write("uciok");
+}
+
+void Uci::handle_position(std::istream& args) {
+  std::string token;
+  args >> token;
+
+  if (token == "startpos") {
+    board_.load_fen();
+    args >> token;
+  } else if (token == "fen") {
+    std::string fen;
+    while (args >> token && token != "moves") {
+      fen += fen.empty() ? token : ' ' + token;
+    }
+    if (!board_.load_fen(fen)) {
+      LOGF_ERROR("UCI", "Invalid FEN: {}", fen);
+      return;
+    }
+  } else {
+    LOG_ERROR("UCI", "Expected startpos or fen");
+    return;
+  }
+
+  if (token != "moves") {
+    return;
+  }
+
+  while (args >> token) {
+    const Board::Move move{parse_uci_move(board_, token)};
+    if (move.tile == -1) {
+      LOGF_ERROR("UCI", "Illegal move: {}", token);
+      return;
+    }
+    if (board_.get_records().full()) {
+      LOGF_ERROR("UCI", "Too many moves, stopped before: {}", token);
+      return;
+    }
+    board_.move(move);
+  }
+}
+
+void Uci::handle_go(std::istream& args) {
+  SearchLimits limits;
+  std::array<std::chrono::milliseconds, 2> time{};
+  std::array<bool, 2> has_time{};
+  std::array<std::chrono::milliseconds, 2> increment{};
+  int moves_to_go{};
+  bool infinite{};
+
+  const size_t white{get_color_index(PieceColor::White)};
+  const size_t black{get_color_index(PieceColor::Black)};
+
+  std::string token;
+  while (args >> token) {
+    int64_t value{};
+    // Flags take no value. Pondering is not offered, a ponder search runs
+    // on the clock it was given.
+    if (token == "infinite") {
+      infinite = true;
+    } else if (token == "ponder") {
+      continue;
+    } else if (!(args >> value)) {
+      // Unknown tokens and the moves of searchmoves are skipped, the next
+      // token is read as a keyword again
+      args.clear();
+    } else if (token == "depth") {
+      limits.depth = static_cast<int>(std::clamp<int64_t>(value, 1, k_max_ply));
+    } else if (token == "movetime") {
+      limits.movetime = std::chrono::milliseconds{std::max<int64_t>(value, 1)};
+    } else if (token == "nodes") {
+      limits.nodes = static_cast<uint64_t>(std::max<int64_t>(value, 1));
+    } else if (token == "wtime") {
+      time[white] = std::chrono::milliseconds{value};
+      has_time[white] = true;
+    } else if (token == "btime") {
+      time[black] = std::chrono::milliseconds{value};
+      has_time[black] = true;
+    } else if (token == "winc") {
+      increment[white] = std::chrono::milliseconds{value};
+    } else if (token == "binc") {
+      increment[black] = std::chrono::milliseconds{value};
+    } else if (token == "movestogo") {
+      moves_to_go = static_cast<int>(value);
+    } else if (token == "perft") {
+      handle_perft(static_cast<int>(value));
+      return;
+    }
+  }
+
+  // An even share of the remaining time plus most of the increment, never
+  // so much that the clock could run out. A clock at zero or below still
+  // gets the shortest search rather than an unbounded one.
+  const size_t us{get_color_index(board_.get_turn())};
+  if (!infinite && limits.movetime.count() == 0 && has_time[us]) {
+    const std::chrono::milliseconds budget{
+        std::max(time[us], std::chrono::milliseconds{}) /
+            (moves_to_go > 0 ? moves_to_go : k_default_moves_to_go) +
+        std::max(increment[us], std::chrono::milliseconds{}) / 2};
+    limits.movetime = std::max(std::min(budget, time[us] - k_move_overhead),
+                               std::chrono::milliseconds{1});
+  }
+
+  // A book move is the answer right away, infinite searches are for analysis
+  if (own_book_ && !infinite) {
+    if (const Board::Move move{book_.pick(board_, random_)}; move.tile != -1) {
+      write("bestmove " + to_uci_move(move));
+      return;
+    }
+  }
+
+  search_thread_ = std::jthread{[this, board = board_, limits,
+                                 infinite](std::stop_token stop_token) {
+    const SearchResult result{search_.run(
+        board, limits,
+        [this](const SearchResult& iteration) {
+          write(get_info_string(iteration, search_.get_hashfull()));
+        },
+        stop_token)};
+
+    // The protocol wants infinite searches to wait for stop even when they
+    // run out of depth
+    if (infinite) {
+      std::mutex mutex;
+      std::unique_lock lock{mutex};
+      std::condition_variable_any{}.wait(lock, stop_token,
+                                         [] { return false; });
+    }
+
+    write("bestmove " + to_uci_move(result.best_move));
+  }};
+}
+
+void Uci::handle_setoption(std::istream& args) {
+  std::string token;
+  std::string name;
+  while (args >> token && token != "value") {
+    if (token != "name") {
+      name += name.empty() ? token : ' ' + token;
+    }
+  }
+
+  // Strings like paths may contain spaces
+  std::string value;
+  std::getline(args >> std::ws, value);
+  if (value.empty()) {
+    LOGF("UCI", "Missing value for option {}", name);
+    return;
+  }
+
+  int number{};
+  const bool is_number{parse_int(value, number)};
+
+  if (name == "Hash" && is_number) {
+    search_.set_hash_size(
+        static_cast<size_t>(std::clamp(number, 1, k_max_hash_mb)));
+  } else if (name == "Threads" && is_number) {
+    search_.set_threads(std::clamp(number, 1, k_max_threads));
+  } else if (name == "OwnBook") {
+    own_book_ = value == "true";
+  } else if (name == "BookFile") {
+    if (value == "<empty>") {
+      book_.close();
+    } else {
+      book_.open(value);
+    }
+  } else if (name == "SyzygyPath") {
+    tablebases_.clear();
+    const bool has_tables{value != "<empty>" && tablebases_.init(value) > 0};
+    search_.set_tablebases(has_tables ? &tablebases_ : nullptr);
+  } else if (name == "EvalFile") {
+    const bool is_open{value != "<empty>" && network_.open(value)};
+    if (!is_open) {
+      network_.close();
+    }
+    search_.set_network(is_open ? &network_ : nullptr);
+  } else {
+    LOGF("UCI", "Unknown option: {}", name);
+  }
+}
+
+void Uci::handle_perft(int depth) {
+  if (depth < 1) {
+    return;
+  }
+
+  const auto begin{std::chrono::steady_clock::now()};
+  const PerftDivide divide{
+      perft_divide(board_, depth, search_.get_threads(), {})};
+  const auto elapsed{std::chrono::duration_cast<std::chrono::milliseconds>(
+      std::chrono::steady_clock::now() - begin)};
+
+  uint64_t nodes{};
+  for (const PerftSplit& split : divide) {
+    write(to_uci_move(split.move) + ": " + std::to_string(split.nodes));
+    nodes += split.nodes;
+  }
+  write("");
+  write("Nodes searched: " + std::to_string(nodes) + " in " +
+        std::to_string(elapsed.count()) + " ms");
+}
+
+void Uci::handle_stats() {
+  if constexpr (!k_stats_enabled) {
+    write("info string stats are not compiled in, build with ENABLE_STATS");
+    return;
+  }
+
+  const StatCounters counters{get_stat_counters()};
+  for (size_t i = 0; i < counters.size(); i++) {
+    write("info string " +
+          std::string{get_stat_counter_name(static_cast<StatCounter>(i))} +
+          ' ' + std::to_string(counters[i]));
+  }
+  reset_stat_counters();
+}
+
+void Uci::stop_search() {
+  search_thread_.request_stop();
+  wait_for_search();
+}
+
+void Uci::wait_for_search() {
+  if (search_thread_.joinable()) {
+    search_thread_.join();
+  }
+}
+
+void Uci::write(const std::string& line) {
+  const std::lock_guard lock{output_mutex_};
+  output_ << line << '\n';
+  output_.flush();
+}
@@ -0,0 +1,133 @@
+// Probes positions with known results against real Syzygy tables: the WDL
+// and DTZ values, and the root moves the tables keep. The tables are looked
+// for in the directories of SYZYGY_PATH, the test reports itself skipped
+// when one of them is missing.
+//
+// Usage: SYZYGY_PATH=<directories> tablebase_test
+
+#include <cstdlib>
+#include <iostream>
+
+#include "tablebase.hpp"
+
+namespace {
+
+// Reported to CTest as a skipped test
+constexpr int k_skipped{77};
+
+constexpr std::array<std::string_view, 4> k_tables{"KQvK", "KRvK", "KPvK",
+                                                   "KRvKR"};
+
+struct TablebaseCase {
+  std::string_view name;
+  std::string_view fen;
+  Wdl wdl{};
+  int dtz{};
+};
+
+constexpr std::array<TablebaseCase, 9> k_cases{{
+    {"KQvK mate in one", "k7/8/1K6/8/8/8/7Q/8 w - - 0 1", Wdl::Win, 1},
+    {"KQvK colors swapped", "8/7q/8/8/8/1k6/8/K7 b - - 0 1", Wdl::Win, 1},
+    {"KRvK mate in one", "k7/8/1K6/8/8/8/8/7R w - - 0 1", Wdl::Win, 1},
+    {"KRvK rook taken", "8/8/8/8/8/8/k7/1R5K b - - 0 1", Wdl::Draw, 0},
+    {"KPvK rook pawn", "k7/8/8/8/8/8/P7/K7 w - - 0 1", Wdl::Draw, 0},
+    {"KPvK pawn runs", "7k/8/8/8/8/8/P7/7K w - - 0 1", Wdl::Win, 1},
+    {"KPvK king too far", "7k/8/8/8/8/8/P7/7K b - - 0 1", Wdl::Loss, -2},
+    {"KRvKR rook hangs", "7k/8/8/8/8/8/r7/R6K w - - 0 1", Wdl::Win, 1},
+    {"KRvKR rook takes", "7k/8/8/8/8/8/r7/R6K b - - 0 1", Wdl::Win, 1},
+}};
+
+#ifdef _WIN32
+constexpr char k_path_separator{';'};
+#else
+constexpr char k_path_separator{':'};
+#endif
+
+bool has_table_file(std::string_view paths, const std::string& file) {
+  while (!paths.empty()) {
+    const size_t end{std::min(paths.find(k_path_separator), paths.size())};
+    std::error_code error;
+    if (fs::exists(fs::path{paths.substr(0, end)} / file, error)) {
+      return true;
+    }
+    paths.remove_prefix(std::min(end + 1, paths.size()));
+  }
+  return false;
+}
+
+// Every kept move has to keep the result, and a win in one has to mate or
+// zero
+bool check_root_moves(Board& board, const TablebaseCase& test,
+                      const Tablebases& tablebases) {
+  Board::Moves moves;
+  board.generate_all(moves);
+  if (!tablebases.filter_root_moves(board, moves) || moves.size == 0) {
+    return false;
+  }
+
+  for (size_t i = 0; i < static_cast<size_t>(moves.size); i++) {
+    const Board::Move move{moves.data[i]};
+    const bool is_zeroing{board.get_type(move.tile) == PieceType::Pawn ||
+                          board.get_type(move.target) != PieceType::None};
+    board.move(move);
+    const std::optional<Wdl> wdl{tablebases.probe_wdl(board)};
+    const bool is_mate{board.is_in_check() && !board.has_any_legal_move()};
+    board.undo();
+
+    if (!wdl || static_cast<Wdl>(-to_underlying(*wdl)) != test.wdl ||
+        (test.dtz == 1 && !is_mate && !is_zeroing)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}  // namespace
+
+int main() {
+  const char* paths{std::getenv("SYZYGY_PATH")};
+  if (paths == nullptr) {
+    std::cout << "SYZYGY_PATH is not set, skipped\n";
+    return k_skipped;
+  }
+  for (const std::string_view table : k_tables) {
+    for (const std::string_view extension : {".rtbw", ".rtbz"}) {
+      const std::string file{std::string{table} + std::string{extension}};
+      if (!has_table_file(paths, file)) {
+        std::cout << file << " not found, skipped\n";
+        return k_skipped;
+      }
+    }
+  }
+
+  Tablebases tablebases;
+  tablebases.init(paths);
+
+  int failures{};
+  for (const TablebaseCase& test : k_cases) {
+    Board board;
+    if (!board.load_fen(test.fen)) {
+      std::cout << test.name << ": invalid FEN\n";
+      failures++;
+      continue;
+    }
+
+    const std::optional<Wdl> wdl{tablebases.probe_wdl(board)};
+    const std::optional<int> dtz{tablebases.probe_dtz(board)};
+    const bool is_root_ok{test.wdl == Wdl::Draw ||
+                          check_root_moves(board, test, tablebases)};
+    if (wdl != test.wdl || dtz != test.dtz || !is_root_ok) {
+      std::cout << test.name << ": expected WDL "
+                << int{to_underlying(test.wdl)} << " and DTZ " << test.dtz
+                << ", got WDL "
+                << (wdl ? std::to_string(int{to_underlying(*wdl)}) : "none")
+                << " and DTZ " << (dtz ? std::to_string(*dtz) : "none")
+                << (is_root_ok ? "" : ", root moves wrong") << '\n';
+      failures++;
+    }
+  }
+
+  std::cout << k_cases.size() - static_cast<size_t>(failures) << '/'
+            << k_cases.size() << " positions passed\n";
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,237 @@
+// Runs perft over a standard position suite, checks the node counts and
+// prints the timings as JSON. With --search it instead searches every
+// position to a fixed depth, which measures time to depth and thread scaling.
+//
+// Built with CHESS_STATS the JSON also has the Board call counters of the run.
+//
+// Usage: chess_bench [--threads N] [--hash MB] [--no-bulk] [--quick]
+//                    [--search DEPTH]
+
+#include <charconv>
+#include <chrono>
+#include <iostream>
+
+#include "perft.hpp"
+#include "search.hpp"
+#include "stats.hpp"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+// windows.h has to come first
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+struct BenchPosition {
+  std::string_view name;
+  std::string_view fen;
+  int depth{};
+  uint64_t nodes{};
+};
+
+// Node counts from https://www.chessprogramming.org/Perft_Results
+constexpr std::array<BenchPosition, 6> k_positions{{
+    {"startpos", "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", 6,
+     119060324},
+    {"kiwipete",
+     "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", 5,
+     193690690},
+    {"position3", "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", 7, 178633661},
+    {"position4",
+     "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", 5,
+     15833292},
+    {"position5", "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", 5,
+     89941194},
+    {"position6",
+     "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+     5, 164075551},
+}};
+
+// Same positions one ply shallower
+constexpr std::array<uint64_t, 6> k_quick_nodes{4865609, 4085603, 11030083,
+                                                422333,  2103487, 3894594};
+
+uint64_t get_peak_rss_bytes() {
+#ifdef _WIN32
+  PROCESS_MEMORY_COUNTERS counters{};
+  if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) ==
+      0) {
+    return 0;
+  }
+  return counters.PeakWorkingSetSize;
+#else
+  rusage usage{};
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#ifdef __APPLE__
+  return static_cast<uint64_t>(usage.ru_maxrss);
+#else
+  return static_cast<uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+bool parse_int(std::string_view text, int& value) {
+  const auto* end{text.data() + text.size()};
+  const auto [ptr, error]{std::from_chars(text.data(), end, value)};
+  return error == std::errc{} && ptr == end;
+}
+
+// Ends the previous field, nothing without CHESS_STATS
+void write_stat_counters() {
+  if constexpr (k_stats_enabled) {
+    const StatCounters counters{get_stat_counters()};
+    std::cout << ",\n  \"counters\": {";
+    for (size_t i = 0; i < counters.size(); i++) {
+      std::cout << (i == 0 ? "\n" : ",\n") << "    \""
+                << get_stat_counter_name(static_cast<StatCounter>(i))
+                << "\": " << counters[i];
+    }
+    std::cout << "\n  }";
+  }
+}
+
+int run_search_bench(int depth, int threads, int hash_mb) {
+  Search search{hash_mb > 0 ? static_cast<size_t>(hash_mb) : k_default_hash_mb,
+                threads};
+
+  uint64_t total_nodes{};
+  double total_seconds{};
+
+  std::cout << "{\n  \"threads\": " << threads
+            << ",\n  \"search_depth\": " << depth << ",\n  \"positions\": [\n";
+
+  for (size_t i = 0; i < k_positions.size(); i++) {
+    const BenchPosition& position{k_positions[i]};
+
+    Board board;
+    board.load_fen(position.fen);
+    search.clear();
+
+    const auto begin{std::chrono::steady_clock::now()};
+    const SearchResult result{search.run(board, {.depth = depth})};
+    const std::chrono::duration<double> elapsed{
+        std::chrono::steady_clock::now() - begin};
+
+    const double seconds{elapsed.count()};
+    total_nodes += result.nodes;
+    total_seconds += seconds;
+
+    std::cout << "    {\"name\": \"" << position.name
+              << "\", \"depth\": " << result.depth
+              << ", \"score\": " << result.score
+              << ", \"nodes\": " << result.nodes
+              << ", \"seconds\": " << seconds << ", \"nps\": "
+              << static_cast<double>(result.nodes) / seconds << "}"
+              << (i + 1 < k_positions.size() ? "," : "") << '\n';
+  }
+
+  std::cout << "  ],\n  \"nodes\": " << total_nodes
+            << ",\n  \"seconds\": " << total_seconds << ",\n  \"nps\": "
+            << static_cast<double>(total_nodes) / total_seconds
+            << ",\n  \"peak_rss_bytes\": " << get_peak_rss_bytes();
+  write_stat_counters();
+  std::cout << "\n}\n";
+
+  return 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  int threads{1};
+  int hash_mb{};
+  bool bulk_counting{true};
+  bool quick{};
+  int search_depth{};
+
+  for (int i = 1; i < argc; i++) {
+    const std::string_view arg{argv[i]};
+    if (arg == "--threads" && i + 1 < argc && parse_int(argv[i + 1], threads)) {
+      i++;
+    } else if (arg == "--hash" && i + 1 < argc &&
+               parse_int(argv[i + 1], hash_mb)) {
+      i++;
+    } else if (arg == "--no-bulk") {
+      bulk_counting = false;
+    } else if (arg == "--quick") {
+      quick = true;
+    } else if (arg == "--search" && i + 1 < argc &&
+               parse_int(argv[i + 1], search_depth)) {
+      i++;
+    } else {
+      std::cerr << "Usage: chess_bench [--threads N] [--hash MB] [--no-bulk] "
+                   "[--quick] [--search DEPTH]\n";
+      return 2;
+    }
+  }
+
+  if (search_depth > 0) {
+    return run_search_bench(search_depth, threads, hash_mb);
+  }
+
+  std::unique_ptr<PerftTable> table;
+  if (hash_mb > 0) {
+    table = std::make_unique<PerftTable>(static_cast<size_t>(hash_mb));
+  }
+  const PerftOptions options{bulk_counting, table.get()};
+
+  bool passed{true};
+  uint64_t total_nodes{};
+  double total_seconds{};
+
+  std::cout << "{\n  \"threads\": " << threads << ",\n  \"hash_mb\": "
+            << hash_mb << ",\n  \"bulk_counting\": " << std::boolalpha
+            << bulk_counting << ",\n  \"positions\": [\n";
+
+  for (size_t i = 0; i < k_positions.size(); i++) {
+    const BenchPosition& position{k_positions[i]};
+    const int depth{quick ? position.depth - 1 : position.depth};
+    const uint64_t expected{quick ? k_quick_nodes[i] : position.nodes};
+
+    if (table) {
+      table->clear();
+    }
+
+    Board board;
+    board.load_fen(position.fen);
+
+    const auto begin{std::chrono::steady_clock::now()};
+    const uint64_t nodes{threads > 1
+                             ? perft_parallel(board, depth, threads, options)
+                             : perft(board, depth, options)};
+    const std::chrono::duration<double> elapsed{
+        std::chrono::steady_clock::now() - begin};
+
+    const double seconds{elapsed.count()};
+    const bool correct{nodes == expected};
+    passed = passed && correct;
+    total_nodes += nodes;
+    total_seconds += seconds;
+
+    std::cout << "    {\"name\": \"" << position.name
+              << "\", \"depth\": " << depth << ", \"nodes\": " << nodes
+              << ", \"expected\": " << expected << ", \"correct\": " << correct
+              << ", \"seconds\": " << seconds << ", \"nps\": "
+              << static_cast<double>(nodes) / seconds << ", \"ns_per_node\": "
+              << seconds * 1e9 / static_cast<double>(nodes) << "}"
+              << (i + 1 < k_positions.size() ? "," : "") << '\n';
+  }
+
+  std::cout << "  ],\n  \"nodes\": " << total_nodes
+            << ",\n  \"seconds\": " << total_seconds << ",\n  \"nps\": "
+            << static_cast<double>(total_nodes) / total_seconds
+            << ",\n  \"ns_per_node\": "
+            << total_seconds * 1e9 / static_cast<double>(total_nodes)
+            << ",\n  \"peak_rss_bytes\": " << get_peak_rss_bytes()
+            << ",\n  \"passed\": " << passed;
+  write_stat_counters();
+  std::cout << "\n}\n";
+
+  return passed ? 0 : 1;
+}
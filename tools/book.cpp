@@ -0,0 +1,85 @@
+// Builds an opening book for OpeningBook from games in coordinate notation,
+// one game per line of standard input, like "e2e4 e7e5 g1f3". Every move
+// played in the first plies counts once towards its weight. A line stops at
+// its first illegal move.
+//
+// Usage: chess_book OUTPUT [--plies N]
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#include "book.hpp"
+#include "notation.hpp"
+
+namespace {
+
+constexpr int k_default_plies{16};
+
+bool parse_int(std::string_view text, int& value) {
+  const auto* end{text.data() + text.size()};
+  const auto [ptr, error]{std::from_chars(text.data(), end, value)};
+  return error == std::errc{} && ptr == end;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "Usage: chess_book OUTPUT [--plies N]\n";
+    return 1;
+  }
+
+  const fs::path output_path{argv[1]};
+  int plies{k_default_plies};
+  for (int i = 2; i < argc; i++) {
+    const std::string_view arg{argv[i]};
+    if (arg == "--plies" && i + 1 < argc && parse_int(argv[i + 1], plies) &&
+        plies > 0) {
+      i++;
+    } else {
+      std::cerr << "Unknown argument: " << arg << '\n';
+      return 1;
+    }
+  }
+
+  // Keyed by position and move, so entries come out sorted by key
+  std::map<std::pair<uint64_t, uint16_t>, uint32_t> counts;
+
+  Board board;
+  uint64_t games{};
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    board.load_fen();
+
+    std::istringstream moves{line};
+    std::string token;
+    for (int ply = 0; ply < plies && moves >> token; ply++) {
+      const Board::Move move{parse_uci_move(board, token)};
+      if (move.tile == -1 || board.get_records().full()) {
+        break;
+      }
+      counts[{board.get_hash(), to_book_move(board, move)}]++;
+      board.move(move);
+    }
+    games++;
+  }
+
+  std::ofstream output{output_path, std::ios::binary | std::ios::trunc};
+  if (!output) {
+    std::cerr << "Failed to open " << output_path.string() << '\n';
+    return 1;
+  }
+
+  for (const auto& [position_move, count] : counts) {
+    write_book_entry(output,
+                     {position_move.first, position_move.second,
+                      static_cast<uint16_t>(std::min<uint32_t>(count, 65535))});
+  }
+
+  std::cerr << games << " games, " << counts.size() << " entries\n";
+  return output ? 0 : 1;
+}
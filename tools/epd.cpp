@@ -0,0 +1,210 @@
+// Streams a FEN or EPD file through the engine, one position per line, and
+// writes one result per line in input order. Lines are processed in batches
+// on a pool of threads, a bounded number of batches is in flight so memory
+// stays flat however large the file is. Without --perft the static
+// evaluation is printed.
+//
+// Usage: chess_epd FILE [--perft DEPTH] [--threads N]
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <deque>
+#include <iostream>
+
+#include "evaluation.hpp"
+#include "mapped_file.hpp"
+#include "perft.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+
+constexpr size_t k_batch_lines{4096};
+// Per thread, enough to keep every worker busy while the output is written
+constexpr size_t k_batches_in_flight{2};
+
+struct BatchResult {
+  std::string output;
+  uint64_t positions{};
+  uint64_t invalid{};
+};
+
+bool parse_int(std::string_view text, int& value) {
+  const auto* end{text.data() + text.size()};
+  const auto [ptr, error]{std::from_chars(text.data(), end, value)};
+  return error == std::errc{} && ptr == end;
+}
+
+constexpr std::string_view k_whitespace{" \t"};
+
+// Operations of the EPD standard, and the perft counts (D1, D2...) of perft
+// suites
+bool is_epd_opcode(std::string_view token) {
+  static constexpr std::array<std::string_view, 25> k_opcodes{
+      "acd", "acn", "acs", "am", "bm", "ce", "dm", "draw_accept",
+      "draw_claim", "draw_offer", "draw_reject", "eco", "fmvn", "hmvc", "id",
+      "nic", "noop", "pm", "pv", "rc", "resign", "sm", "tcgs", "tcri", "tcsi"};
+  if (token.size() == 2 && (token[0] == 'c' || token[0] == 'v' ||
+                            token[0] == 'D')) {
+    return token[1] >= '0' && token[1] <= '9';
+  }
+  return std::find(k_opcodes.begin(), k_opcodes.end(), token) !=
+         k_opcodes.end();
+}
+
+// First word of the operations, perft suites put a semicolon before it
+std::string_view get_opcode(std::string_view operations) {
+  operations.remove_prefix(
+      std::min(operations.find_first_not_of(k_whitespace), operations.size()));
+  if (operations.starts_with(';')) {
+    operations.remove_prefix(1);
+  }
+  return operations.substr(0, operations.find_first_of(" \t;"));
+}
+
+// A FEN line loads as is. The operations of an EPD line follow the first
+// four fields, or the clocks, and are cut off. Anything else after the
+// position is a broken FEN, not an EPD.
+std::string_view load_position(Board& board, std::string_view line) {
+  if (board.load_fen(line)) {
+    return line;
+  }
+
+  size_t end{};
+  for (int field = 1; field <= 6 && end != std::string_view::npos; field++) {
+    end = line.find_first_not_of(k_whitespace, end);
+    end = line.find_first_of(k_whitespace, end);
+    if (field >= 4 && end != std::string_view::npos &&
+        is_epd_opcode(get_opcode(line.substr(end)))) {
+      const std::string_view position{line.substr(0, end)};
+      return board.load_fen(position) ? position : std::string_view{};
+    }
+  }
+  return {};
+}
+
+BatchResult process_batch(std::string_view lines, int perft_depth) {
+  BatchResult result;
+  Board board;
+
+  while (!lines.empty()) {
+    const size_t end{std::min(lines.find('\n'), lines.size())};
+    std::string_view line{lines.substr(0, end)};
+    lines.remove_prefix(std::min(end + 1, lines.size()));
+
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    const size_t first{line.find_first_not_of(k_whitespace)};
+    if (first == std::string_view::npos || line[first] == '#') {
+      continue;
+    }
+
+    result.positions++;
+    const std::string_view position{load_position(board, line)};
+    if (position.empty()) {
+      result.invalid++;
+      result.output.append(line).append(" ; error invalid position\n");
+      continue;
+    }
+
+    result.output.append(position);
+    if (perft_depth > 0) {
+      result.output += " ; perft " + std::to_string(perft_depth) + ' ' +
+                       std::to_string(perft(board, perft_depth, {})) + '\n';
+    } else {
+      result.output += " ; eval " + std::to_string(evaluate(board)) + '\n';
+    }
+  }
+
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string_view path;
+  int perft_depth{};
+  int threads{};
+
+  for (int i = 1; i < argc; i++) {
+    const std::string_view arg{argv[i]};
+    if (arg == "--perft" && i + 1 < argc &&
+        parse_int(argv[i + 1], perft_depth)) {
+      i++;
+    } else if (arg == "--threads" && i + 1 < argc &&
+               parse_int(argv[i + 1], threads)) {
+      i++;
+    } else if (path.empty() && !arg.starts_with("--")) {
+      path = arg;
+    } else {
+      path = {};
+      break;
+    }
+  }
+
+  if (path.empty()) {
+    std::cerr << "Usage: chess_epd FILE [--perft DEPTH] [--threads N]\n";
+    return 2;
+  }
+
+  MappedFile file;
+  if (!file.open(path)) {
+    std::cerr << "Failed to open " << path << '\n';
+    return 1;
+  }
+
+  const auto begin{std::chrono::steady_clock::now()};
+
+  ThreadPool pool{threads};
+  const size_t max_in_flight{
+      k_batches_in_flight *
+      static_cast<size_t>(
+          threads > 0 ? threads
+                      : std::max<int>(std::thread::hardware_concurrency(), 1))};
+
+  uint64_t positions{};
+  uint64_t invalid{};
+  std::deque<std::future<BatchResult>> pending;
+
+  // Results are taken strictly from the front, which keeps the input order
+  auto write_front = [&] {
+    const BatchResult result{pending.front().get()};
+    pending.pop_front();
+    std::cout << result.output;
+    positions += result.positions;
+    invalid += result.invalid;
+  };
+
+  std::string_view remaining{file.get_view()};
+  while (!remaining.empty()) {
+    size_t end{0};
+    for (size_t lines = 0; lines < k_batch_lines && end < remaining.size();
+         lines++) {
+      end = std::min(remaining.find('\n', end), remaining.size() - 1) + 1;
+    }
+
+    const std::string_view batch{remaining.substr(0, end)};
+    remaining.remove_prefix(end);
+
+    if (pending.size() == max_in_flight) {
+      write_front();
+    }
+    pending.push_back(pool.submit(
+        [batch, perft_depth] { return process_batch(batch, perft_depth); }));
+  }
+
+  while (!pending.empty()) {
+    write_front();
+  }
+  std::cout.flush();
+
+  const std::chrono::duration<double> elapsed{std::chrono::steady_clock::now() -
+                                              begin};
+  std::cerr << positions << " positions (" << invalid << " invalid) in "
+            << elapsed.count() << " s, "
+            << static_cast<double>(positions) / elapsed.count()
+            << " positions/s\n";
+
+  return invalid == 0 ? 0 : 1;
+}
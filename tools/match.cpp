@@ -0,0 +1,477 @@
+// Plays two engine settings against each other and reports the score, the
+// Elo difference and an SPRT. Every opening is played twice with the colors
+// swapped. Games run concurrently, each worker thread owns a board and an
+// engine per side. Openings are FEN or EPD lines from a file, or random
+// plies from the start position. An engine is a list of settings like
+// nodes=20000,eval=net.nnue with the keys nodes, depth, movetime (ms),
+// hash (MB), eval (network file) and syzygy (tablebase paths).
+//
+// Usage: chess_match [--engine1 SETTINGS] [--engine2 SETTINGS] [--games N]
+//                    [--openings FILE] [--random-plies N] [--threads N]
+//                    [--sprt ELO0 ELO1] [--seed N]
+
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include "nnue.hpp"
+#include "search.hpp"
+#include "tablebase.hpp"
+
+namespace {
+
+constexpr int k_default_games{100};
+constexpr int k_default_random_plies{8};
+constexpr uint64_t k_default_nodes{10000};
+constexpr int k_progress_interval{100};
+
+// Both error rates of the SPRT
+constexpr double k_sprt_error{0.05};
+
+struct Engine {
+  SearchLimits limits{.nodes = k_default_nodes};
+  size_t hash_mb{k_default_hash_mb};
+  std::unique_ptr<Network> network;
+  std::unique_ptr<Tablebases> tablebases;
+};
+
+struct EngineStats {
+  uint64_t nodes{};
+  std::chrono::microseconds time{};
+};
+
+struct MatchStats {
+  // From the point of view of engine 1
+  int wins{};
+  int losses{};
+  int draws{};
+  std::array<EngineStats, 2> engines;
+};
+
+enum class Outcome { WhiteWins, BlackWins, Draw };
+
+bool parse_int(std::string_view text, int& value) {
+  const auto* end{text.data() + text.size()};
+  const auto [ptr, error]{std::from_chars(text.data(), end, value)};
+  return error == std::errc{} && ptr == end;
+}
+
+bool parse_double(const char* text, double& value) {
+  char* end{};
+  value = std::strtod(text, &end);
+  return end != text && *end == '\0';
+}
+
+bool parse_engine(std::string_view settings, Engine& engine) {
+  while (!settings.empty()) {
+    const size_t end{std::min(settings.find(','), settings.size())};
+    const std::string_view setting{settings.substr(0, end)};
+    settings.remove_prefix(std::min(end + 1, settings.size()));
+
+    const size_t equals{setting.find('=')};
+    if (equals == std::string_view::npos) {
+      return false;
+    }
+    const std::string_view key{setting.substr(0, equals)};
+    const std::string_view value{setting.substr(equals + 1)};
+
+    int number{};
+    const bool is_number{parse_int(value, number) && number > 0};
+    if (key == "nodes" && is_number) {
+      engine.limits.nodes = static_cast<uint64_t>(number);
+    } else if (key == "depth" && is_number) {
+      engine.limits.depth = std::min(number, k_max_ply - 1);
+    } else if (key == "movetime" && is_number) {
+      engine.limits.movetime = std::chrono::milliseconds{number};
+    } else if (key == "hash" && is_number) {
+      engine.hash_mb = static_cast<size_t>(number);
+    } else if (key == "eval") {
+      engine.network = std::make_unique<Network>();
+      if (!engine.network->open(std::string{value})) {
+        std::cerr << "Failed to open network " << value << '\n';
+        return false;
+      }
+    } else if (key == "syzygy") {
+      engine.tablebases = std::make_unique<Tablebases>();
+      engine.tablebases->init(value);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+// A FEN line loads as is, an EPD line has operations after the first four
+// fields which are cut off
+bool load_position(Board& board, std::string_view line) {
+  if (board.load_fen(line)) {
+    return true;
+  }
+
+  size_t end{};
+  for (int field = 0; field < 4 && end != std::string_view::npos; field++) {
+    end = line.find_first_not_of(' ', end);
+    end = line.find(' ', end);
+  }
+  return board.load_fen(line.substr(0, end));
+}
+
+// Kings with at most one minor piece between them can't mate
+bool is_insufficient_material(const Board& board) {
+  uint64_t key{board.get_material_key()};
+  for (const PieceColor color : {PieceColor::White, PieceColor::Black}) {
+    key -= get_material_increment(make_piece(color, PieceType::King));
+  }
+  for (const PieceColor color : {PieceColor::White, PieceColor::Black}) {
+    for (const PieceType type : {PieceType::Knight, PieceType::Bishop}) {
+      if (key == get_material_increment(make_piece(color, type))) {
+        return true;
+      }
+    }
+  }
+  return key == 0;
+}
+
+std::optional<Outcome> get_outcome(Board& board) {
+  if (!board.has_any_legal_move()) {
+    if (!board.is_in_check()) {
+      return Outcome::Draw;
+    }
+    return board.get_turn() == PieceColor::White ? Outcome::BlackWins
+                                                 : Outcome::WhiteWins;
+  }
+  // Out of history, or the fifty-move rule, threefold repetition or a dead
+  // position
+  if (board.is_game_over() || board.get_halfmove_clock() >= 100 ||
+      board.count_repetitions() >= 2 || is_insufficient_material(board)) {
+    return Outcome::Draw;
+  }
+  return std::nullopt;
+}
+
+double get_score(const MatchStats& stats) {
+  const int games{stats.wins + stats.losses + stats.draws};
+  return (stats.wins + 0.5 * stats.draws) / games;
+}
+
+// Variance of the result of one game
+double get_variance(const MatchStats& stats) {
+  const double score{get_score(stats)};
+  const int games{stats.wins + stats.losses + stats.draws};
+  return (stats.wins * (1.0 - score) * (1.0 - score) +
+          stats.losses * score * score +
+          stats.draws * (0.5 - score) * (0.5 - score)) /
+         games;
+}
+
+double get_elo(double score) {
+  score = std::clamp(score, 1e-6, 1.0 - 1e-6);
+  return 400.0 * std::log10(score / (1.0 - score));
+}
+
+double get_expected_score(double elo) {
+  return 1.0 / (1.0 + std::pow(10.0, -elo / 400.0));
+}
+
+struct EloInterval {
+  double lower{};
+  double upper{};
+};
+
+// 95% confidence interval. Converting scores to Elo is not linear, so the
+// bounds are converted one by one: a lopsided result has a far longer upper
+// side, and a bound past 0 or 1 is held at the limit of get_elo.
+EloInterval get_elo_interval(const MatchStats& stats) {
+  const int games{stats.wins + stats.losses + stats.draws};
+  const double error{1.96 * std::sqrt(get_variance(stats) / games)};
+  const double score{get_score(stats)};
+  return {get_elo(score - error), get_elo(score + error)};
+}
+
+// Log-likelihood ratio of elo1 over elo0, with the normal approximation of
+// the generalized SPRT
+double get_llr(const MatchStats& stats, double elo0, double elo1) {
+  const double variance{get_variance(stats)};
+  if (variance == 0.0) {
+    return 0.0;
+  }
+  const int games{stats.wins + stats.losses + stats.draws};
+  const double score0{get_expected_score(elo0)};
+  const double score1{get_expected_score(elo1)};
+  return games * (score1 - score0) *
+         (2.0 * get_score(stats) - score0 - score1) / (2.0 * variance);
+}
+
+std::string get_summary(const MatchStats& stats) {
+  std::ostringstream summary;
+  summary << stats.wins + stats.losses + stats.draws << " games, +"
+          << stats.wins << " -" << stats.losses << " =" << stats.draws
+          << ", score " << 100.0 * get_score(stats) << "%, Elo "
+          << get_elo(get_score(stats));
+  const EloInterval interval{get_elo_interval(stats)};
+  summary << " (95% " << interval.lower << " to " << interval.upper << ")";
+  return summary.str();
+}
+
+class Match {
+ public:
+  Match(const std::array<Engine, 2>& engines,
+        const std::vector<std::string>& openings, int games, int random_plies,
+        uint64_t seed)
+      : engines_{engines},
+        openings_{openings},
+        games_{games},
+        random_plies_{random_plies},
+        seed_{seed} {}
+
+  void set_sprt(double elo0, double elo1) {
+    sprt_ = true;
+    elo0_ = elo0;
+    elo1_ = elo1;
+  }
+
+  void run(int threads);
+
+  [[nodiscard]] const MatchStats& get_stats() const { return stats_; }
+
+ private:
+  void work();
+  // Engine 1 plays white in even games
+  void play(int game, Board& board, std::array<Search, 2>& searches);
+  void load_opening(int game, Board& board) const;
+
+  const std::array<Engine, 2>& engines_;
+  const std::vector<std::string>& openings_;
+  int games_{};
+  int random_plies_{};
+  uint64_t seed_{};
+
+  bool sprt_{};
+  double elo0_{};
+  double elo1_{};
+
+  std::atomic<int> next_game_{};
+  std::atomic<bool> stopped_{};
+
+  std::mutex stats_mutex_;
+  MatchStats stats_;
+};
+
+void Match::run(int threads) {
+  std::vector<std::jthread> workers;
+  for (int i = 0; i < threads; i++) {
+    workers.emplace_back([this] { work(); });
+  }
+}
+
+void Match::work() {
+  Board board;
+  std::array<Search, 2> searches{Search{engines_[0].hash_mb},
+                                 Search{engines_[1].hash_mb}};
+  for (size_t i = 0; i < searches.size(); i++) {
+    searches[i].set_network(engines_[i].network.get());
+    searches[i].set_tablebases(engines_[i].tablebases.get());
+  }
+
+  for (int game{next_game_++}; game < games_ && !stopped_;
+       game = next_game_++) {
+    play(game, board, searches);
+  }
+}
+
+void Match::play(int game, Board& board, std::array<Search, 2>& searches) {
+  load_opening(game, board);
+  for (Search& search : searches) {
+    search.clear();
+  }
+
+  const PieceColor first_color{game % 2 == 0 ? PieceColor::White
+                                             : PieceColor::Black};
+  std::array<EngineStats, 2> engine_stats{};
+
+  std::optional<Outcome> outcome;
+  while (!(outcome = get_outcome(board))) {
+    const size_t engine{board.get_turn() == first_color ? 0U : 1U};
+    const auto start{std::chrono::steady_clock::now()};
+    const SearchResult result{
+        searches[engine].run(board, engines_[engine].limits)};
+    engine_stats[engine].time +=
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+    engine_stats[engine].nodes += result.nodes;
+    board.move(result.best_move);
+  }
+
+  const std::lock_guard lock{stats_mutex_};
+  if (*outcome == Outcome::Draw) {
+    stats_.draws++;
+  } else if ((*outcome == Outcome::WhiteWins) ==
+             (first_color == PieceColor::White)) {
+    stats_.wins++;
+  } else {
+    stats_.losses++;
+  }
+  for (size_t i = 0; i < engine_stats.size(); i++) {
+    stats_.engines[i].nodes += engine_stats[i].nodes;
+    stats_.engines[i].time += engine_stats[i].time;
+  }
+
+  const int played{stats_.wins + stats_.losses + stats_.draws};
+  const double llr{sprt_ ? get_llr(stats_, elo0_, elo1_) : 0.0};
+  const double bound{std::log((1.0 - k_sprt_error) / k_sprt_error)};
+  if (sprt_ && std::abs(llr) >= bound) {
+    stopped_ = true;
+  }
+  if (played % k_progress_interval == 0) {
+    std::cerr << get_summary(stats_);
+    if (sprt_) {
+      std::cerr << ", LLR " << llr;
+    }
+    std::cerr << '\n';
+  }
+}
+
+void Match::load_opening(int game, Board& board) const {
+  const int pair{game / 2};
+  if (openings_.empty()) {
+    board.load_fen();
+  } else {
+    load_position(board, openings_[static_cast<size_t>(pair) %
+                                   openings_.size()]);
+  }
+
+  // Both games of a pair get the same random plies
+  std::mt19937_64 random{seed_ + static_cast<uint64_t>(pair)};
+  for (int ply = 0; ply < random_plies_; ply++) {
+    Board::Moves moves;
+    board.generate_all(moves);
+    if (moves.size == 0) {
+      break;
+    }
+    board.move(moves.data[std::uniform_int_distribution<int>{
+        0, moves.size - 1}(random)]);
+  }
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::array<Engine, 2> engines;
+  int games{k_default_games};
+  std::string_view openings_path;
+  int random_plies{-1};
+  int threads{};
+  int seed{};
+  std::optional<std::pair<double, double>> sprt;
+
+  bool is_valid{true};
+  for (int i = 1; i < argc && is_valid; i++) {
+    const std::string_view arg{argv[i]};
+    const bool has_value{i + 1 < argc};
+    if ((arg == "--engine1" || arg == "--engine2") && has_value) {
+      is_valid = parse_engine(argv[++i], engines[arg == "--engine1" ? 0 : 1]);
+    } else if (arg == "--games" && has_value) {
+      is_valid = parse_int(argv[++i], games) && games > 0;
+    } else if (arg == "--openings" && has_value) {
+      openings_path = argv[++i];
+    } else if (arg == "--random-plies" && has_value) {
+      is_valid = parse_int(argv[++i], random_plies) && random_plies >= 0;
+    } else if (arg == "--threads" && has_value) {
+      is_valid = parse_int(argv[++i], threads);
+    } else if (arg == "--seed" && has_value) {
+      is_valid = parse_int(argv[++i], seed);
+    } else if (arg == "--sprt" && i + 2 < argc) {
+      double elo0{};
+      double elo1{};
+      is_valid = parse_double(argv[i + 1], elo0) &&
+                 parse_double(argv[i + 2], elo1) && elo0 < elo1;
+      sprt = {elo0, elo1};
+      i += 2;
+    } else {
+      is_valid = false;
+    }
+  }
+
+  if (!is_valid) {
+    std::cerr << "Usage: chess_match [--engine1 SETTINGS] [--engine2 SETTINGS] "
+                 "[--games N]\n"
+                 "                   [--openings FILE] [--random-plies N] "
+                 "[--threads N]\n"
+                 "                   [--sprt ELO0 ELO1] [--seed N]\n";
+    return 2;
+  }
+
+  std::vector<std::string> openings;
+  if (!openings_path.empty()) {
+    std::ifstream file{fs::path{openings_path}};
+    if (!file) {
+      std::cerr << "Failed to open " << openings_path << '\n';
+      return 1;
+    }
+
+    Board board;
+    for (std::string line; std::getline(file, line);) {
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+      if (!line.empty() && line.front() != '#' &&
+          load_position(board, line)) {
+        openings.push_back(std::move(line));
+      }
+    }
+    if (openings.empty()) {
+      std::cerr << "No openings in " << openings_path << '\n';
+      return 1;
+    }
+  }
+
+  // Random plies keep games from repeating when there is no suite
+  if (random_plies < 0) {
+    random_plies = openings.empty() ? k_default_random_plies : 0;
+  }
+  if (threads <= 0) {
+    threads = std::max<int>(std::thread::hardware_concurrency(), 1);
+  }
+
+  Match match{engines, openings, games, random_plies,
+              static_cast<uint64_t>(seed)};
+  if (sprt) {
+    match.set_sprt(sprt->first, sprt->second);
+  }
+
+  const auto begin{std::chrono::steady_clock::now()};
+  match.run(threads);
+  const std::chrono::duration<double> elapsed{std::chrono::steady_clock::now() -
+                                              begin};
+
+  const MatchStats& stats{match.get_stats()};
+  std::cout << get_summary(stats) << '\n';
+  if (sprt) {
+    const double bound{std::log((1.0 - k_sprt_error) / k_sprt_error)};
+    const double llr{get_llr(stats, sprt->first, sprt->second)};
+    std::cout << "SPRT [" << sprt->first << ", " << sprt->second << "] LLR "
+              << llr << " (" << -bound << ", " << bound << ") "
+              << (llr >= bound    ? "H1 accepted"
+                  : llr <= -bound ? "H0 accepted"
+                                  : "inconclusive")
+              << '\n';
+  }
+  for (size_t i = 0; i < stats.engines.size(); i++) {
+    const EngineStats& engine{stats.engines[i]};
+    std::cout << "engine" << i + 1 << ": " << engine.nodes << " nodes, "
+              << static_cast<double>(engine.nodes) * 1e6 /
+                     std::max<double>(
+                         static_cast<double>(engine.time.count()), 1.0)
+              << " nps\n";
+  }
+  std::cout << elapsed.count() << " s, " << threads << " threads\n";
+
+  return 0;
+}
@@ -0,0 +1,164 @@
+// Replays the games of a PGN file and writes one line of moves per game in
+// input order, in coordinate notation like chess_book reads or with --san in
+// normalized SAN. Games set up from a FEN tag start their line with
+// "fen FEN moves". Games are read as a stream and replayed in batches on a
+// pool of threads, a bounded number of batches is in flight so memory stays
+// flat however large the file is. A - reads standard input.
+//
+// Usage: chess_pgn FILE [--san] [--threads N]
+
+#include <charconv>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <iostream>
+
+#include "notation.hpp"
+#include "pgn.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+
+constexpr size_t k_batch_games{1024};
+// Per thread, enough to keep every worker busy while the output is written
+constexpr size_t k_batches_in_flight{2};
+
+struct BatchResult {
+  std::string output;
+  uint64_t games{};
+  uint64_t invalid{};
+  uint64_t plies{};
+};
+
+bool parse_int(std::string_view text, int& value) {
+  const auto* end{text.data() + text.size()};
+  const auto [ptr, error]{std::from_chars(text.data(), end, value)};
+  return error == std::errc{} && ptr == end;
+}
+
+BatchResult process_batch(const std::vector<PgnGame>& games, bool san) {
+  BatchResult result;
+  Board board;
+
+  bool is_first{};
+  const PgnMoveCallback write_move{[&](Board& position, Board::Move move) {
+    if (!is_first) {
+      result.output += ' ';
+    }
+    is_first = false;
+    result.output += san ? to_san_move(position, move) : to_uci_move(move);
+    result.plies++;
+  }};
+
+  for (const PgnGame& game : games) {
+    result.games++;
+    is_first = true;
+    if (const std::string_view fen{game.get_tag("FEN")}; !fen.empty()) {
+      result.output.append("fen ").append(fen).append(" moves");
+      is_first = false;
+    }
+
+    if (!replay_pgn_game(game, board, write_move)) {
+      result.invalid++;
+      result.output += " ; error illegal move";
+    }
+    result.output += '\n';
+  }
+
+  return result;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  std::string_view path;
+  bool san{};
+  int threads{};
+
+  for (int i = 1; i < argc; i++) {
+    const std::string_view arg{argv[i]};
+    if (arg == "--san") {
+      san = true;
+    } else if (arg == "--threads" && i + 1 < argc &&
+               parse_int(argv[i + 1], threads)) {
+      i++;
+    } else if (path.empty() && (arg == "-" || !arg.starts_with("--"))) {
+      path = arg;
+    } else {
+      path = {};
+      break;
+    }
+  }
+
+  if (path.empty()) {
+    std::cerr << "Usage: chess_pgn FILE [--san] [--threads N]\n";
+    return 2;
+  }
+
+  std::ifstream file;
+  if (path != "-") {
+    file.open(fs::path{path}, std::ios::binary);
+    if (!file) {
+      std::cerr << "Failed to open " << path << '\n';
+      return 1;
+    }
+  }
+  PgnReader reader{path == "-" ? std::cin : file};
+
+  const auto begin{std::chrono::steady_clock::now()};
+
+  ThreadPool pool{threads};
+  const size_t max_in_flight{
+      k_batches_in_flight *
+      static_cast<size_t>(
+          threads > 0 ? threads
+                      : std::max<int>(std::thread::hardware_concurrency(), 1))};
+
+  uint64_t games{};
+  uint64_t invalid{};
+  uint64_t plies{};
+  std::deque<std::future<BatchResult>> pending;
+
+  // Results are taken strictly from the front, which keeps the input order
+  auto write_front = [&] {
+    const BatchResult result{pending.front().get()};
+    pending.pop_front();
+    std::cout << result.output;
+    games += result.games;
+    invalid += result.invalid;
+    plies += result.plies;
+  };
+
+  for (bool is_done{}; !is_done;) {
+    std::vector<PgnGame> batch(k_batch_games);
+    size_t size{};
+    while (size < batch.size() && reader.read_game(batch[size])) {
+      size++;
+    }
+    batch.resize(size);
+    is_done = size < k_batch_games;
+    if (batch.empty()) {
+      break;
+    }
+
+    if (pending.size() == max_in_flight) {
+      write_front();
+    }
+    pending.push_back(pool.submit([batch = std::move(batch), san] {
+      return process_batch(batch, san);
+    }));
+  }
+
+  while (!pending.empty()) {
+    write_front();
+  }
+  std::cout.flush();
+
+  const std::chrono::duration<double> elapsed{std::chrono::steady_clock::now() -
+                                              begin};
+  std::cerr << games << " games (" << invalid << " invalid), " << plies
+            << " plies in " << elapsed.count() << " s, "
+            << static_cast<double>(games) / elapsed.count() << " games/s\n";
+
+  return invalid == 0 ? 0 : 1;
+}
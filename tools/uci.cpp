@@ -0,0 +1,16 @@
+// Headless engine speaking UCI on stdin and stdout, for GUIs and match
+// runners. It links neither GLFW nor OpenGL, so it starts without a display.
+//
+// Usage: chess_uci
+
+#include <iostream>
+
+#include "uci.hpp"
+
+int main() {
+  std::ios::sync_with_stdio(false);
+
+  Uci uci{std::cin, std::cout};
+  uci.run();
+  return 0;
+}